@@ -0,0 +1,819 @@
+/**
+ * @file darray_bench.c
+ * @brief Benchmarks of the public API, @see `make bench`
+ *
+ * Every operation runs for each element type, each size (powers of ten) and, when the
+ * input order matters, each input pattern. One run is: build the array (not timed), run
+ * the operation (timed), delete the array. The first runs are warmups and are thrown
+ * away, the CSV row reports the median and the fastest of the other runs.
+ *
+ * Operations that cost O(n) per call (insert in the middle, find...) run a fixed number
+ * of calls, so ns_per_op is the cost of one call at that size. Operations over the whole
+ * array report per element (unit "element").
+ *
+ * process_peak_rss_kb is the peak resident memory of the whole process so far (getrusage),
+ * not of the row's operation: it only grows, so read it as "the biggest footprint of any
+ * row up to this one".
+ *
+ * With --baseline the rows are compared with a CSV from an earlier run: ratio is
+ * ns_per_op / baseline, and the exit status is 2 if any ratio exceeds --threshold.
+ */
+
+#define _POSIX_C_SOURCE 200809L ///< clock_gettime()
+#include "darray.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define BENCH_QUERIES 1024    ///< Keys drawn from the input for the lookup operations
+#define BENCH_CALLS 1000      ///< Calls made by the O(n) per call operations
+#define BENCH_FIND_CALLS 100  ///< Calls made by the linear searches
+#define BENCH_SMALL_SIZE 16   ///< Elements of the arrays built by the small array operations
+#define BENCH_TOP_K 100       ///< k of top_k
+#define BENCH_MAX_BASELINE 65536
+
+/**
+ * @brief What one benchmark run works on
+ */
+typedef struct {
+    var_types type;
+    size_t size;
+    const char* pattern;
+    const void* input;   ///< size elements in the pattern order
+    const void* queries; ///< BENCH_QUERIES elements taken from input
+} bench_input;
+
+/**
+ * @brief The state a run works on, built by a setup function
+ */
+typedef struct {
+    dArray* array;
+    darray_search_index* index;
+    size_t* indices; ///< Output of argsort, one per element
+    char path[64];
+} bench_state;
+
+/**
+ * @brief One benchmarked operation
+ */
+typedef struct {
+    const char* name;
+    const char* unit;      ///< "element" or "call", what one op is
+    bool patterned;        ///< Runs with every pattern, otherwise only with "random"
+    bool (*setup)(bench_state* state, const bench_input* input);
+    size_t (*run)(bench_state* state, const bench_input* input); ///< Returns how many ops it did
+} bench_case;
+
+/**
+ * @brief A row of the baseline CSV
+ */
+typedef struct {
+    char key[128];
+    double ns_per_op;
+} baseline_row;
+
+static volatile double sink; ///< Keeps the compiler from dropping the timed work
+
+static const char* patterns[] = {"random", "sorted", "reversed", "duplicates"};
+static const var_types types[] = {INT, FLOAT, DOUBLE, INT64};
+static const char* type_names[] = {"int", "float", "double", "int64"};
+
+static size_t type_size(var_types type){
+    return type == INT ? sizeof(int) : type == FLOAT ? sizeof(float) : type == INT64 ? sizeof(int64_t) : sizeof(double);
+}
+
+static void put_value(var_types type, void* buffer, size_t index, long long value){
+    switch (type){
+        case INT: ((int*)buffer)[index] = (int)value; break;
+        case FLOAT: ((float*)buffer)[index] = (float)value; break;
+        case DOUBLE: ((double*)buffer)[index] = (double)value; break;
+        case INT64: ((int64_t*)buffer)[index] = (int64_t)value; break;
+        default: break;
+    }
+}
+
+static double get_value(var_types type, const void* element){
+    switch (type){
+        case INT: return *(const int*)element;
+        case FLOAT: return *(const float*)element;
+        case DOUBLE: return *(const double*)element;
+        case INT64: return (double)*(const int64_t*)element;
+        default: break;
+    }
+    return 0;
+}
+
+static const void* query(const bench_input* input, size_t i){
+    return (const char*)input->queries + (i % BENCH_QUERIES)*type_size(input->type);
+}
+
+static double now_ns(void){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec*1e9 + (double)time.tv_nsec;
+}
+
+static long process_peak_rss_kb(void){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static unsigned long long next_random(unsigned long long* state){
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * @brief Fills input and queries for one type, size and pattern
+ * Values stay below 2^24 so FLOAT keeps them exact.
+ */
+static void make_input(var_types type, size_t size, const char* pattern, void* input, void* queries){
+    unsigned long long state = 0x9E3779B97F4A7C15ull ^ size;
+    long long range = size < (1 << 24) ? (long long)size : (1 << 24);
+    for (size_t i = 0; i < size; i++){
+        long long value;
+        if (strcmp(pattern, "sorted") == 0){
+            value = (long long)((double)i * range / size);
+        } else if (strcmp(pattern, "reversed") == 0){
+            value = (long long)((double)(size - 1 - i) * range / size);
+        } else if (strcmp(pattern, "duplicates") == 0){
+            value = (long long)(next_random(&state) % 16);
+        } else {
+            value = (long long)(next_random(&state) % (unsigned long long)range);
+        }
+        put_value(type, input, i, value);
+    }
+    size_t element = type_size(type);
+    for (size_t i = 0; i < BENCH_QUERIES; i++){
+        memcpy((char*)queries + i*element, (const char*)input + (next_random(&state) % size)*element, element);
+    }
+}
+
+//Setups, the state starts zeroed
+
+static bool setup_empty(bench_state* state, const bench_input* input){
+    state->array = array_new(input->type, 1);
+    return state->array != NULL;
+}
+
+static bool setup_filled(bench_state* state, const bench_input* input){
+    state->array = array_new(input->type, input->size);
+    return state->array && array_append_n(state->array, input->input, input->size);
+}
+
+static bool setup_sorted(bench_state* state, const bench_input* input){
+    if (!setup_filled(state, input)){
+        return false;
+    }
+    array_sort(state->array);
+    return true;
+}
+
+static bool setup_indexed(bench_state* state, const bench_input* input){
+    if (!setup_sorted(state, input)){
+        return false;
+    }
+    state->index = array_search_index_new(state->array);
+    return state->index != NULL;
+}
+
+static bool setup_hashed(bench_state* state, const bench_input* input){
+    return setup_filled(state, input) && array_enable_hash_index(state->array);
+}
+
+static bool setup_argsort(bench_state* state, const bench_input* input){
+    state->indices = malloc(input->size * sizeof(size_t));
+    return state->indices && setup_filled(state, input);
+}
+
+static bool setup_none(bench_state* state, const bench_input* input){
+    (void)state;
+    (void)input;
+    return true;
+}
+
+static bool setup_storage(bench_state* state, const bench_input* input, darray_storage storage, bool fill){
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    options.storage = storage;
+    state->array = array_new_ex(input->type, fill ? input->size : 1, &options);
+    return state->array && (!fill || array_append_n(state->array, input->input, input->size));
+}
+
+static bool setup_ring_empty(bench_state* state, const bench_input* input){
+    return setup_storage(state, input, DARRAY_STORAGE_RING, false);
+}
+
+static bool setup_ring_filled(bench_state* state, const bench_input* input){
+    return setup_storage(state, input, DARRAY_STORAGE_RING, true);
+}
+
+static bool setup_gap_filled(bench_state* state, const bench_input* input){
+    return setup_storage(state, input, DARRAY_STORAGE_GAP, true);
+}
+
+static bool setup_saved(bench_state* state, const bench_input* input){
+    snprintf(state->path, sizeof(state->path), "/tmp/darray_bench_%ld.bin", (long)getpid());
+    return setup_filled(state, input) && array_save(state->array, state->path);
+}
+
+//Operations
+
+static size_t run_append(bench_state* state, const bench_input* input){
+    size_t element = type_size(input->type);
+    for (size_t i = 0; i < input->size; i++){
+        array_append(state->array, (char*)input->input + i*element);
+    }
+    return input->size;
+}
+
+static size_t run_append_n(bench_state* state, const bench_input* input){
+    array_append_n(state->array, input->input, input->size);
+    return input->size;
+}
+
+static size_t run_extend(bench_state* state, const bench_input* input){
+    array_extend(state->array, state->array);
+    return input->size;
+}
+
+static size_t calls(const bench_input* input, size_t wanted){
+    return input->size < wanted ? input->size : wanted;
+}
+
+static size_t run_insert_middle(bench_state* state, const bench_input* input){
+    size_t count = calls(input, BENCH_CALLS);
+    for (size_t i = 0; i < count; i++){
+        array_insert(state->array, array_get_size(state->array)/2, (void*)query(input, i));
+    }
+    return count;
+}
+
+static size_t run_insert_sorted(bench_state* state, const bench_input* input){
+    size_t count = calls(input, BENCH_CALLS);
+    for (size_t i = 0; i < count; i++){
+        array_insert_sorted(state->array, (void*)query(input, i));
+    }
+    return count;
+}
+
+static size_t run_gap_insert_cursor(bench_state* state, const bench_input* input){
+    size_t count = calls(input, BENCH_CALLS);
+    size_t cursor = input->size/2;
+    for (size_t i = 0; i < count; i++){
+        array_insert(state->array, cursor++, (void*)query(input, i)); ///< Typing at a cursor
+    }
+    return count;
+}
+
+static size_t run_get(bench_state* state, const bench_input* input){
+    double buffer[1], total = 0;
+    for (size_t i = 0; i < input->size; i++){
+        array_get(state->array, i, buffer);
+        total += get_value(input->type, buffer);
+    }
+    sink = total;
+    return input->size;
+}
+
+static size_t run_set(bench_state* state, const bench_input* input){
+    for (size_t i = 0; i < input->size; i++){
+        array_set(state->array, i, (void*)query(input, i));
+    }
+    return input->size;
+}
+
+static size_t run_pop(bench_state* state, const bench_input* input){
+    double buffer[1];
+    for (size_t i = 0; i < input->size; i++){
+        array_pop(state->array, buffer);
+    }
+    return input->size;
+}
+
+static size_t run_push_front(bench_state* state, const bench_input* input){
+    size_t element = type_size(input->type);
+    for (size_t i = 0; i < input->size; i++){
+        array_push_front(state->array, (char*)input->input + i*element);
+    }
+    return input->size;
+}
+
+static size_t run_pop_front(bench_state* state, const bench_input* input){
+    double buffer[1];
+    for (size_t i = 0; i < input->size; i++){
+        array_pop_front(state->array, buffer);
+    }
+    return input->size;
+}
+
+static size_t run_remove_by_index(bench_state* state, const bench_input* input){
+    size_t count = calls(input, BENCH_CALLS);
+    for (size_t i = 0; i < count; i++){
+        array_remove_by_index(state->array, array_get_size(state->array)/2);
+    }
+    return count;
+}
+
+static size_t run_remove_by_value(bench_state* state, const bench_input* input){
+    size_t count = calls(input, BENCH_FIND_CALLS), element = type_size(input->type);
+    for (size_t i = 0; i < count; i++){
+        ///< Values of distinct input positions, so every one is still there when removed
+        array_remove_by_value(state->array, (char*)input->input + (i*input->size/count)*element);
+    }
+    return count;
+}
+
+static size_t run_remove_all(bench_state* state, const bench_input* input){
+    array_remove_all(state->array, query(input, 0));
+    return input->size;
+}
+
+static bool is_odd(const void* element, void* context){
+    return ((long long)get_value(*(const var_types*)context, element)) & 1;
+}
+
+static size_t run_remove_if(bench_state* state, const bench_input* input){
+    var_types type = input->type;
+    array_remove_if(state->array, is_odd, &type);
+    return input->size;
+}
+
+static size_t run_unique(bench_state* state, const bench_input* input){
+    sink = (double)array_unique(state->array);
+    return input->size;
+}
+
+static size_t run_retain_range(bench_state* state, const bench_input* input){
+    array_retain_range(state->array, input->size/4, input->size/2);
+    return input->size;
+}
+
+static size_t run_find(bench_state* state, const bench_input* input){
+    size_t count = calls(input, BENCH_FIND_CALLS), index = 0;
+    for (size_t i = 0; i < count; i++){
+        array_find(state->array, (void*)query(input, i), &index);
+    }
+    sink = (double)index;
+    return count;
+}
+
+static size_t run_find_all(bench_state* state, const bench_input* input){
+    sink = (double)array_find_all(state->array, query(input, 0), NULL, 0);
+    return input->size;
+}
+
+static size_t run_count(bench_state* state, const bench_input* input){
+    sink = (double)array_count(state->array, query(input, 0));
+    return input->size;
+}
+
+static size_t run_hash_index_build(bench_state* state, const bench_input* input){
+    array_enable_hash_index(state->array); ///< Builds the whole index
+    return input->size;
+}
+
+static size_t run_hash_count(bench_state* state, const bench_input* input){
+    size_t total = 0;
+    for (size_t i = 0; i < BENCH_QUERIES; i++){
+        total += array_count(state->array, query(input, i));
+    }
+    sink = (double)total;
+    return BENCH_QUERIES;
+}
+
+static size_t run_sort(bench_state* state, const bench_input* input){
+    array_sort(state->array);
+    return input->size;
+}
+
+static size_t run_sort_radix(bench_state* state, const bench_input* input){
+    array_sort_ex(state->array, DARRAY_SORT_RADIX);
+    return input->size;
+}
+
+static size_t run_sort_introsort(bench_state* state, const bench_input* input){
+    array_sort_ex(state->array, DARRAY_SORT_INTROSORT);
+    return input->size;
+}
+
+static size_t run_sort_parallel(bench_state* state, const bench_input* input){
+    array_sort_parallel(state->array, 0);
+    return input->size;
+}
+
+static size_t run_nth_element(bench_state* state, const bench_input* input){
+    array_nth_element(state->array, input->size/2); ///< The median
+    return input->size;
+}
+
+static size_t run_partial_sort(bench_state* state, const bench_input* input){
+    array_partial_sort(state->array, input->size/10);
+    return input->size;
+}
+
+static size_t run_top_k(bench_state* state, const bench_input* input){
+    dArray* top = array_top_k(state->array, BENCH_TOP_K, true);
+    array_delete(&top);
+    return input->size;
+}
+
+static size_t run_argsort(bench_state* state, const bench_input* input){
+    array_argsort(state->array, state->indices);
+    return input->size;
+}
+
+static size_t run_is_sorted(bench_state* state, const bench_input* input){
+    sink = array_is_sorted(state->array);
+    return input->size;
+}
+
+static size_t run_reverse(bench_state* state, const bench_input* input){
+    array_reverse(state->array);
+    return input->size;
+}
+
+static size_t run_binary_search(bench_state* state, const bench_input* input){
+    size_t index = 0;
+    for (size_t i = 0; i < BENCH_QUERIES; i++){
+        array_binary_search(state->array, (void*)query(input, i), &index, true);
+    }
+    sink = (double)index;
+    return BENCH_QUERIES;
+}
+
+static size_t run_index_build(bench_state* state, const bench_input* input){
+    darray_search_index* index = array_search_index_new(state->array);
+    array_search_index_delete(&index);
+    return input->size;
+}
+
+static size_t run_index_find(bench_state* state, const bench_input* input){
+    size_t index = 0;
+    for (size_t i = 0; i < BENCH_QUERIES; i++){
+        array_search_index_find(state->index, query(input, i), &index);
+    }
+    sink = (double)index;
+    return BENCH_QUERIES;
+}
+
+static size_t run_search_many(bench_state* state, const bench_input* input){
+    size_t indices[BENCH_QUERIES];
+    sink = (double)array_search_many(state->index, input->queries, BENCH_QUERIES, indices);
+    return BENCH_QUERIES;
+}
+
+static size_t run_sum(bench_state* state, const bench_input* input){
+    double sum = 0;
+    array_sum(state->array, &sum);
+    sink = sum;
+    return input->size;
+}
+
+static size_t run_min(bench_state* state, const bench_input* input){
+    double value[1];
+    array_min(state->array, value);
+    return input->size;
+}
+
+static size_t run_argmax(bench_state* state, const bench_input* input){
+    size_t index = 0;
+    array_argmax(state->array, &index);
+    sink = (double)index;
+    return input->size;
+}
+
+static size_t run_variance(bench_state* state, const bench_input* input){
+    double variance = 0;
+    array_variance(state->array, &variance);
+    sink = variance;
+    return input->size;
+}
+
+static size_t run_save(bench_state* state, const bench_input* input){
+    array_save(state->array, state->path);
+    return input->size;
+}
+
+static size_t run_load(bench_state* state, const bench_input* input){
+    dArray* loaded = array_load(state->path);
+    array_delete(&loaded);
+    return input->size;
+}
+
+static size_t run_map_file(bench_state* state, const bench_input* input){
+    dArray* mapped = array_map_file(state->path);
+    double sum = 0;
+    array_sum(mapped, &sum); ///< Touches the pages, mapping alone is lazy
+    sink = sum;
+    array_delete(&mapped);
+    return input->size;
+}
+
+static size_t run_encode_decode(bench_state* state, const bench_input* input){
+    FILE* stream = tmpfile();
+    if (!stream){
+        return input->size;
+    }
+    array_encode(state->array, stream);
+    rewind(stream);
+    dArray* decoded = array_decode(stream);
+    array_delete(&decoded);
+    fclose(stream);
+    return input->size;
+}
+
+/**
+ * @brief Fills and empties a small array, the values come from the queries
+ */
+static void use_small_array(dArray* array, const bench_input* input, size_t round){
+    for (size_t i = 0; i < BENCH_SMALL_SIZE; i++){
+        array_append(array, (void*)query(input, round + i));
+    }
+    double sum = 0;
+    array_sum(array, &sum);
+    sink = sum;
+}
+
+static size_t run_small_array(bench_state* state, const bench_input* input){
+    (void)state;
+    for (size_t i = 0; i < BENCH_CALLS; i++){
+        dArray* array = array_new(input->type, BENCH_SMALL_SIZE); ///< Header and buffer in one allocation
+        use_small_array(array, input, i);
+        array_delete(&array);
+    }
+    return BENCH_CALLS;
+}
+
+static size_t run_array_init(bench_state* state, const bench_input* input){
+    (void)state;
+    for (size_t i = 0; i < BENCH_CALLS; i++){
+        DARRAY_INLINE_STORAGE(storage, double, BENCH_SMALL_SIZE); ///< No type is bigger than double
+        dArray* array = array_init(storage, sizeof(storage), input->type, NULL);
+        use_small_array(array, input, i);
+        array_delete(&array);
+    }
+    return BENCH_CALLS;
+}
+
+static size_t run_concurrent_append(bench_state* state, const bench_input* input){
+    size_t element = type_size(input->type);
+    array_begin_concurrent(state->array);
+    for (size_t i = 0; i < input->size; i++){
+        array_append_concurrent(state->array, (char*)input->input + i*element);
+    }
+    array_seal(state->array);
+    return input->size;
+}
+
+static const bench_case cases[] = {
+    {"append", "element", false, setup_empty, run_append},
+    {"append_n", "element", false, setup_empty, run_append_n},
+    {"extend", "element", false, setup_filled, run_extend},
+    {"insert_middle", "call", false, setup_filled, run_insert_middle},
+    {"insert_sorted", "call", true, setup_sorted, run_insert_sorted},
+    {"gap_insert_cursor", "call", false, setup_gap_filled, run_gap_insert_cursor},
+    {"get", "element", false, setup_filled, run_get},
+    {"set", "element", false, setup_filled, run_set},
+    {"pop", "element", false, setup_filled, run_pop},
+    {"ring_push_front", "element", false, setup_ring_empty, run_push_front},
+    {"ring_pop_front", "element", false, setup_ring_filled, run_pop_front},
+    {"remove_by_index_middle", "call", false, setup_filled, run_remove_by_index},
+    {"remove_by_value", "call", true, setup_filled, run_remove_by_value},
+    {"remove_all", "element", true, setup_filled, run_remove_all},
+    {"remove_if", "element", false, setup_filled, run_remove_if},
+    {"unique", "element", true, setup_sorted, run_unique},
+    {"retain_range", "element", false, setup_filled, run_retain_range},
+    {"find", "call", true, setup_filled, run_find},
+    {"hash_index_build", "element", true, setup_filled, run_hash_index_build},
+    {"hash_find", "call", true, setup_hashed, run_find},
+    {"hash_count", "call", true, setup_hashed, run_hash_count},
+    {"hash_remove_by_value", "call", true, setup_hashed, run_remove_by_value},
+    {"find_all", "element", true, setup_filled, run_find_all},
+    {"count", "element", true, setup_filled, run_count},
+    {"sort", "element", true, setup_filled, run_sort},
+    {"sort_radix", "element", true, setup_filled, run_sort_radix},
+    {"sort_introsort", "element", true, setup_filled, run_sort_introsort},
+    {"sort_parallel", "element", true, setup_filled, run_sort_parallel},
+    {"nth_element", "element", true, setup_filled, run_nth_element},
+    {"partial_sort", "element", true, setup_filled, run_partial_sort},
+    {"top_k", "element", true, setup_filled, run_top_k},
+    {"argsort", "element", true, setup_argsort, run_argsort},
+    {"is_sorted", "element", false, setup_sorted, run_is_sorted},
+    {"reverse", "element", false, setup_filled, run_reverse},
+    {"binary_search", "call", true, setup_sorted, run_binary_search},
+    {"search_index_build", "element", true, setup_sorted, run_index_build},
+    {"search_index_find", "call", true, setup_indexed, run_index_find},
+    {"search_many", "call", true, setup_indexed, run_search_many},
+    {"sum", "element", false, setup_filled, run_sum},
+    {"min", "element", false, setup_filled, run_min},
+    {"argmax", "element", false, setup_filled, run_argmax},
+    {"variance", "element", false, setup_filled, run_variance},
+    {"save", "element", false, setup_saved, run_save},
+    {"load", "element", false, setup_saved, run_load},
+    {"map_file", "element", false, setup_saved, run_map_file},
+    {"encode_decode", "element", true, setup_filled, run_encode_decode},
+    {"concurrent_append", "element", false, setup_empty, run_concurrent_append},
+    {"small_array", "call", false, setup_none, run_small_array},
+    {"array_init", "call", false, setup_none, run_array_init},
+};
+
+static void teardown(bench_state* state){
+    if (state->index){
+        array_search_index_delete(&state->index);
+    }
+    if (state->array){
+        array_delete(&state->array);
+    }
+    free(state->indices);
+    if (state->path[0]){
+        remove(state->path);
+    }
+}
+
+static int compare_doubles(const void* first, const void* second){
+    double a = *(const double*)first, b = *(const double*)second;
+    return (a > b) - (a < b);
+}
+
+/**
+ * @brief Loads ns_per_op of every row of an earlier CSV
+ * @return How many rows were loaded
+ */
+static size_t load_baseline(const char* path, baseline_row* rows, size_t max_rows){
+    FILE* file = fopen(path, "r");
+    if (!file){
+        fprintf(stderr, "ERROR! Unable to open the baseline %s!\n", path);
+        return 0;
+    }
+    char line[512];
+    size_t count = 0;
+    while (count < max_rows && fgets(line, sizeof(line), file)){
+        char* fields[8];
+        size_t found = 0;
+        for (char* field = strtok(line, ","); field && found < 8; field = strtok(NULL, ",")){
+            fields[found++] = field;
+        }
+        if (found < 8 || strcmp(fields[0], "operation") == 0){
+            continue;
+        }
+        snprintf(rows[count].key, sizeof(rows[count].key), "%s,%s,%s,%s", fields[0], fields[1], fields[2], fields[3]);
+        rows[count].ns_per_op = strtod(fields[7], NULL);
+        count++;
+    }
+    fclose(file);
+    return count;
+}
+
+static double find_baseline(const baseline_row* rows, size_t count, const char* key){
+    for (size_t i = 0; i < count; i++){
+        if (strcmp(rows[i].key, key) == 0){
+            return rows[i].ns_per_op;
+        }
+    }
+    return 0;
+}
+
+static void usage(const char* program){
+    fprintf(stderr,
+        "Usage: %s [options] > results.csv\n"
+        "  --min-size N     Smallest size (default 1e2)\n"
+        "  --max-size N     Biggest size, sizes go by powers of ten (default 1e6, up to 1e9)\n"
+        "  --reps N         Timed runs per row (default 5)\n"
+        "  --warmup N       Untimed runs before them (default 1)\n"
+        "  --filter NAME    Only the operations whose name contains NAME\n"
+        "  --type NAME      Only int, float, double or int64\n"
+        "  --baseline FILE  Compare with the CSV of an earlier run\n"
+        "  --threshold R    Ratio over the baseline reported as a regression (default 1.10)\n",
+        program);
+}
+
+int main(int argc, char** argv){
+    size_t min_size = 100, max_size = 1000000;
+    int reps = 5, warmup = 1;
+    double threshold = 1.10;
+    const char* filter = NULL;
+    const char* only_type = NULL;
+    const char* baseline_path = NULL;
+    for (int i = 1; i < argc; i++){
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value){
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--min-size") == 0){
+            min_size = (size_t)strtod(value, NULL);
+        } else if (strcmp(argv[i], "--max-size") == 0){
+            max_size = (size_t)strtod(value, NULL);
+        } else if (strcmp(argv[i], "--reps") == 0){
+            reps = atoi(value);
+        } else if (strcmp(argv[i], "--warmup") == 0){
+            warmup = atoi(value);
+        } else if (strcmp(argv[i], "--filter") == 0){
+            filter = value;
+        } else if (strcmp(argv[i], "--type") == 0){
+            only_type = value;
+        } else if (strcmp(argv[i], "--baseline") == 0){
+            baseline_path = value;
+        } else if (strcmp(argv[i], "--threshold") == 0){
+            threshold = strtod(value, NULL);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (reps < 1 || warmup < 0 || min_size < 1 || max_size < min_size){
+        usage(argv[0]);
+        return 1;
+    }
+
+    baseline_row* baseline = NULL;
+    size_t baseline_count = 0;
+    if (baseline_path){
+        baseline = malloc(BENCH_MAX_BASELINE * sizeof(baseline_row));
+        if (!baseline){
+            fprintf(stderr, "ERROR! Failed to allocate memory!\n");
+            return 1;
+        }
+        baseline_count = load_baseline(baseline_path, baseline, BENCH_MAX_BASELINE);
+    }
+    double* samples = malloc((size_t)reps * sizeof(double));
+    if (!samples){
+        fprintf(stderr, "ERROR! Failed to allocate memory!\n");
+        return 1;
+    }
+
+    printf("operation,type,size,pattern,unit,ops,reps,ns_per_op,ns_per_op_min,ops_per_s,process_peak_rss_kb,baseline_ns_per_op,ratio\n");
+    int regressions = 0;
+    for (size_t t = 0; t < sizeof(types)/sizeof(types[0]); t++){
+        if (only_type && strcmp(only_type, type_names[t]) != 0){
+            continue;
+        }
+        for (size_t size = min_size; size <= max_size; size *= 10){
+            void* input = malloc(size * type_size(types[t]));
+            void* queries = malloc(BENCH_QUERIES * type_size(types[t]));
+            if (!input || !queries){
+                fprintf(stderr, "ERROR! Not enough memory for size %zu!\n", size);
+                free(input);
+                free(queries);
+                break;
+            }
+            for (size_t p = 0; p < sizeof(patterns)/sizeof(patterns[0]); p++){
+                make_input(types[t], size, patterns[p], input, queries);
+                bench_input bench = {types[t], size, patterns[p], input, queries};
+                for (size_t c = 0; c < sizeof(cases)/sizeof(cases[0]); c++){
+                    const bench_case* test = &cases[c];
+                    if ((filter && !strstr(test->name, filter)) || (!test->patterned && p > 0)){
+                        continue;
+                    }
+                    size_t ops = 0;
+                    bool failed = false;
+                    for (int r = 0; r < warmup + reps && !failed; r++){
+                        bench_state state = {0};
+                        failed = !test->setup(&state, &bench);
+                        if (!failed){
+                            double start = now_ns();
+                            ops = test->run(&state, &bench);
+                            double elapsed = now_ns() - start;
+                            if (r >= warmup){
+                                samples[r - warmup] = elapsed / (double)ops;
+                            }
+                        }
+                        teardown(&state);
+                    }
+                    if (failed){
+                        fprintf(stderr, "ERROR! Setup of %s failed at size %zu!\n", test->name, size);
+                        continue;
+                    }
+                    qsort(samples, (size_t)reps, sizeof(double), compare_doubles);
+                    double median = samples[reps/2];
+                    char key[128];
+                    snprintf(key, sizeof(key), "%s,%s,%zu,%s", test->name, type_names[t], size, patterns[p]);
+                    double base = find_baseline(baseline, baseline_count, key);
+                    double ratio = base > 0 ? median / base : 0;
+                    if (ratio > threshold){
+                        fprintf(stderr, "REGRESSION %s: %.2f ns/op, baseline %.2f ns/op (x%.2f)\n", key, median, base, ratio);
+                        regressions++;
+                    }
+                    printf("%s,%s,%zu,%d,%.3f,%.3f,%.0f,%ld,%.3f,%.3f\n", key, test->unit, ops, reps,
+                           median, samples[0], 1e9 / median, process_peak_rss_kb(), base, ratio);
+                    fflush(stdout);
+                }
+            }
+            free(input);
+            free(queries);
+            if (size > max_size / 10){
+                break; ///< The next power of ten would overflow or pass max_size
+            }
+        }
+    }
+    free(samples);
+    free(baseline);
+    return regressions > 0 ? 2 : 0;
+}
@@ -1,30 +1,65 @@
 #include "darray.h"
+#include "darray_internal.h"
+#include "darray_typed.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+#ifndef DARRAY_INLINE_BYTES
+#define DARRAY_INLINE_BYTES 256 ///< array_new() buffers up to this many bytes share the allocation of the header
+#endif
+
+_Static_assert(DARRAY_INLINE_OFFSET <= DARRAY_HEADER_SIZE, "DARRAY_HEADER_SIZE must cover struct dArray");
 
 /**
- * @brief This is the main structure to control a dynamic array
- * 
- * This struct stores all the necessary information for manipulation and operations.
- * Those fields should not be directly acessed, instead use the API functions. 
- * @see array_new()
- * @see array_delete()
+ * @brief A contiguous run of elements inside the buffer, @see array_parts()
  */
-struct dArray {
-    void* dArray;      ///< Generic pointer to the array on the heap
-    size_t total_size; ///< Total capacity allocated (how many elements fits in)
-    size_t used_size;  ///< How many elements actually exists 
-    var_types type;    ///< The variable type that this array stores (INT, FLOAT, DOUBLE)
-};
+typedef struct {
+    const char* data;
+    size_t size;
+} array_part;
 
 //Private functions declaration
 static bool array_realloc(dArray* array);
-static int compare_int(const void* a, const void* b);
-static int compare_float(const void* a, const void* b);
-static int compare_double(const void* a, const void* b);
+static size_t array_check_options(var_types type, const darray_options* options, const darray_allocator** store_allocator);
+static bool array_resize_buffer(dArray* array, size_t new_capacity);
 static size_t get_type_size(var_types type);
+static bool array_is_writable(const dArray* array);
 static bool array_is_full(dArray* array);
+static bool array_grow_to(dArray* array, size_t min_capacity);
+static bool array_set_capacity(dArray* array, size_t new_capacity);
+static void array_auto_shrink(dArray* array);
+static bool array_find_index(const dArray* array, const void* value, size_t* store_index);
+static inline void* array_element(const dArray* array, size_t index);
+static bool elements_in_order(const dArray* array, const void* first, const void* second);
+static bool elements_equal(const dArray* array, const void* first, const void* second);
+static size_t array_scan_find(const dArray* array, const void* data, size_t size, const void* value);
+static size_t array_scan_count(const dArray* array, const void* data, size_t size, const void* value);
+static void array_track_extend(dArray* array, size_t limit);
+static void array_track_insert(dArray* array, size_t index, size_t count);
+static void array_track_set(dArray* array, size_t index);
+static void array_track_remove(dArray* array, size_t index, size_t count);
+static void array_finish_removal(dArray* array, size_t new_size, size_t removed_sorted);
+static void array_move_gap(dArray* array, size_t index);
+static void array_flatten(const dArray* array);
+static void array_parts(const dArray* array, array_part parts[2]);
+static void array_open_end(dArray* array);
+static void array_copy_in(dArray* array, size_t index, const void* src, size_t count);
+static bool array_ring_insert(dArray* array, size_t index, const void* src, size_t count);
+static void array_rotate_ring(dArray* array);
+static inline void array_memmove(dArray* array, void* destination, const void* source, size_t bytes);
+static bool array_sort_custom(dArray* array);
+static bool array_custom_binary_search(const dArray* array, const void* element, size_t* store_index);
+static void array_note_resize(dArray* array, size_t old_capacity, size_t new_capacity);
+static void array_overwrite_oldest(dArray* array, size_t* index, const void** src, size_t* count);
+static bool array_extend_window(dArray* dst, const dArray* src);
+
+//Type-specialized kernels used behind the generic API, @see darray_typed.h
+#define DEFINE_INTEGER_KERNELS(TYPE, T, K, name) DARRAY_DEFINE_KERNELS(T, kernel_##name)
+DARRAY_FOR_EACH_INTEGER(DEFINE_INTEGER_KERNELS)
+DARRAY_DEFINE_KERNELS(float, kernel_float)
+DARRAY_DEFINE_KERNELS(double, kernel_double)
 
 //Public functions implementation
 
@@ -36,33 +71,135 @@ static bool array_is_full(dArray* array);
  * @return               A dArray pointer to your new fresh dynamic array
  */
 dArray* array_new(var_types type, size_t start_size){
+    return array_new_with_allocator(type, start_size, NULL);
+}
+
+/**
+ * @brief Creates a new dynamic array whose memory comes from the given allocator
+ * The allocator is copied into the array, its context must outlive the array.
+ * @see darray_alloc.h
+ * 
+ * @param[in] type       The type that the array will store
+ * @param[in] start_size The total_size that the array will begin with
+ * @param[in] allocator  The allocator, NULL for the system one (malloc/realloc/free)
+ * @return               A dArray pointer to your new fresh dynamic array
+ */
+dArray* array_new_with_allocator(var_types type, size_t start_size, const darray_allocator* allocator){
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    options.allocator = allocator;
+    return array_new_ex(type, start_size, &options);
+}
+
+/**
+ * @brief Creates a new dynamic array with the given options
+ * DARRAY_STORAGE_GAP keeps the free space as a gap that follows the last insert or removal:
+ * array_insert() and array_remove_by_index() only move the elements between the previous
+ * position and the new one, so edits around a moving cursor cost O(1) instead of O(n).
+ * array_get() and array_set() work the same as always. Functions that need the elements
+ * contiguous (search, sort, array_data()...) first move the gap to the end, @see array_compact().
+ *
+ * DARRAY_STORAGE_RING keeps the elements in a circular buffer that starts at any slot, so
+ * array_append(), array_pop(), array_push_front() and array_pop_front() (and inserts and
+ * removals at either end) cost O(1), which suits sliding windows and queues. When it
+ * grows, the part of the ring that wraps around the end is moved once. With
+ * overwrite_oldest the capacity stays at start_size: appends, inserts and extends that
+ * overflow it drop the first elements of the result (array_push_front() drops the last
+ * one instead). Index-based calls go through the ring offset, and like with the gap
+ * buffer, functions that need the elements contiguous rotate the ring to slot 0 first.
+ * Searches, counts and array_extend() read both parts of a gap or ring where they are.
+ *
+ * CUSTOM arrays store options->element_size bytes per element. Without a compare
+ * callback they can be stored, searched by bytes and saved, but not sorted.
+ *
+ * Small arrays (up to DARRAY_INLINE_BYTES of start capacity) take a single allocation:
+ * the buffer sits right after the header until the array outgrows it, @see array_init().
+ * 
+ * @param[in] type       The type that the array will store
+ * @param[in] start_size The total_size that the array will begin with
+ * @param[in] options    The options, NULL for DARRAY_OPTIONS_DEFAULT
+ * @return               A dArray pointer to your new fresh dynamic array
+ */
+dArray* array_new_ex(var_types type, size_t start_size, const darray_options* options){
+    darray_options defaults = DARRAY_OPTIONS_DEFAULT;
+    if (!options){
+        options = &defaults;
+    }
     if (start_size == 0){
-        fprintf(stderr, "ERROR! Size must be bigger than 0!\n");
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Size must be bigger than 0!");
+        return NULL;
+    }
+    const darray_allocator* allocator = NULL;
+    size_t type_size = array_check_options(type, options, &allocator);
+    if (type_size == 0){
+        return NULL;
+    }
+    if (start_size > SIZE_MAX / type_size){
+        darray_report(NULL, DARRAY_ERR_TOO_BIG, "Requested capacity is too big!");
         return NULL;
     }
 
-    dArray* new_array = malloc(sizeof(dArray));
+    ///< Small buffers share the allocation of the header, big ones would be stranded there once they grow
+    size_t inline_capacity = start_size * type_size <= DARRAY_INLINE_BYTES ? start_size : 0;
+    size_t header_bytes = DARRAY_INLINE_OFFSET + inline_capacity * type_size;
+    dArray* new_array = allocator->alloc(allocator->context, header_bytes);
     if (!new_array){
-        fprintf(stderr, "ERROR! Failed to allocate memory!\n");
+        darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
         return NULL;
     }
+    darray_init_header(new_array, type, type_size, start_size, inline_capacity, options, allocator);
+    new_array->owns_header = true;
+    if (inline_capacity == 0){
+        new_array->dArray = allocator->alloc(allocator->context, start_size * type_size);
+        if (!new_array->dArray){
+            darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory for the data buffer!");
+            allocator->free(allocator->context, new_array, header_bytes);
+            return NULL;
+        }
+        new_array->buffer_kind = DARRAY_BUFFER_HEAP;
+    }
+    return new_array;
+}
 
-    size_t type_size = get_type_size(type);
+/**
+ * @brief Creates a new dynamic array in storage given by the caller, on the stack or inside
+ * another structure, so small arrays allocate nothing at all
+ * The header takes the first DARRAY_HEADER_SIZE bytes and the elements live in the rest
+ * of the storage until they outgrow it, then they move to a buffer from the allocator
+ * (and move back when the array shrinks enough). Declare the storage with
+ * DARRAY_INLINE_STORAGE() to get the alignment and the size right.
+ * @note array_delete() frees what the array allocated but not the storage, which must
+ * outlive the array and must not be copied or moved while the array is in use.
+ * 
+ * @param[out] storage      The memory for the array, aligned like max_align_t
+ * @param[in]  storage_size Bytes of storage, DARRAY_HEADER_SIZE plus the inline elements
+ * @param[in]  type         The type that the array will store
+ * @param[in]  options      The options, NULL for DARRAY_OPTIONS_DEFAULT
+ * @return                  The array (at the address of storage), NULL if the storage is
+ *                          misaligned, has no room for an element or the options are invalid
+ */
+dArray* array_init(void* storage, size_t storage_size, var_types type, const darray_options* options){
+    darray_options defaults = DARRAY_OPTIONS_DEFAULT;
+    if (!options){
+        options = &defaults;
+    }
+    if (!storage || (uintptr_t)storage % _Alignof(max_align_t) != 0 || storage_size < DARRAY_HEADER_SIZE){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "The storage must be aligned and hold at least DARRAY_HEADER_SIZE bytes!");
+        return NULL;
+    }
+    const darray_allocator* allocator = NULL;
+    size_t type_size = array_check_options(type, options, &allocator);
     if (type_size == 0){
-        fprintf(stderr, "ERROR! Unable to allocate a new array!\n");
-        free(new_array);
         return NULL;
     }
-    new_array->dArray = malloc(start_size * type_size);
-    if (!new_array->dArray){
-        fprintf(stderr, "ERROR! Failed to allocate memory for the data buffer!\n");
-        free(new_array);
+    size_t inline_capacity = (storage_size - DARRAY_INLINE_OFFSET) / type_size;
+    if (inline_capacity == 0){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "The storage has no room for an element!");
         return NULL;
     }
-    new_array->total_size = start_size;
-    new_array->used_size = 0;
-    new_array->type = type;
-    return new_array;
+    dArray* array = storage;
+    darray_init_header(array, type, type_size, inline_capacity, inline_capacity, options, allocator);
+    array->owns_header = false;
+    return array;
 }
 
 /**
@@ -72,25 +209,156 @@ dArray* array_new(var_types type, size_t start_size){
  * @param[in]     new_element The element that will be appended
  */
 bool array_append(dArray* array, void* new_element){
+    if (!array_is_writable(array)){return false;}
+    array_open_end(array);
+    if (array_is_full(array) && array->overwrite_oldest){
+        ///< The new element takes the slot of the oldest one, which the head leaves behind
+        array->ring_head = array->ring_head + 1 == array->total_size ? 0 : array->ring_head + 1;
+        array->used_size--;
+        array_track_remove(array, 0, 1);
+        darray_hash_index_invalidate(array); ///< Every index moved down by one
+    }
     if (array_is_full(array)){
         if (!array_realloc(array)){return false;}
     }
-    void* pointer;
-    switch (array->type){
-        case INT:
-            pointer = array->dArray;
-            ((int*)pointer)[array->used_size] = *(int*)new_element;
-            break;
-        case FLOAT:
-            pointer = array->dArray;
-            ((float*)pointer)[array->used_size] = *(float*)new_element;
-            break;
-        case DOUBLE:
-            pointer = array->dArray;
-            ((double*)pointer)[array->used_size] = *(double*)new_element;
-            break;
-    }
+    memcpy(array_element(array, array->used_size), new_element, array->type_size);
     array->used_size++;
+    array_track_insert(array, array->used_size - 1, 1);
+    return true;
+}
+
+/**
+ * @brief Appends count elements from a plain C buffer to the end of the array
+ * @note The capacity is reserved once for the final size and the elements are
+ * copied with a single memcpy, so this is much cheaper than calling
+ * array_append() in a loop.
+ * 
+ * @param[in,out] array The target array
+ * @param[in]     src   Pointer to count elements of the array type, must not point inside array
+ * @param[in]     count How many elements will be appended
+ * @return              True if success, false if src is NULL or memory allocation fail
+ */
+bool array_append_n(dArray* array, const void* src, size_t count){
+    if (!array_is_writable(array)){return false;}
+    array_open_end(array);
+    if (count == 0){
+        return true;
+    }
+    if (!src){
+        darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Source buffer is NULL!");
+        return false;
+    }
+    if (count > SIZE_MAX - array->used_size){
+        darray_report(array, DARRAY_ERR_TOO_BIG, "Too many elements to append!");
+        return false;
+    }
+    size_t index = array->used_size;
+    array_overwrite_oldest(array, &index, &src, &count);
+    if (!array_grow_to(array, array->used_size + count)){return false;}
+
+    array_copy_in(array, array->used_size, src, count);
+    array->used_size += count;
+    array_track_insert(array, array->used_size - count, count);
+    return true;
+}
+
+/**
+ * @brief Appends all the elements of src to the end of dst
+ * @note Both arrays must store the same type, CUSTOM ones with the same element_size.
+ * Extending an array with itself is allowed and duplicates its content.
+ * 
+ * @param[in,out] dst The array that will receive the elements
+ * @param[in]     src The array whose elements will be copied
+ * @return            True if success, false if src is NULL, the types differ or memory allocation fail
+ */
+bool array_extend(dArray* dst, const dArray* src){
+    if (!array_is_writable(dst)){return false;}
+    if (!src){
+        darray_report(dst, DARRAY_ERR_INVALID_ARGUMENT, "Source array is NULL!");
+        return false;
+    }
+    if (dst->type != src->type || dst->type_size != src->type_size){
+        darray_report(dst, DARRAY_ERR_INVALID_ARGUMENT, "Both arrays must store the same type!");
+        return false;
+    }
+    size_t count = src->used_size;
+    if (count == 0){
+        return true;
+    }
+    if (count > SIZE_MAX - dst->used_size){
+        darray_report(dst, DARRAY_ERR_TOO_BIG, "Too many elements to append!");
+        return false;
+    }
+    if (dst->overwrite_oldest){
+        return array_extend_window(dst, src);
+    }
+    if (!array_grow_to(dst, dst->used_size + count)){return false;}
+    array_open_end(dst);
+
+    ///< The source parts are only taken after the reservation, so dst == src is safe
+    array_part parts[2];
+    array_parts(src, parts);
+    array_copy_in(dst, dst->used_size, parts[0].data, parts[0].size);
+    array_copy_in(dst, dst->used_size + parts[0].size, parts[1].data, parts[1].size);
+    dst->used_size += count;
+    array_track_insert(dst, dst->used_size - count, count);
+    return true;
+}
+
+/**
+ * @brief Inserts count elements from a plain C buffer starting at specified index
+ * @note The tail is moved only once with a single memmove, no matter how many
+ * elements are inserted.
+ * 
+ * @param[in,out] array The target array
+ * @param[in]     index Where the first new element will be placed (may be equal to the size)
+ * @param[in]     src   Pointer to count elements of the array type, must not point inside array
+ * @param[in]     count How many elements will be inserted
+ * @return              True if success, false if index is out of range or memory allocation fail
+ */
+bool array_insert_n(dArray* array, size_t index, const void* src, size_t count){
+    if (!array_is_writable(array)){return false;}
+    if (index > array->used_size){
+        darray_report(array, DARRAY_ERR_OUT_OF_RANGE, "Index out of range!");
+        return false;
+    }
+    if (count == 0){
+        return true;
+    }
+    if (!src){
+        darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Source buffer is NULL!");
+        return false;
+    }
+    if (count > SIZE_MAX - array->used_size){
+        darray_report(array, DARRAY_ERR_TOO_BIG, "Too many elements to insert!");
+        return false;
+    }
+    array_overwrite_oldest(array, &index, &src, &count);
+    if (count == 0){
+        return true;
+    }
+    if (!array_grow_to(array, array->used_size + count)){return false;}
+    if (array_ring_insert(array, index, src, count)){
+        return true;
+    }
+
+    size_t type_size = array->type_size;
+    if (array->storage == DARRAY_STORAGE_GAP){
+        ///< The new elements fill the beginning of the gap, nothing after it moves
+        array_move_gap(array, index);
+        memcpy((char*)array->dArray + index*type_size, src, count*type_size);
+        array->used_size += count;
+        array_track_insert(array, index, count);
+        return true;
+    }
+    char* source = (char*)array->dArray + index*type_size;
+    size_t bytes_to_move = (array->used_size - index)*type_size;
+    if (bytes_to_move > 0){
+        array_memmove(array, source + count*type_size, source, bytes_to_move);
+    }
+    memcpy(source, src, count*type_size);
+    array->used_size += count;
+    array_track_insert(array, index, count);
     return true;
 }
 
@@ -102,13 +370,23 @@ bool array_append(dArray* array, void* new_element){
  */
 bool array_delete(dArray** array){
     if (!array || !*array){
-        fprintf(stderr, "The array does not exist!\n");
+        darray_report(NULL, DARRAY_ERR_NULL, "The array does not exist!");
         return false;
     }
 
-    free((*array)->dArray);
+    darray_allocator allocator = (*array)->allocator; ///< Copied, the header is freed through it
+    darray_concurrent_free(*array);
+    darray_hash_index_free(*array);
+    if ((*array)->buffer_kind == DARRAY_BUFFER_MAPPED){
+        darray_unmap_file((*array)->mapping, (*array)->mapping_length);
+    } else if ((*array)->buffer_kind == DARRAY_BUFFER_HEAP){
+        size_t type_size = (*array)->type_size;
+        allocator.free(allocator.context, (*array)->dArray, (*array)->total_size * type_size);
+    }
     (*array)->dArray = NULL;
-    free(*array);
+    if ((*array)->owns_header){
+        allocator.free(allocator.context, *array, darray_header_bytes(*array));
+    }
     *array = NULL;
     return true;
 }
@@ -121,19 +399,62 @@ bool array_delete(dArray** array){
  * @returns                 True if popped successfully, false if there is not any elements to be popped
  */
 bool array_pop(dArray* array, void* store_var){
+    if (!array_is_writable(array)){return false;}
+    array_open_end(array);
     if (array->used_size == 0){
-        fprintf(stderr, "ERROR! The list does not have any elements!\n");
+        darray_report(array, DARRAY_ERR_EMPTY, "The list does not have any elements!");
         return false;
     }
 
+    darray_hash_index_drop(array, array->used_size - 1);
     array->used_size--;
-    size_t type_size = get_type_size(array->type);
-    void* source = ((char*)array->dArray) + array->used_size * type_size;
+    size_t type_size = array->type_size;
+    void* source = array_element(array, array->used_size);
 
     memcpy(store_var, source, type_size);
+    array_track_remove(array, array->used_size, 1);
+    array_auto_shrink(array);
     return true;
 }
 
+/**
+ * @brief Adds an element before the first one
+ * @note O(1) on DARRAY_STORAGE_RING arrays, other storages move every element like
+ * array_insert() at index 0. A full overwrite_oldest ring drops its last element to make room.
+ * 
+ * @param[in,out] array       The target array
+ * @param[in]     new_element The element that will become index 0
+ * @return True if success, false if memory allocation fail
+ */
+bool array_push_front(dArray* array, const void* new_element){
+    if (!array_is_writable(array)){return false;}
+    if (array_is_full(array) && array->overwrite_oldest){
+        darray_hash_index_drop(array, array->used_size - 1);
+        array->used_size--;
+        array_track_remove(array, array->used_size, 1);
+    }
+    return array_insert_n(array, 0, new_element, 1);
+}
+
+/**
+ * @brief Removes the first element and stores it on store_var
+ * @note O(1) on DARRAY_STORAGE_RING arrays, other storages move every element like
+ * array_remove_by_index() at index 0.
+ * 
+ * @param[in,out] array     The target array
+ * @param[out]    store_var A pointer to the variable that will store the removed value
+ * @return True if success, false if the array is empty
+ */
+bool array_pop_front(dArray* array, void* store_var){
+    if (!array_is_writable(array)){return false;}
+    if (array->used_size == 0){
+        darray_report(array, DARRAY_ERR_EMPTY, "The list does not have any elements!");
+        return false;
+    }
+    memcpy(store_var, array_element(array, 0), array->type_size);
+    return array_remove_by_index(array, 0);
+}
+
 /**
  * @brief Removes the first occurrence of specified element
  * 
@@ -142,55 +463,14 @@ bool array_pop(dArray* array, void* store_var){
  * @returns             True if success, false if the element was not found
  */
 bool array_remove_by_value(dArray* array, void* value){
-    int found_index = -1;
-    void* pointer = array->dArray;
-    for (int i=0; i < (int)array->used_size; i++){
-        switch(array->type){
-            case INT:
-                if (((int*)pointer)[i] == *(int*)value){
-                    found_index = i;
-                    break;
-                }
-                break;
-            case FLOAT:
-                if (((float*)pointer)[i] == *(float*)value){
-                    found_index = i;
-                    break;
-                } 
-                break;
-            case DOUBLE:
-                if (((double*)pointer)[i] == *(double*)value){
-                    found_index = i;
-                    break;
-                }
-                break;
-        }
-        if (found_index != -1){
-            break;
-        }
-    }
-
-    if (found_index == -1){
-        fprintf(stderr, "ERROR! Element not found!\n");
+    if (!array_is_writable(array)){return false;}
+    size_t found_index;
+    darray_hash_index_refresh(array);
+    if (!array_find_index(array, value, &found_index)){
+        darray_report(array, DARRAY_ERR_NOT_FOUND, "Element not found!");
         return false;
     }
-
-    for (int i = found_index; i < (int)array->used_size-1; i ++){
-        switch (array->type){
-            case INT:
-                ((int*)pointer)[i] = ((int*)pointer)[i+1];
-                break;
-            case FLOAT:
-                ((float*)pointer)[i] = ((float*)pointer)[i+1];
-                break;
-            case DOUBLE:
-                ((double*)pointer)[i] = ((double*)pointer)[i+1];
-                break;
-
-        }
-    }
-    array->used_size--;
-    return true;
+    return array_remove_by_index(array, found_index);
 }
 
 /**
@@ -201,18 +481,236 @@ bool array_remove_by_value(dArray* array, void* value){
  * @return              True if success, false if index is out of range.
  */
 bool array_remove_by_index(dArray* array, size_t index){
+    if (!array_is_writable(array)){return false;}
     if (index >= array->used_size){
-        fprintf(stderr, "ERROR! Index is out of range\n");
+        darray_report(array, DARRAY_ERR_OUT_OF_RANGE, "Index is out of range!");
         return false;
     }
-    size_t type_size = get_type_size(array->type);
+    if (index == array->used_size - 1){
+        darray_hash_index_drop(array, index); ///< Nothing moves, the index stays valid
+    }
+    if (array->storage == DARRAY_STORAGE_RING){
+        if (index == 0 || index == array->used_size - 1){
+            ///< The ends of a ring just move, the head forward when the first element goes
+            if (index == 0){
+                array->ring_head = array->ring_head + 1 == array->total_size ? 0 : array->ring_head + 1;
+            }
+            array->used_size--;
+            array_track_remove(array, index, 1);
+            array_auto_shrink(array);
+            return true;
+        }
+        array_flatten(array);
+    }
+    if (array->storage == DARRAY_STORAGE_GAP){
+        ///< With the gap right before it, the element just becomes part of the gap
+        array_move_gap(array, index);
+        array->used_size--;
+        array->gap_tail--;
+        array_track_remove(array, index, 1);
+        array_auto_shrink(array);
+        return true;
+    }
+    size_t type_size = array->type_size;
     size_t bytes_to_move = (array->used_size -1 - index)*type_size;
     if (bytes_to_move > 0){
         void* destination = (char*)array->dArray + (index*type_size);
         void* source = (char*)array->dArray + (index+1) *type_size;
-        memmove(destination, source, bytes_to_move);
+        array_memmove(array, destination, source, bytes_to_move);
     }
     array->used_size--;
+    array_track_remove(array, index, 1);
+    array_auto_shrink(array);
+    return true;
+}
+
+/**
+ * @brief Removes every element equal to value (==, so NaN never matches), in one pass
+ * Surviving elements keep their order and each one moves once at most.
+ * 
+ * @param[in,out] array The target array
+ * @param[in]     value Pointer to the value, of the array type
+ * @return              How many elements were removed
+ */
+size_t array_remove_all(dArray* array, const void* value){
+    if (!array_is_writable(array)){return 0;}
+    array_flatten(array);
+    size_t type_size = array->type_size;
+    char* data = array->dArray;
+    size_t size = array->used_size;
+    size_t write = array_scan_find(array, data, size, value);
+    DARRAY_COUNT(array, comparisons, size);
+    if (write == size){
+        return 0;
+    }
+    size_t removed_sorted = write < array->sorted_size;
+    size_t read = write + 1;
+    while (read < size){
+        size_t next = read + array_scan_find(array, data + read*type_size, size - read, value);
+        array_memmove(array, data + write*type_size, data + read*type_size, (next - read)*type_size);
+        write += next - read;
+        removed_sorted += next < array->sorted_size;
+        read = next + 1;
+    }
+    size_t removed = size - write;
+    array_finish_removal(array, write, removed_sorted);
+    return removed;
+}
+
+/**
+ * @brief Removes every element for which predicate returns true, in one pass
+ * Surviving elements keep their order and each one moves once at most.
+ * 
+ * @param[in,out] array     The target array
+ * @param[in]     predicate Called once per element, in order, with a pointer to it and context
+ * @param[in]     context   Passed to predicate as it is
+ * @return                  How many elements were removed
+ */
+size_t array_remove_if(dArray* array, darray_predicate predicate, void* context){
+    if (!array_is_writable(array)){return 0;}
+    array_flatten(array);
+    if (!predicate){
+        darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Invalid predicate!");
+        return 0;
+    }
+    size_t type_size = array->type_size;
+    char* data = array->dArray;
+    size_t size = array->used_size;
+    size_t write = 0, run_start = 0, removed_sorted = 0;
+    for (size_t i = 0; i < size; i++){
+        if (!predicate(data + i*type_size, context)){
+            continue;
+        }
+        ///< Moves the run of survivors before the removed element
+        array_memmove(array, data + write*type_size, data + run_start*type_size, (i - run_start)*type_size);
+        write += i - run_start;
+        run_start = i + 1;
+        removed_sorted += i < array->sorted_size;
+    }
+    array_memmove(array, data + write*type_size, data + run_start*type_size, (size - run_start)*type_size);
+    write += size - run_start;
+    size_t removed = size - write;
+    array_finish_removal(array, write, removed_sorted);
+    return removed;
+}
+
+/**
+ * @brief Removes the elements at the given indices, in one pass
+ * Nothing is removed if an index is out of range or the indices are not in ascending
+ * order. Repeated indices are removed once.
+ * 
+ * @param[in,out] array          The target array
+ * @param[in]     sorted_indices The indices, in ascending order
+ * @param[in]     count          How many indices
+ * @return                       True if success, false if the indices are not valid
+ */
+bool array_remove_indices(dArray* array, const size_t* sorted_indices, size_t count){
+    if (!array_is_writable(array)){return false;}
+    array_flatten(array);
+    if (count == 0){
+        return true;
+    }
+    if (!sorted_indices){
+        darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Invalid indices!");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++){
+        if (sorted_indices[i] >= array->used_size || (i > 0 && sorted_indices[i] < sorted_indices[i-1])){
+            darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Indices must be in range and in ascending order!");
+            return false;
+        }
+    }
+    size_t type_size = array->type_size;
+    char* data = array->dArray;
+    size_t write = sorted_indices[0], run_start = sorted_indices[0] + 1, removed_sorted = 0;
+    removed_sorted += sorted_indices[0] < array->sorted_size;
+    for (size_t i = 1; i < count; i++){
+        size_t index = sorted_indices[i];
+        if (index == sorted_indices[i-1]){
+            continue;
+        }
+        array_memmove(array, data + write*type_size, data + run_start*type_size, (index - run_start)*type_size);
+        write += index - run_start;
+        run_start = index + 1;
+        removed_sorted += index < array->sorted_size;
+    }
+    array_memmove(array, data + write*type_size, data + run_start*type_size, (array->used_size - run_start)*type_size);
+    write += array->used_size - run_start;
+    array_finish_removal(array, write, removed_sorted);
+    return true;
+}
+
+/**
+ * @brief Removes consecutive repeated elements, keeping the first of each group
+ * On a sorted array this leaves every value once. Elements are compared in the
+ * array_sort() order: -0.0 and +0.0 are different, NaNs are all the same. CUSTOM
+ * elements use the compare callback, or their bytes if there is none.
+ * 
+ * @param[in,out] array The target array
+ * @return              How many elements were removed
+ */
+size_t array_unique(dArray* array){
+    if (!array_is_writable(array)){return 0;}
+    array_flatten(array);
+    size_t type_size = array->type_size;
+    char* data = array->dArray;
+    size_t size = array->used_size;
+    if (size < 2){
+        return 0;
+    }
+    DARRAY_COUNT(array, comparisons, size - 1);
+    unsigned char small[sizeof(double)];
+    unsigned char* previous = type_size > sizeof(small) ? malloc(type_size) : small;
+    if (!previous){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
+        return 0;
+    }
+    memcpy(previous, data, type_size);
+    size_t write = 0, run_start = 0, removed_sorted = 0;
+    for (size_t i = 1; i < size; i++){
+        const void* element = data + i*type_size;
+        bool repeated = elements_equal(array, element, previous);
+        memcpy(previous, element, type_size); ///< Saved before any move can overwrite it
+        if (!repeated){
+            continue;
+        }
+        array_memmove(array, data + write*type_size, data + run_start*type_size, (i - run_start)*type_size);
+        write += i - run_start;
+        run_start = i + 1;
+        removed_sorted += i < array->sorted_size;
+    }
+    if (previous != small){
+        free(previous);
+    }
+    array_memmove(array, data + write*type_size, data + run_start*type_size, (size - run_start)*type_size);
+    write += size - run_start;
+    size_t removed = size - write;
+    array_finish_removal(array, write, removed_sorted);
+    return removed;
+}
+
+/**
+ * @brief Keeps only the elements in [start, start + count), with a single move
+ * 
+ * @param[in,out] array The target array
+ * @param[in]     start Index of the first element to keep
+ * @param[in]     count How many elements to keep
+ * @return              True if success, false if the range is out of bounds
+ */
+bool array_retain_range(dArray* array, size_t start, size_t count){
+    if (!array_is_writable(array)){return false;}
+    array_flatten(array);
+    if (start > array->used_size || count > array->used_size - start){
+        darray_report(array, DARRAY_ERR_OUT_OF_RANGE, "Range out of bounds!");
+        return false;
+    }
+    size_t type_size = array->type_size;
+    array_memmove(array, array->dArray, (char*)array->dArray + start*type_size, count*type_size);
+    size_t kept_sorted = 0;
+    if (start < array->sorted_size){
+        kept_sorted = array->sorted_size - start < count ? array->sorted_size - start : count;
+    }
+    array_finish_removal(array, count, array->sorted_size - kept_sorted);
     return true;
 }
 
@@ -226,11 +724,11 @@ bool array_remove_by_index(dArray* array, size_t index){
  */
 bool array_get(dArray* array, size_t index, void* store_variable){
     if (index >= array->used_size){
-        fprintf(stderr, "ERROR! Index out of range!\n");
+        darray_report(array, DARRAY_ERR_OUT_OF_RANGE, "Index out of range!");
         return false;
     }
-    size_t type_size = get_type_size(array->type);
-    void* temp_pointer = (char*)array->dArray + index*type_size;
+    size_t type_size = array->type_size;
+    void* temp_pointer = array_element(array, index);
     memcpy(store_variable, temp_pointer, type_size);
     return true;
 }
@@ -244,13 +742,16 @@ bool array_get(dArray* array, size_t index, void* store_variable){
  * @return                  True if succes, false if index is out of range
  */
 bool array_set(dArray* array, size_t index, void* new_value){
+    if (!array_is_writable(array)){return false;}
     if (index >= array->used_size){
-        printf("ERROR! Index out of range!\n");
+        darray_report(array, DARRAY_ERR_OUT_OF_RANGE, "Index out of range!");
         return false;
     } 
-    size_t type_size = get_type_size(array->type);
-    void* temp_pointer = (char*)array->dArray + index*type_size;
+    size_t type_size = array->type_size;
+    void* temp_pointer = array_element(array, index);
+    darray_hash_index_drop(array, index);
     memcpy(temp_pointer, new_value, type_size);
+    array_track_set(array, index);
     return true;
 }
 
@@ -273,8 +774,12 @@ bool array_is_empty(dArray* array){
  * @param[in,out] array The target array to be cleared
  */
 void array_clear(dArray* array){
-    if (array){ ///< Checks if the array pointer itself is not NULL
+    if (array && array_is_writable(array)){ ///< Checks if the array pointer itself is not NULL
         array->used_size = 0;
+        array->sorted_size = 0;
+        array->gap_tail = 0;
+        array->ring_head = 0;
+        darray_hash_index_invalidate(array);
     }
 }
 
@@ -289,154 +794,632 @@ void array_clear(dArray* array){
  * @return True if success, false if index is out of range or memory allocation fail
  */
 bool array_insert(dArray* array, size_t index, void* new_value){
+    if (!array_is_writable(array)){return false;}
     if (index > array->used_size){
-        fprintf(stderr, "ERROR! Index out of range!\n");
+        darray_report(array, DARRAY_ERR_OUT_OF_RANGE, "Index out of range!");
         return false;
     }
+    if (array->overwrite_oldest){
+        return array_insert_n(array, index, new_value, 1); ///< Drops the oldest element instead of growing
+    }
     
-    if (array->used_size + 1 >= array->total_size){ ///< Intencionally i decided to trigger the reallocation if there is only one space left, because yes.
+    if (array_is_full(array)){
         if (!array_realloc(array)){
-            fprintf(stderr, "ERROR! Unable to reallocate the array!\n");
+            darray_report(array, DARRAY_ERR_NO_MEMORY, "Unable to reallocate the array!");
             return false;
         }
     }
+    if (array_ring_insert(array, index, new_value, 1)){
+        return true;
+    }
 
-    size_t type_size = get_type_size(array->type);
+    size_t type_size = array->type_size;
+    if (array->storage == DARRAY_STORAGE_GAP){
+        array_move_gap(array, index);
+        memcpy((char*)array->dArray + index*type_size, new_value, type_size);
+        array->used_size++;
+        array_track_insert(array, index, 1);
+        return true;
+    }
 
     void    * source = (char*)array->dArray + index*type_size;
     void* destination = source+(type_size);
     size_t bytes_to_move = (array->used_size - index)* type_size;
     if (bytes_to_move > 0){
-        memmove(destination, source, bytes_to_move);
+        array_memmove(array, destination, source, bytes_to_move);
     }
     memcpy(source, new_value, type_size);
     array->used_size++; 
+    array_track_insert(array, index, 1);
     return true;
 }
 
+/**
+ * @brief Inserts a value at the position that keeps the array sorted
+ * @note If the array is not sorted yet, it is sorted first with array_sort().
+ * The value goes after the elements equal to it.
+ * 
+ * @param[in,out] array     The target array
+ * @param[in]     new_value The new value
+ * @return True if success, false if memory allocation fail
+ */
+bool array_insert_sorted(dArray* array, void* new_value){
+    if (!array_is_writable(array)){return false;}
+    if (array->sorted_size < array->used_size){
+        array_sort(array);
+    }
+    size_t header = 0, tail = array->used_size;
+    while (header < tail){
+        size_t middle = header + (tail - header)/2;
+        DARRAY_COUNT(array, comparisons, 1);
+        if (elements_in_order(array, array_element(array, middle), new_value)){
+            header = middle + 1;
+        } else {
+            tail = middle;
+        }
+    }
+    return array_insert(array, header, new_value);
+}
+
 /**
  * @brief Shrinks the array's size to be equals to used_size
- * Realloc's the array size to used_size, making used_size == total_size
+ * Realloc's the array size to used_size, making used_size == total_size.
+ * An empty array keeps room for one element. Calling it on an already shrinked array is a safe no-op.
  * @param[in,out] array The target array
- * @return True if success, false if the array has no elements or its already shrinked
+ * @return True if success, false if memory reallocation fail
  */
 bool array_shrink(dArray *array){
-    if (array->used_size == 0){
-        fprintf(stderr, "ERROR! The array have no elements!\n");
-        return false;
+    if (!array_is_writable(array)){return false;}
+    size_t new_size = array->used_size > 0 ? array->used_size : 1;
+    if (new_size == array->total_size){
+        return true;
     }
-    if (array->used_size == array->total_size){
-        fprintf(stderr, "ERROR! The array is already shrinked!\n");
+    if (!array_set_capacity(array, new_size)){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Unable to shrink the array!");
         return false;
     }
+    return true;
+}
 
-    size_t type_size = get_type_size(array->type);
-    void* temp = realloc(array->dArray, type_size*array->used_size);
-    if (temp){
-        array->dArray = temp;
-        array->total_size = array->used_size;
+/**
+ * @brief Makes sure the array can hold at least capacity elements without reallocating
+ * Unlike the automatic growth, the capacity becomes exactly the requested one.
+ * 
+ * @param[in,out] array    The target array
+ * @param[in]     capacity How many elements the array must be able to hold
+ * @return True if success, false if the size overflows or memory allocation fail
+ */
+bool array_reserve(dArray* array, size_t capacity){
+    if (!array_is_writable(array)){return false;}
+    if (capacity <= array->total_size){
         return true;
     }
-    fprintf(stderr, "ERROR! Unable to shrink the array!\n");
-    return false;
+    return array_set_capacity(array, capacity);
 }
 
 /**
- * @brief Find specified value and stores it's index at store_index
+ * @brief Makes the elements contiguous again, moving the gap of a DARRAY_STORAGE_GAP array
+ * to the end and rotating a DARRAY_STORAGE_RING array to slot 0
+ * The array keeps its storage, later inserts and removals open the gap again where they happen.
+ * Costs nothing on flat arrays.
  * 
- * @param[in]  array       The target
- * @param[in]  value       The value that you want to find
- * @param[out] store_index The variable that will store the index 
- * @return True if success, false if element not found
+ * @param[in,out] array The target array
+ * @return              True if success, false if the array is read-only
  */
-bool array_find(dArray* array, void* value, size_t* store_index){
-    int found_index = -1;
-    void* pointer = array->dArray;
-    for (int i=0; i < (int)array->used_size; i++){
-        switch(array->type){
-            case INT:
-                if (((int*)pointer)[i] == *(int*)value){
-                    found_index = i;
-                    break;
-                }
-                break;
-            case FLOAT:
-                if (((float*)pointer)[i] == *(float*)value){
-                    found_index = i;
-                    break;
-                } 
-                break;
-            case DOUBLE:
-                if (((double*)pointer)[i] == *(double*)value){
-                    found_index = i;
-                    break;
-                }
-                break;
-        }
-        if (found_index != -1){
-            break;
-        }
-    }
-    if (found_index == -1){
-        printf("ERROR! Element not found!\n");
+bool array_compact(dArray* array){
+    if (!array_is_writable(array)){return false;}
+    array_flatten(array);
+    return true;
+}
+
+/**
+ * @brief Changes how the array grows and shrinks
+ * When full, the new capacity is capacity*factor + step, limited to capacity + max_step.
+ * With auto_shrink, once pops and removes leave the array at a quarter of its capacity
+ * it shrinks to twice its size (never below the start_size given to array_new()). The
+ * gap between those two points keeps the array from thrashing between grow and shrink.
+ * 
+ * @param[in,out] array  The target array
+ * @param[in]     policy The new policy, @see DARRAY_GROWTH_DEFAULT
+ * @return True if success, false if factor is smaller than 1
+ */
+bool array_set_growth_policy(dArray* array, const darray_growth_policy* policy){
+    if (!(policy->factor >= 1.0)){
+        darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Growth factor must be at least 1!");
         return false;
     }
-    *store_index = (size_t)found_index;
+    array->growth = *policy;
     return true;
 }
 
 /**
- * @brief Utilizes C built-in qsort to sort the array
+ * @brief Get array->growth
  * 
- * @param[in,out] array The target array
+ * @param[in] array The target array
+ * @return The growth policy in use
  */
-void array_sort(dArray* array){
-    size_t type_size = get_type_size(array->type);
-    switch(array->type){
-        case INT:
-            qsort(array->dArray, array->used_size, type_size, compare_int);
-            return;
-        case FLOAT:
-            qsort(array->dArray, array->used_size, type_size, compare_float);
-            return;
-        case DOUBLE:
-            qsort(array->dArray, array->used_size, type_size, compare_double);
-            return;
-    }
+darray_growth_policy array_get_growth_policy(const dArray* array){
+    return array->growth;
 }
+
 /**
- * @brief Reverses the elements on the array, trade the first for the last and so on
+ * @brief Copies the counters of the work the array did since it was created or reset
+ * @note Counters are relaxed atomics, so reads from several threads at once (array_find()...)
+ * count safely, but a copy taken while another thread works may mix counters from before
+ * and after one of its calls. Builds with DARRAY_STATS 0 (the default with NDEBUG) have no counters.
  * 
- * @param[in, out] array The target array
- * @return True if success, false if unable to allocate auxiliar variable
+ * @param[in]  array       The target array
+ * @param[out] store_stats Where the counters are copied
+ * @return True if success, false if the library was built without counters (store_stats is zeroed)
  */
-bool array_reverse(dArray* array){
+bool array_get_stats(const dArray* array, darray_stats* store_stats){
+    memset(store_stats, 0, sizeof(*store_stats));
+#if DARRAY_STATS
+    store_stats->reallocs = atomic_load_explicit(&array->stats.reallocs, memory_order_relaxed);
+    store_stats->realloc_bytes = atomic_load_explicit(&array->stats.realloc_bytes, memory_order_relaxed);
+    store_stats->memmove_bytes = atomic_load_explicit(&array->stats.memmove_bytes, memory_order_relaxed);
+    store_stats->comparisons = atomic_load_explicit(&array->stats.comparisons, memory_order_relaxed);
+    store_stats->sorts = atomic_load_explicit(&array->stats.sorts, memory_order_relaxed);
+    store_stats->sorted_elements = atomic_load_explicit(&array->stats.sorted_elements, memory_order_relaxed);
+    store_stats->peak_capacity = atomic_load_explicit(&array->stats.peak_capacity, memory_order_relaxed);
+    return true;
+#else
+    (void)array;
+    return false;
+#endif
+}
+
+/**
+ * @brief Zeroes the counters, peak_capacity starts again from the current capacity
+ * 
+ * @param[in,out] array The target array
+ */
+void array_reset_stats(dArray* array){
+#if DARRAY_STATS
+    atomic_store_explicit(&array->stats.reallocs, 0, memory_order_relaxed);
+    atomic_store_explicit(&array->stats.realloc_bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&array->stats.memmove_bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&array->stats.comparisons, 0, memory_order_relaxed);
+    atomic_store_explicit(&array->stats.sorts, 0, memory_order_relaxed);
+    atomic_store_explicit(&array->stats.sorted_elements, 0, memory_order_relaxed);
+    atomic_store_explicit(&array->stats.peak_capacity, array->total_size, memory_order_relaxed);
+#else
+    (void)array;
+#endif
+}
+
+/**
+ * @brief Sets a function called after every capacity change of the array
+ * new_capacity > old_capacity is a growth, anything else a shrink. The hook must not
+ * change the array.
+ * 
+ * @param[in,out] array   The target array
+ * @param[in]     hook    The function, NULL to remove it
+ * @param[in]     context Passed to every call of hook
+ * @return True if success, false if the library was built without counters
+ */
+bool array_set_resize_hook(dArray* array, darray_resize_hook hook, void* context){
+#if DARRAY_STATS
+    array->resize_hook = hook;
+    array->resize_context = context;
+    return true;
+#else
+    (void)array;
+    (void)hook;
+    (void)context;
+    darray_report(array, DARRAY_ERR_UNSUPPORTED, "The library was built without DARRAY_STATS!");
+    return false;
+#endif
+}
+
+/**
+ * @brief Find specified value and stores it's index at store_index
+ * 
+ * @param[in]  array       The target
+ * @param[in]  value       The value that you want to find
+ * @param[out] store_index The variable that will store the index 
+ * @return True if success, false if element not found
+ */
+bool array_find(dArray* array, void* value, size_t* store_index){
+    darray_hash_index_refresh(array); ///< array_count() and the other const readers never rebuild it
+    if (!array_find_index(array, value, store_index)){
+        darray_report(array, DARRAY_ERR_NOT_FOUND, "Element not found!");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Finds every element equal to value in a single pass
+ * Works like snprintf: at most max_indices indexes are written, but the returned
+ * value is always the total number of matches, so the caller can detect truncation.
+ * 
+ * @param[in]  array         The target array
+ * @param[in]  value         The value that you want to find
+ * @param[out] store_indices Buffer for the indexes, in ascending order (may be NULL if max_indices is 0)
+ * @param[in]  max_indices   How many indexes fit in store_indices
+ * @return How many elements are equal to value
+ */
+size_t array_find_all(const dArray* array, const void* value, size_t* store_indices, size_t max_indices){
+    DARRAY_COUNT(array, comparisons, array->used_size);
+    size_t type_size = array->type_size;
+    size_t matches = 0, offset = 0;
+    array_part parts[2];
+    array_parts(array, parts);
+    for (int part = 0; part < 2; part++){
+        const char* data = parts[part].data;
+        size_t size = parts[part].size, position = 0;
+        while (position < size){
+            if (matches == max_indices){
+                ///< Buffer is full, the rest only needs to be counted
+                matches += array_scan_count(array, data + position*type_size, size - position, value);
+                break;
+            }
+            size_t found = array_scan_find(array, data + position*type_size, size - position, value);
+            if (found == size - position){
+                break;
+            }
+            store_indices[matches++] = offset + position + found;
+            position += found + 1;
+        }
+        offset += size;
+    }
+    return matches;
+}
+
+/**
+ * @brief Counts how many elements are equal to value
+ * Uses the hash index when it is up to date, a stale one is left for array_find() to rebuild.
+ * 
+ * @param[in] array The target array
+ * @param[in] value The value to be counted
+ * @return The number of matches
+ */
+size_t array_count(const dArray* array, const void* value){
+    size_t first, matches;
+    if (array->hash_index && darray_hash_index_lookup(array, value, &first, &matches)){
+        DARRAY_COUNT(array, comparisons, matches > 0);
+        return matches;
+    }
+    DARRAY_COUNT(array, comparisons, array->used_size);
+    array_part parts[2];
+    array_parts(array, parts);
+    return array_scan_count(array, parts[0].data, parts[0].size, value) +
+           array_scan_count(array, parts[1].data, parts[1].size, value);
+}
+
+/**
+ * @brief Sorts the array in ascending order
+ * Big arrays are sorted with radix sort and small ones with introsort, @see array_sort_ex()
+ * Sorting is incremental: elements that are already in order at the beginning of the
+ * array are not sorted again, only the rest is sorted and merged with them.
+ * @note For FLOAT and DOUBLE, -0.0 comes before +0.0 and NaNs are moved to the end.
+ * CUSTOM arrays are sorted with their compare callback and fail without one.
+ * 
+ * @param[in,out] array The target array
+ */
+void array_sort(dArray* array){
+    array_sort_ex(array, DARRAY_SORT_AUTO);
+}
+
+/**
+ * @brief Sorts the array in ascending order with the chosen algorithm
+ * Every algorithm gives exactly the same result, only the speed and the memory used change.
+ * 
+ * @param[in,out] array     The target array
+ * @param[in]     algorithm DARRAY_SORT_AUTO, DARRAY_SORT_RADIX or DARRAY_SORT_INTROSORT
+ * @return True if success, false if the algorithm is not valid or a CUSTOM array has no compare callback
+ */
+bool array_sort_ex(dArray* array, darray_sort_algo algorithm){
+    if (!array_is_writable(array)){return false;}
+    array_flatten(array);
+    if (array->sorted_size >= array->used_size){
+        return true;
+    }
+    if (array->type == CUSTOM){
+        return array_sort_custom(array);
+    }
+    ///< Only the unsorted tail is sorted, then it is merged with the sorted beginning
+    size_t split = array->sorted_size;
+    DARRAY_COUNT(array, sorts, 1);
+    DARRAY_COUNT(array, sorted_elements, array->used_size - split);
+    if (!darray_sort_buffer(array_element(array, split), array->used_size - split, array->type, algorithm)){
+        return false;
+    }
+    if (!darray_merge_buffer(array->dArray, split, array->used_size, array->type)){
+        darray_sort_buffer(array->dArray, array->used_size, array->type, algorithm);
+    }
+    array->sorted_size = array->used_size;
+    darray_hash_index_invalidate(array);
+    return true;
+}
+
+/**
+ * @brief Sorts the array with several threads, same result as array_sort()
+ * Small arrays (less than 65536 unsorted elements per thread) are sorted by the serial
+ * engine, as well as when there is no memory for the scratch buffer the threads share.
+ * 
+ * @param[in,out] array   The target array
+ * @param[in]     threads How many threads to use, 0 for one per online CPU
+ * @return True if success, false if the array is read-only
+ */
+bool array_sort_parallel(dArray* array, unsigned threads){
+    if (!array_is_writable(array)){return false;}
+    array_flatten(array);
+    if (array->sorted_size >= array->used_size){
+        return true;
+    }
+    if (array->type == CUSTOM){
+        return array_sort_custom(array);
+    }
+    if (!darray_sort_parallel(array->dArray, array->used_size, array->sorted_size, array->type, threads)){
+        return array_sort_ex(array, DARRAY_SORT_AUTO);
+    }
+    DARRAY_COUNT(array, sorts, 1);
+    DARRAY_COUNT(array, sorted_elements, array->used_size - array->sorted_size);
+    array->sorted_size = array->used_size;
+    darray_hash_index_invalidate(array);
+    return true;
+}
+
+/**
+ * @brief Tells if the array is known to be in ascending order
+ * The library keeps track of it on every change, so this costs nothing.
+ * @note Writes made through array_data() or array_span() can not be tracked, after
+ * those calls the array is considered unsorted until the next array_sort().
+ * 
+ * @param[in] array The target array
+ * @return True if sorted, false if not (or unknown)
+ */
+bool array_is_sorted(const dArray* array){
+    return array->sorted_size >= array->used_size;
+}
+
+/**
+ * @brief Reverses the elements on the array, trade the first for the last and so on
+ * 
+ * @param[in, out] array The target array
+ * @return True if success, false if unable to allocate auxiliar variable
+ */
+bool array_reverse(dArray* array){
+    if (!array_is_writable(array)){return false;}
+    array_flatten(array);
+    if (array->used_size < 2){
+        return true;
+    }
     char *header = NULL, *tail = NULL;
-    size_t type_size = get_type_size(array->type);
+    size_t type_size = array->type_size;
     header = (char*)array->dArray;
     tail = (char*)array->dArray + (array->used_size-1) * type_size;
     void* temp = malloc(type_size);
     if (!temp){
-        fprintf(stderr, "ERROR! Unable to allocate auxiliar variable!\n");
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Unable to allocate auxiliar variable!");
         return false;
     }
-    while(1){
+    while (header < tail){
         memcpy(temp, tail, type_size);
         memcpy(tail, header, type_size);
         memcpy(header, temp, type_size);
         header += type_size;
         tail -= type_size;
-        if (header == tail){
-            break;
+    }
+    free(temp);
+    array->sorted_size = 1;
+    array_track_extend(array, array->used_size);
+    darray_hash_index_invalidate(array);
+    return true;
+}
+
+/**
+ * @brief Puts at nth the element array_sort() would put there, with no bigger element
+ * before it and no smaller one after it (in no particular order on either side)
+ * Introselect: O(n) on average instead of the O(n log n) of a full sort, the median is
+ * array_nth_element(array, size/2). CUSTOM arrays are fully sorted with their compare callback.
+ * 
+ * @param[in,out] array The target array
+ * @param[in]     nth   The index to fill
+ * @return True if success, false if nth is out of range or a CUSTOM array has no compare callback
+ */
+bool array_nth_element(dArray* array, size_t nth){
+    if (!array_is_writable(array)){return false;}
+    if (nth >= array->used_size){
+        darray_report(array, DARRAY_ERR_OUT_OF_RANGE, "Index out of range!");
+        return false;
+    }
+    array_flatten(array);
+    if (array->sorted_size >= array->used_size){
+        return true;
+    }
+    if (array->type == CUSTOM){
+        return array_sort_custom(array);
+    }
+    darray_select_buffer(array->dArray, array->used_size, nth, array->type);
+    array->sorted_size = 1;
+    array_track_extend(array, array->used_size);
+    darray_hash_index_invalidate(array);
+    return true;
+}
+
+/**
+ * @brief Sorts only the count smallest elements into the beginning of the array
+ * The rest follows in no particular order. Selection first, then a sort of those count
+ * elements: O(n + count log count). The sorted beginning is tracked, so a later
+ * array_sort() only sorts the rest and merges it in.
+ * 
+ * @param[in,out] array The target array
+ * @param[in]     count How many elements to sort, the whole array if bigger than its size
+ * @return True if success, false if a CUSTOM array has no compare callback
+ */
+bool array_partial_sort(dArray* array, size_t count){
+    if (!array_is_writable(array)){return false;}
+    array_flatten(array);
+    if (count == 0 || array->sorted_size >= array->used_size){
+        return true;
+    }
+    if (count >= array->used_size || array->type == CUSTOM){
+        return array_sort_ex(array, DARRAY_SORT_AUTO);
+    }
+    DARRAY_COUNT(array, sorts, 1);
+    DARRAY_COUNT(array, sorted_elements, count);
+    darray_select_buffer(array->dArray, array->used_size, count, array->type);
+    darray_sort_buffer(array->dArray, count, array->type, DARRAY_SORT_AUTO);
+    array->sorted_size = count;
+    array_track_extend(array, array->used_size);
+    darray_hash_index_invalidate(array);
+    return true;
+}
+
+/**
+ * @brief Creates a new array with the k smallest or the k biggest elements, sorted
+ * The source array is not changed. Its elements are copied to the new array, which
+ * selects and sorts the k wanted ones, then shrinks to them.
+ * @note The biggest elements come in descending order. For FLOAT and DOUBLE, NaNs count
+ * as the biggest elements, like in array_sort().
+ * 
+ * @param[in] array   The source array
+ * @param[in] k       How many elements, all of them if bigger than the size of the array
+ * @param[in] largest True for the biggest elements, false for the smallest
+ * @return The new array (same type, allocator and callbacks), NULL if memory allocation
+ *         fail or a CUSTOM array has no compare callback
+ */
+dArray* array_top_k(const dArray* array, size_t k, bool largest){
+    if (!array){
+        darray_report(NULL, DARRAY_ERR_NULL, "The array does not exist!");
+        return NULL;
+    }
+    if (array->type == CUSTOM && !array->compare){
+        darray_report(array, DARRAY_ERR_UNSUPPORTED, "CUSTOM arrays need a compare callback to be sorted!");
+        return NULL;
+    }
+    size_t size = array->used_size;
+    if (k > size){
+        k = size;
+    }
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    options.allocator = &array->allocator;
+    if (array->type == CUSTOM){
+        options.element_size = array->type_size;
+        options.compare = array->compare;
+        options.hash = array->hash;
+    }
+    dArray* top = array_new_ex(array->type, size > 0 ? size : 1, &options);
+    if (!top){return NULL;}
+    size_t start = largest ? size - k : 0;
+    bool ok = array_extend(top, array);
+    if (ok && largest && k > 0){
+        ok = array_nth_element(top, start) && array_retain_range(top, start, k) &&
+             array_sort_ex(top, DARRAY_SORT_AUTO) && array_reverse(top);
+    } else if (ok){
+        ok = array_partial_sort(top, k) && array_retain_range(top, 0, k);
+    }
+    if (!ok){
+        array_delete(&top);
+        return NULL;
+    }
+    array_shrink(top);
+    return top;
+}
+
+/**
+ * @brief Stores the permutation that sorts the array: store_indices[i] is the index of
+ * the element array_sort() would put at i
+ * The array is not changed, apply the permutation to it (or to arrays of related data)
+ * with array_apply_permutation(). Equal elements keep their order, NaNs included.
+ * 
+ * @param[in]  array         The source array
+ * @param[out] store_indices Room for array_get_size() indices
+ * @return True if success, false if memory allocation fail or a CUSTOM array has no compare callback
+ */
+bool array_argsort(const dArray* array, size_t* store_indices){
+    if (!store_indices){
+        darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Invalid buffer!");
+        return false;
+    }
+    array_flatten(array);
+    bool sorted;
+    if (array->type == CUSTOM){
+        if (!array->compare){
+            darray_report(array, DARRAY_ERR_UNSUPPORTED, "CUSTOM arrays need a compare callback to be sorted!");
+            return false;
         }
-        if (header+type_size == tail){
-            memcpy(temp, tail, type_size);
-            memcpy(tail, header, type_size);
-            memcpy(header, temp, type_size);  
-            break;
+        sorted = darray_argsort_custom(array->dArray, array->used_size, array->type_size, array->compare, store_indices);
+    } else {
+        sorted = darray_argsort_buffer(array->dArray, array->used_size, array->type, store_indices);
+    }
+    if (!sorted){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Unable to allocate the sort buffer!");
+        return false;
+    }
+    DARRAY_COUNT(array, sorts, 1);
+    DARRAY_COUNT(array, sorted_elements, array->used_size);
+    return true;
+}
+
+/**
+ * @brief Reorders the array so the element at i is the one that was at permutation[i]
+ * With the output of array_argsort() of this array it sorts it, with the one of another
+ * array of the same size it puts this one in that array's order. The cycles of the
+ * permutation are followed in place, only one bit per element is allocated.
+ * 
+ * @param[in,out] array       The target array
+ * @param[in]     permutation array_get_size() distinct indices of the array
+ * @return True if success, false if permutation is not a permutation of the indices
+ *         (the array is left untouched) or memory allocation fail
+ */
+bool array_apply_permutation(dArray* array, const size_t* permutation){
+    if (!array_is_writable(array)){return false;}
+    size_t size = array->used_size;
+    if (!permutation){
+        darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Invalid permutation!");
+        return false;
+    }
+    if (size == 0){
+        return true;
+    }
+    unsigned char* pending = calloc(size/8 + 1, 1); ///< Bit i: slot i still waits for its element
+    void* temp = malloc(array->type_size);
+    if (!pending || !temp){
+        free(pending);
+        free(temp);
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Unable to allocate the permutation buffer!");
+        return false;
+    }
+    for (size_t i = 0; i < size; i++){
+        size_t source = permutation[i];
+        if (source >= size || pending[source/8] & (1u << (source%8))){
+            free(pending);
+            free(temp);
+            darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Invalid permutation!");
+            return false;
+        }
+        pending[source/8] |= (unsigned char)(1u << (source%8));
+    }
+    array_flatten(array);
+    size_t type_size = array->type_size;
+    char* data = array->dArray;
+    for (size_t start = 0; start < size; start++){
+        if (!(pending[start/8] & (1u << (start%8)))){
+            continue;
+        }
+        ///< Rotate the cycle that goes through start: each slot takes the element of the next one
+        memcpy(temp, data + start*type_size, type_size);
+        size_t slot = start;
+        while (1){
+            pending[slot/8] &= (unsigned char)~(1u << (slot%8));
+            size_t source = permutation[slot];
+            if (source == start){
+                memcpy(data + slot*type_size, temp, type_size);
+                break;
+            }
+            memcpy(data + slot*type_size, data + source*type_size, type_size);
+            slot = source;
         }
     }
+    free(pending);
     free(temp);
+    array->sorted_size = 1;
+    array_track_extend(array, size);
+    darray_hash_index_invalidate(array);
     return true;
 }
 
@@ -449,48 +1432,39 @@ bool array_reverse(dArray* array){
  * @param[in] array The target array
  * @param[in] element The element to be found
  * @param[out] store_index The variable that will store the found index
- * @param[in] already_sorted If false, it will use @see array_sort() to sort the array for you
+ * @param[in] already_sorted If false and the array is not known to be sorted, it will use @see array_sort() to sort the array for you
  * @return True if found, false if not found
  */
 bool array_binary_search(dArray* array, void* element, size_t* store_index, bool already_sorted){
-    if (!already_sorted){
-        array_sort(array);
+    array_flatten(array);
+    if (!already_sorted && array->sorted_size < array->used_size){
+        if (!array_sort_ex(array, DARRAY_SORT_AUTO)){return false;}
     }
-    size_t type_size = get_type_size(array->type);
-    size_t middle_value = array->used_size / 2;
-    void* middle_value_pointer = (char*)array->dArray + (middle_value*type_size);
-    int header = 0, tail = array->used_size-1;
-    int cmp;
-    while(1){
-        switch(array->type){
-            case INT:
-                cmp = compare_int(middle_value_pointer, element);
-                break;
-            case FLOAT:
-                cmp = compare_float(middle_value_pointer, element);
-                break;
-            case DOUBLE:
-                cmp = compare_double(middle_value_pointer, element);
-                break;
-        }
-
-        if (cmp == 0){
-            *store_index = middle_value;
-            return true;
-        }
-        if (cmp > 0){
-            tail = middle_value-1;
-        }
-        if (cmp < 0){
-            header = middle_value+1;
-        }
-        if (tail < header){
-            printf("NUMBER NOT FOUND!\n");
-            return false;
-        }
-        middle_value = header + (tail-header)/2;
-        middle_value_pointer = (char*)array->dArray + (middle_value*type_size);
+    bool found = false;
+    ///< One comparison per halving: the bit width of the size
+    DARRAY_COUNT(array, comparisons, array->used_size ? 64 - (unsigned)__builtin_clzll((unsigned long long)array->used_size) : 0);
+#define BINARY_SEARCH_CASE(TYPE, T, K, name) \
+        case TYPE: found = kernel_##name##_buf_binary_search(array->dArray, array->used_size, *(T*)element, store_index); break;
+    switch(array->type){
+        DARRAY_FOR_EACH_INTEGER(BINARY_SEARCH_CASE)
+        case FLOAT:
+            found = kernel_float_buf_binary_search(array->dArray, array->used_size, *(float*)element, store_index);
+            break;
+        case DOUBLE:
+            found = kernel_double_buf_binary_search(array->dArray, array->used_size, *(double*)element, store_index);
+            break;
+        case CUSTOM:
+            if (!array->compare){
+                darray_report(array, DARRAY_ERR_UNSUPPORTED, "CUSTOM arrays need a compare callback to be searched!");
+                return false;
+            }
+            found = array_custom_binary_search(array, element, store_index);
+            break;
     }
+    if (!found){
+        darray_report(array, DARRAY_ERR_NOT_FOUND, "Element not found!");
+    }
+    return found;
 }
 
 /**
@@ -513,92 +1487,320 @@ size_t array_get_capacity(const dArray* array) {
     return array ? array->total_size : 0;
 }
 
+/**
+ * @brief Get array->type
+ * 
+ * @param[in] array The target array
+ * @return array->type
+ */
+var_types array_get_type(const dArray* array) {
+    return array->type;
+}
+
+/**
+ * @brief Get the size in bytes of one element
+ * 
+ * @param[in] array The target array
+ * @return sizeof the array type, or the element_size of a CUSTOM array; 0 if array == NULL
+ */
+size_t array_get_element_size(const dArray* array) {
+    return array ? array->type_size : 0;
+}
+
+/**
+ * @brief Gives direct access to the elements buffer
+ * @note The pointer is invalidated by any call that may reallocate the array.
+ * Elements are contiguous, the first array_get_size() of them are valid.
+ * Since the elements may be changed through it, the array stops being considered sorted.
+ * 
+ * @param[in] array The target array
+ * @return Pointer to the first element, NULL if array == NULL or read-only (use array_data_const())
+ */
+void* array_data(dArray* array){
+    if (!array || !array_is_writable(array)){
+        return NULL;
+    }
+    array_flatten(array);
+    array->sorted_size = 0; ///< The caller may write anything through the pointer
+    darray_hash_index_invalidate(array);
+    return array->dArray;
+}
+
+/**
+ * @brief Read-only version of array_data()
+ * @note The elements of a gap or ring array are not contiguous: this call moves them into
+ * one run first, which writes to the buffer even though the array is const. Only flat
+ * arrays (or ones just compacted with array_compact()) can be read this way by several
+ * threads at once. The same goes for array_span_const() and the calls built on them:
+ * the reductions, array_argsort(), array_search_index_new(), array_save() and array_encode().
+ * 
+ * @param[in] array The target array
+ * @return Pointer to the first element, NULL if array == NULL
+ */
+const void* array_data_const(const dArray* array){
+    if (!array){
+        return NULL;
+    }
+    array_flatten(array);
+    return array->dArray;
+}
+
+/**
+ * @brief Creates a view over all the elements of the array
+ * Read the elements with the static inline accessors from darray.h, like darray_span_int(),
+ * there is no function call, bounds check or memcpy per element.
+ * Since the elements may be changed through it, the array stops being considered sorted.
+ * 
+ * @param[in] array The target array
+ * @return A span with the array's buffer, size and type, empty if the array is read-only
+ */
+darray_span array_span(dArray* array){
+    if (array && !array_is_writable(array)){
+        darray_span empty = {0};
+        return empty;
+    }
+    darray_span span = array_span_const(array);
+    if (array){
+        array->sorted_size = 0; ///< The caller may write anything through the span
+        darray_hash_index_invalidate(array);
+    }
+    return span;
+}
+
+/**
+ * @brief Same as array_span(), but the view must only be used to read the elements
+ * @note Makes the elements of gap and ring arrays contiguous first, @see array_data_const()
+ * 
+ * @param[in] array The target array
+ * @return A span with the array's buffer, size and type
+ */
+darray_span array_span_const(const dArray* array){
+    darray_span span = {0};
+    if (array){
+        array_flatten(array);
+        span.data = array->dArray;
+        span.size = array->used_size;
+        span.type_size = array->type_size;
+        span.type = array->type;
+    }
+    return span;
+}
+
+/**
+ * @brief Creates a view over count elements of the array, starting at start
+ * 
+ * @param[in]  array      The target array
+ * @param[in]  start      Index of the first element of the view
+ * @param[in]  count      How many elements the view will have
+ * @param[out] store_span The variable that will store the view
+ * @return True if success, false if the range does not fit in the array
+ */
+bool array_span_range(dArray* array, size_t start, size_t count, darray_span* store_span){
+    if (!array_is_writable(array)){return false;}
+    if (start > array->used_size || count > array->used_size - start){
+        darray_report(array, DARRAY_ERR_OUT_OF_RANGE, "Range out of bounds!");
+        return false;
+    }
+    *store_span = darray_span_sub(array_span(array), start, count);
+    return true;
+}
+
 //Static function implementation
 
 /**
- * @brief The actually mage here, this function reallocates the array based on it's size, grows 1.5x each time.
+ * @brief The actually mage here, this function grows the array by one step of its growth policy (1.5x by default)
  * 
  * @param[in,out] array The target array
  */
 static bool array_realloc(dArray* array){
-    size_t new_size = array->total_size + (array->total_size >> 1);
-    size_t type_size = get_type_size(array->type);
+    return array_grow_to(array, array->total_size + 1);
+}
 
-    if (new_size == array->total_size){
-        new_size = array->total_size+1;
+/**
+ * @brief Makes sure the array can hold at least min_capacity elements with a single reallocation
+ * The next capacity comes from the growth policy, but jumps straight to min_capacity
+ * when that is not enough, so bulk operations never reallocate more than once.
+ * 
+ * @param[in,out] array        The target array
+ * @param[in]     min_capacity How many elements the array must be able to hold
+ * @return True if success, false if the size overflows or memory allocation fail
+ */
+static bool array_grow_to(dArray* array, size_t min_capacity){
+    if (min_capacity <= array->total_size){
+        return true;
     }
-
+    const darray_growth_policy* policy = &array->growth;
+    size_t capacity = array->total_size;
+    double grown = (double)capacity * policy->factor + (double)policy->step;
+    size_t new_size = grown >= (double)SIZE_MAX ? SIZE_MAX : (size_t)grown;
+    if (policy->max_step > 0 && new_size - capacity > policy->max_step){
+        new_size = capacity + policy->max_step;
+    }
+    if (new_size < min_capacity){
+        new_size = min_capacity;
+    }
+    size_t type_size = array->type_size;
     if (type_size == 0){
-        fprintf(stderr, "ERROR! Unable to reallocate the array!\n");
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Unable to reallocate the array!");
         return false;
     }
-    void* temp = realloc(array->dArray, new_size*type_size);
-    if (temp){
-        array->dArray = temp;;
-        array->total_size = new_size;
-        return true;
+    if (new_size > SIZE_MAX / type_size){
+        new_size = min_capacity; ///< The policy overshoots, the exact request may still fit
     }
-    fprintf(stderr, "ERROR! Unable to reallocate a bigger array");
-    return false;
+    return array_set_capacity(array, new_size);
+}
+
+/**
+ * @brief Reallocates the buffer to exactly new_capacity elements
+ * 
+ * @param[in,out] array        The target array
+ * @param[in]     new_capacity The new total_size, must not be smaller than used_size
+ * @return True if success, false if the size overflows or memory reallocation fail
+ */
+static bool array_set_capacity(dArray* array, size_t new_capacity){
+    bool ring_grows = array->storage == DARRAY_STORAGE_RING && new_capacity > array->total_size;
+    if (!ring_grows){
+        array_flatten(array); ///< realloc keeps the bytes where they are, the gap must be at the end
+    }
+    size_t old_capacity = array->total_size;
+    size_t type_size = array->type_size;
+    if (new_capacity > SIZE_MAX / type_size){
+        darray_report(array, DARRAY_ERR_TOO_BIG, "Requested capacity is too big!");
+        return false;
+    }
+    if (!array_resize_buffer(array, new_capacity)){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Unable to reallocate the array!");
+        return false;
+    }
+    char* data = array->dArray;
+    array_note_resize(array, old_capacity, new_capacity);
+    if (ring_grows && array->ring_head + array->used_size > old_capacity){
+        ///< Unwraps the ring: the smaller of its two parts moves into the new space
+        size_t head_part = old_capacity - array->ring_head;
+        size_t wrapped = array->used_size - head_part;
+        if (wrapped <= new_capacity - old_capacity && wrapped <= head_part){
+            array_memmove(array, data + old_capacity*type_size, data, wrapped*type_size);
+        } else {
+            size_t new_head = new_capacity - head_part;
+            array_memmove(array, data + new_head*type_size, data + array->ring_head*type_size, head_part*type_size);
+            array->ring_head = new_head;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Gives memory back when the array got much smaller than its capacity
+ * Runs after pops and removes. Shrinks at a quarter of the capacity down to twice the size,
+ * so it takes many more operations before the array needs to grow or shrink again.
+ * 
+ * @param[in,out] array The target array
+ */
+static void array_auto_shrink(dArray* array){
+    if (!array->growth.auto_shrink || array->total_size <= array->min_capacity){
+        return;
+    }
+    if (array->used_size > array->total_size / 4){
+        return;
+    }
+    size_t new_size = array->used_size * 2;
+    if (new_size < array->min_capacity){
+        new_size = array->min_capacity;
+    }
+    if (new_size < array->total_size){
+        array_flatten(array);
+        size_t old_capacity = array->total_size;
+        if (array_resize_buffer(array, new_size)){ ///< If it fails the array just keeps the bigger buffer
+            array_note_resize(array, old_capacity, new_size);
+        }
+    }
+}
+
+/**
+ * @brief Silent linear search shared by array_find() and array_remove_by_value()
+ * Runs the vectorized kernel picked at startup, @see darray_simd.c
+ * 
+ * @param[in]  array       The target array
+ * @param[in]  value       The value that you want to find
+ * @param[out] store_index The variable that will store the index of the first occurrence
+ * @return True if found, false if not
+ */
+static bool array_find_index(const dArray* array, const void* value, size_t* store_index){
+    size_t index, matches;
+    if (array->hash_index && darray_hash_index_lookup(array, value, store_index, &matches)){
+        DARRAY_COUNT(array, comparisons, matches > 0);
+        return matches > 0;
+    }
+    ///< Searches the two parts of a ring or gap buffer where they are, nothing moves
+    array_part parts[2];
+    array_parts(array, parts);
+    index = array_scan_find(array, parts[0].data, parts[0].size, value);
+    if (index == parts[0].size && parts[1].size > 0){
+        index += array_scan_find(array, parts[1].data, parts[1].size, value);
+    }
+    DARRAY_COUNT(array, comparisons, index < array->used_size ? index + 1 : index);
+    if (index == array->used_size){
+        return false;
+    }
+    *store_index = index;
+    return true;
 }
 
 /**
- * @brief Required function to qsort work, @see array_sort()
- * Compares the first number with the second one.
+ * @brief get_type_size() for the other translation units of the library
  * 
- * @param[in] a The first element
- * @param[in] b The second element
- * @return 1 if first is bigger, 0 if is equal and -1 if it's smaller
+ * @param[in] type Is the a var_types type
+ * @return sizeof(type), 0 if the type is not valid or CUSTOM
  */
-int compare_int(const void* a, const void* b) {
-   return (*(int*)a - *(int*)b);
+size_t darray_type_size(var_types type){
+    return get_type_size(type);
 }
 
 /**
- * @brief Required function to qsort work, @see array_sort()
- * Compares the first number with the second one.
+ * @brief array_element() for the other translation units of the library
  * 
- * @param[in] a The first element
- * @param[in] b The second element
- * @return 1 if first is bigger, 0 if is equal and -1 if it's smaller
+ * @param[in] array The target array
+ * @param[in] index The index, no bounds check
+ * @return The element's address inside the buffer, whatever the storage
  */
-int compare_float(const void* a, const void* b) {
-   float var_a = *(const float*)a;
-   float var_b = *(const float*)b;
-   if (var_a > var_b){return 1;}
-   if (var_a < var_b){return -1;}
-   else{return 0;}
+const void* darray_element_at(const dArray* array, size_t index){
+    return array_element(array, index);
 }
 
 /**
- * @brief Required function to qsort work, @see array_sort()
- * Compares the first number with the second one.
+ * @brief Checks if the array may be changed: arrays mapped from files are read-only,
+ * and arrays in concurrent mode only take array_append_concurrent() until array_seal()
  * 
- * @param[in] a The first element
- * @param[in] b The second element
- * @return 1 if first is bigger, 0 if is equal and -1 if it's smaller
+ * @param[in] array The target array
+ * @return True if writable, false if not
  */
-int compare_double(const void* a, const void* b) {
-   double var_a = *(const double*)a;
-   double var_b = *(const double*)b;
-   if (var_a > var_b){return 1;}
-   if (var_a < var_b){return -1;}
-   else{return 0;}
+static bool array_is_writable(const dArray* array){
+    if (array->buffer_kind == DARRAY_BUFFER_MAPPED){
+        darray_report(array, DARRAY_ERR_READ_ONLY, "The array is read-only!");
+        return false;
+    }
+    if (array->concurrent){
+        darray_report(array, DARRAY_ERR_STATE, "The array is in concurrent mode, call array_seal() first!");
+        return false;
+    }
+    return true;
 }
 
 /**
  * @brief One of the most called funwelction, enters the enum var_types type and return it's size
  * 
- * @param[in] type Is the a var_types type (INT, FLOAT, DOUBLE)
- * @return sizeof(type)
+ * @param[in] type Is the a var_types type
+ * @return sizeof(type), 0 for CUSTOM
  */
 size_t get_type_size(var_types type){
+#define TYPE_SIZE_CASE(TYPE, T, K, name) case TYPE: return sizeof(T);
     switch(type){
-        case INT: return sizeof(int);
+        DARRAY_FOR_EACH_INTEGER(TYPE_SIZE_CASE)
         case FLOAT: return sizeof(float);
         case DOUBLE: return sizeof(double);
+        case CUSTOM: return 0; ///< Every CUSTOM array has its own, @see dArray.type_size
     }
-    fprintf(stderr, "ERROR! Invalid type!\n");
+    darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Invalid type!");
     return 0;
 }
 
@@ -613,4 +1815,601 @@ static bool array_is_full(dArray* array){
         return true;
     }
     return false;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Pointer to the element at specified index, no bounds check
+ * 
+ * @param[in] array The target array
+ * @param[in] index The specified index
+ * @return The element's address inside the buffer
+ */
+static inline void* array_element(const dArray* array, size_t index){
+    if (array->ring_head > 0){
+        index += array->ring_head;
+        if (index >= array->total_size){
+            index -= array->total_size; ///< Wraps around the end of the buffer
+        }
+    } else if (array->gap_tail > 0 && index >= array->used_size - array->gap_tail){
+        index += array->total_size - array->used_size; ///< Skips the gap
+    }
+    return (char*)array->dArray + index*array->type_size;
+}
+
+/**
+ * @brief Checks if first may come before second in array_sort() order
+ * CUSTOM elements use the compare callback; without one nothing is ever in order,
+ * so such arrays never count as sorted.
+ * 
+ * @param[in] array  The array of both elements
+ * @param[in] first  Pointer to the first element
+ * @param[in] second Pointer to the second element
+ * @return True if first <= second in sort order (NaNs are bigger than everything)
+ */
+static bool elements_in_order(const dArray* array, const void* first, const void* second){
+#define IN_ORDER_CASE(TYPE, T, K, name) case TYPE: return *(const T*)first <= *(const T*)second;
+    switch(array->type){
+        DARRAY_FOR_EACH_INTEGER(IN_ORDER_CASE)
+        case FLOAT: return key_float(*(const float*)first) <= key_float(*(const float*)second);
+        case DOUBLE: return key_double(*(const double*)first) <= key_double(*(const double*)second);
+        case CUSTOM: return array->compare && array->compare(first, second) <= 0;
+    }
+    return false;
+}
+
+/**
+ * @brief Checks if two elements are equal the way find and count see it
+ * The C == operator for the built-in types, the compare callback for CUSTOM
+ * elements, or their bytes if there is no callback.
+ */
+static bool elements_equal(const dArray* array, const void* first, const void* second){
+    if (array->type != CUSTOM){
+        return elements_in_order(array, first, second) && elements_in_order(array, second, first);
+    }
+    if (array->compare){
+        return array->compare(first, second) == 0;
+    }
+    return memcmp(first, second, array->type_size) == 0;
+}
+
+/**
+ * @brief darray_simd_find() that also handles CUSTOM elements
+ * @return The index of the first element equal to value, or size if there is none
+ */
+static size_t array_scan_find(const dArray* array, const void* data, size_t size, const void* value){
+    if (array->type != CUSTOM){
+        return darray_simd_find(data, size, value, array->type);
+    }
+    for (size_t i = 0; i < size; i++){
+        if (elements_equal(array, (const char*)data + i*array->type_size, value)){
+            return i;
+        }
+    }
+    return size;
+}
+
+/**
+ * @brief darray_simd_count() that also handles CUSTOM elements
+ * @return How many elements are equal to value
+ */
+static size_t array_scan_count(const dArray* array, const void* data, size_t size, const void* value){
+    if (array->type != CUSTOM){
+        return darray_simd_count(data, size, value, array->type);
+    }
+    size_t matches = 0;
+    for (size_t i = 0; i < size; i++){
+        matches += elements_equal(array, (const char*)data + i*array->type_size, value);
+    }
+    return matches;
+}
+
+/**
+ * @brief Grows the sorted beginning of the array while the next elements are in order
+ * 
+ * @param[in,out] array The target array
+ * @param[in]     limit The sorted beginning never grows past this index
+ */
+static void array_track_extend(dArray* array, size_t limit){
+    if (array->sorted_size == 0 && limit > 0){
+        array->sorted_size = 1;
+    }
+    while (array->sorted_size < limit &&
+           elements_in_order(array, array_element(array, array->sorted_size - 1), array_element(array, array->sorted_size))){
+        array->sorted_size++;
+    }
+}
+
+/**
+ * @brief Updates the sorted beginning after count elements were placed at index
+ * Costs O(count), only the new elements and their neighbours are compared. The hash
+ * index takes appended elements in, any other insert makes it stale.
+ * 
+ * @param[in,out] array The target array, used_size already includes the new elements
+ * @param[in]     index Where the first new element is
+ * @param[in]     count How many elements were inserted
+ */
+static void array_track_insert(dArray* array, size_t index, size_t count){
+    if (index + count == array->used_size){
+        darray_hash_index_add(array, index, count);
+    } else {
+        darray_hash_index_invalidate(array); ///< The elements after the new ones moved
+    }
+    if (index > array->sorted_size){
+        return;
+    }
+    if (index == array->sorted_size){
+        array_track_extend(array, index + count);
+        return;
+    }
+    ///< Inside the sorted part, it stays sorted only if the new run fits between its neighbours
+    size_t first = index > 0 ? index - 1 : 0;
+    for (size_t i = first; i < index + count; i++){
+        if (!elements_in_order(array, array_element(array, i), array_element(array, i + 1))){
+            array->sorted_size = index;
+            return;
+        }
+    }
+    array->sorted_size += count;
+}
+
+/**
+ * @brief Updates the sorted beginning and the hash index after the element at index was overwritten
+ * 
+ * @param[in,out] array The target array
+ * @param[in]     index The index that changed
+ */
+static void array_track_set(dArray* array, size_t index){
+    darray_hash_index_add(array, index, 1);
+    if (index > array->sorted_size){
+        return;
+    }
+    if (index == array->sorted_size){
+        array_track_extend(array, index + 1);
+        return;
+    }
+    bool fits = true;
+    if (index > 0){
+        fits = elements_in_order(array, array_element(array, index - 1), array_element(array, index));
+    }
+    if (fits && index + 1 < array->sorted_size){
+        fits = elements_in_order(array, array_element(array, index), array_element(array, index + 1));
+    }
+    if (!fits){
+        array->sorted_size = index;
+    }
+}
+
+/**
+ * @brief Updates the sorted beginning after count elements starting at index were removed
+ * Removing elements never breaks the order of the ones that are left. Removals before
+ * the end make the hash index stale.
+ * 
+ * @param[in,out] array The target array, used_size already excludes the removed elements
+ * @param[in]     index Where the first removed element was
+ * @param[in]     count How many elements were removed
+ */
+static void array_track_remove(dArray* array, size_t index, size_t count){
+    if (index < array->used_size){
+        darray_hash_index_invalidate(array); ///< Removals at the end were dropped from it by the caller
+    }
+    if (index >= array->sorted_size){
+        return;
+    }
+    if (array->sorted_size <= index + count){
+        array->sorted_size = index;
+    } else {
+        array->sorted_size -= count;
+    }
+}
+
+/**
+ * @brief Shared end of the bulk removals: sets the new size, drops the removed elements
+ * from the sorted beginning (what survives of it is still in order) and shrinks if needed
+ * 
+ * @param[in,out] array          The target array
+ * @param[in]     new_size       How many elements survived
+ * @param[in]     removed_sorted How many of the removed elements were in the sorted beginning
+ */
+static void array_finish_removal(dArray* array, size_t new_size, size_t removed_sorted){
+    array->used_size = new_size;
+    array->sorted_size -= removed_sorted;
+    darray_hash_index_invalidate(array);
+    array_auto_shrink(array);
+}
+
+/**
+ * @brief Moves the gap of a DARRAY_STORAGE_GAP array so that it begins at index
+ * Only the elements between the old and the new position move.
+ * 
+ * @param[in,out] array The target array
+ * @param[in]     index The logical index where the gap will begin (0 to used_size)
+ */
+static void array_move_gap(dArray* array, size_t index){
+    size_t gap_start = array->used_size - array->gap_tail;
+    if (array->storage != DARRAY_STORAGE_GAP || index == gap_start){
+        return;
+    }
+    size_t type_size = array->type_size;
+    size_t gap = array->total_size - array->used_size;
+    char* data = array->dArray;
+    if (gap > 0){
+        if (index < gap_start){
+            array_memmove(array, data + (index + gap)*type_size, data + index*type_size, (gap_start - index)*type_size);
+        } else {
+            array_memmove(array, data + gap_start*type_size, data + (gap_start + gap)*type_size, (index - gap_start)*type_size);
+        }
+    }
+    array->gap_tail = array->used_size - index;
+}
+
+/**
+ * @brief Moves the gap to the end, so the buffer holds the elements contiguously like a flat array
+ * Moving the gap does not change the contents, which is why const arrays are accepted.
+ * 
+ * @param[in] array The target array
+ */
+static void array_flatten(const dArray* array){
+    if (array->storage == DARRAY_STORAGE_GAP){
+        array_move_gap((dArray*)array, array->used_size);
+    } else if (array->ring_head > 0){
+        array_rotate_ring((dArray*)array);
+    }
+}
+
+/**
+ * @brief The elements as two contiguous runs in index order, without moving anything
+ * A gap buffer splits around its gap and a ring where it wraps around the end of the
+ * buffer, readers scan both parts in place instead of calling array_flatten().
+ * 
+ * @param[in]  array The target array
+ * @param[out] parts The runs, the second one is empty (size 0) when the elements are contiguous
+ */
+static void array_parts(const dArray* array, array_part parts[2]){
+    size_t type_size = array->type_size;
+    const char* data = array->dArray;
+    size_t first = array->used_size;
+    const char* second = data;
+    if (array->storage == DARRAY_STORAGE_GAP){
+        first = array->used_size - array->gap_tail;
+        second = data + (array->total_size - array->gap_tail)*type_size;
+    } else if (array->storage == DARRAY_STORAGE_RING){
+        data += array->ring_head*type_size;
+        if (first > array->total_size - array->ring_head){
+            first = array->total_size - array->ring_head;
+        }
+    }
+    parts[0] = (array_part){data, first};
+    parts[1] = (array_part){second, array->used_size - first};
+}
+
+/**
+ * @brief Makes the slot after the last element reachable with array_element()
+ * Only a gap buffer needs work (its gap goes to the end), a ring already wraps its free
+ * slots after the last element, so appends and pops at the end never rotate it.
+ */
+static void array_open_end(dArray* array){
+    if (array->storage == DARRAY_STORAGE_GAP){
+        array_move_gap(array, array->used_size);
+    }
+}
+
+/**
+ * @brief Copies count elements to the slots of indices [index, index + count)
+ * The slots must be allocated already, a ring may wrap them around the end of the buffer.
+ */
+static void array_copy_in(dArray* array, size_t index, const void* src, size_t count){
+    size_t type_size = array->type_size;
+    size_t slot = index, first = count;
+    if (array->storage == DARRAY_STORAGE_RING){
+        slot = (array->ring_head + index) % array->total_size;
+        if (first > array->total_size - slot){
+            first = array->total_size - slot;
+        }
+    }
+    memcpy((char*)array->dArray + slot*type_size, src, first*type_size);
+    memcpy(array->dArray, (const char*)src + first*type_size, (count - first)*type_size);
+}
+
+/**
+ * @brief Inserts at either end of a ring without moving elements, the capacity must be reserved
+ * @return True if done, false if the array is not a ring or index is in the middle (rotate it and insert as usual)
+ */
+static bool array_ring_insert(dArray* array, size_t index, const void* src, size_t count){
+    if (array->storage != DARRAY_STORAGE_RING){
+        return false;
+    }
+    if (index != 0 && index != array->used_size){
+        array_flatten(array);
+        return false;
+    }
+    if (index == 0){
+        array->ring_head = (array->ring_head + array->total_size - count) % array->total_size;
+    }
+    array_copy_in(array, index, src, count);
+    array->used_size += count;
+    array_track_insert(array, index, count);
+    return true;
+}
+
+/**
+ * @brief Rotates a ring so that its first element is in slot 0 again
+ * A ring that does not wrap needs one memmove. A wrapped one is rotated in place with
+ * three reversals, each element is swapped twice and no extra memory is needed.
+ */
+static void array_rotate_ring(dArray* array){
+    size_t type_size = array->type_size;
+    char* data = array->dArray;
+    size_t head = array->ring_head;
+    if (head + array->used_size <= array->total_size){
+        array_memmove(array, data, data + head*type_size, array->used_size*type_size);
+    } else {
+        size_t ranges[3][2] = {{0, head}, {head, array->total_size}, {0, array->total_size}};
+        DARRAY_COUNT(array, memmove_bytes, 2*array->total_size*type_size); ///< Every element is swapped twice
+        for (int r = 0; r < 3; r++){
+            size_t low = ranges[r][0], high = ranges[r][1];
+            while (low + 1 < high){
+                char* left = data + low*type_size;
+                char* right = data + (high - 1)*type_size;
+                for (size_t b = 0; b < type_size; b++){
+                    char byte = left[b];
+                    left[b] = right[b];
+                    right[b] = byte;
+                }
+                low++;
+                high--;
+            }
+        }
+    }
+    array->ring_head = 0;
+}
+
+/**
+ * @brief memmove() inside the array buffer, counted in the stats
+ */
+static inline void array_memmove(dArray* array, void* destination, const void* source, size_t bytes){
+    DARRAY_COUNT(array, memmove_bytes, bytes);
+    memmove(destination, source, bytes);
+}
+
+/**
+ * @brief Counts a capacity change and tells the resize hook about it
+ */
+static void array_note_resize(dArray* array, size_t old_capacity, size_t new_capacity){
+#if DARRAY_STATS
+    size_t kept = old_capacity < new_capacity ? old_capacity : new_capacity;
+    DARRAY_COUNT(array, reallocs, 1);
+    DARRAY_COUNT(array, realloc_bytes, kept*array->type_size);
+    if (new_capacity > atomic_load_explicit(&array->stats.peak_capacity, memory_order_relaxed)){
+        atomic_store_explicit(&array->stats.peak_capacity, new_capacity, memory_order_relaxed);
+    }
+    if (array->resize_hook){
+        array->resize_hook(array, old_capacity, new_capacity, array->resize_context);
+    }
+#else
+    (void)array;
+    (void)old_capacity;
+    (void)new_capacity;
+#endif
+}
+
+/**
+ * @brief Sorts a CUSTOM array with its compare callback
+ * The whole array is sorted at once, the algorithm choice does not apply.
+ * 
+ * @param[in,out] array The target array, already flattened
+ * @return True if success, false if the array has no compare callback
+ */
+static bool array_sort_custom(dArray* array){
+    if (!array->compare){
+        darray_report(array, DARRAY_ERR_UNSUPPORTED, "CUSTOM arrays need a compare callback to be sorted!");
+        return false;
+    }
+    DARRAY_COUNT(array, sorts, 1);
+    DARRAY_COUNT(array, sorted_elements, array->used_size - array->sorted_size);
+    darray_sort_custom(array->dArray, array->used_size, array->type_size, array->compare);
+    array->sorted_size = array->used_size;
+    darray_hash_index_invalidate(array);
+    return true;
+}
+
+/**
+ * @brief Binary search of a sorted CUSTOM array, index of the first match
+ * 
+ * @param[in]  array       The target array, sorted and flattened
+ * @param[in]  element     The element to be found
+ * @param[out] store_index The variable that will store the found index
+ * @return True if found, false if not found
+ */
+static bool array_custom_binary_search(const dArray* array, const void* element, size_t* store_index){
+    size_t header = 0, tail = array->used_size;
+    while (header < tail){
+        size_t middle = header + (tail - header)/2;
+        if (array->compare(array_element(array, middle), element) < 0){
+            header = middle + 1;
+        } else {
+            tail = middle;
+        }
+    }
+    if (header < array->used_size && array->compare(array_element(array, header), element) == 0){
+        *store_index = header;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Validates the type and the options of a new array
+ * 
+ * @param[in]  type            The type that the array will store
+ * @param[in]  options         The options
+ * @param[out] store_allocator The allocator to use, the system one when options has none
+ * @return The size of one element, 0 if something is invalid (already reported)
+ */
+static size_t array_check_options(var_types type, const darray_options* options, const darray_allocator** store_allocator){
+    const darray_allocator* allocator = options->allocator;
+    if (options->storage != DARRAY_STORAGE_FLAT && options->storage != DARRAY_STORAGE_GAP &&
+        options->storage != DARRAY_STORAGE_RING){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Invalid storage!");
+        return 0;
+    }
+    if (options->overwrite_oldest && options->storage != DARRAY_STORAGE_RING){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "overwrite_oldest needs DARRAY_STORAGE_RING!");
+        return 0;
+    }
+    if (!allocator){
+        allocator = array_system_allocator();
+    }
+    if (!allocator->alloc || !allocator->realloc || !allocator->free){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Invalid allocator!");
+        return 0;
+    }
+
+    size_t type_size = type == CUSTOM ? options->element_size : get_type_size(type);
+    if (type_size == 0){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Unknown type or CUSTOM without element_size!");
+        return 0;
+    }
+    if (type != CUSTOM && ((options->element_size != 0 && options->element_size != type_size) || options->compare || options->hash)){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "element_size, compare and hash are only for CUSTOM!");
+        return 0;
+    }
+    *store_allocator = allocator;
+    return type_size;
+}
+
+/**
+ * @brief Fills the header of a new, empty array whose buffer is the inline one
+ * The caller sets owns_header, and the buffer when there is no inline capacity.
+ * Shared with array_map_file(), which then points the header at the mapping.
+ * 
+ * @param[out] array           The header
+ * @param[in]  type            The type that the array will store
+ * @param[in]  type_size       The size of one element
+ * @param[in]  capacity        The total_size and the min_capacity
+ * @param[in]  inline_capacity How many elements fit after the header
+ * @param[in]  options         The validated options
+ * @param[in]  allocator       The validated allocator
+ */
+void darray_init_header(dArray* array, var_types type, size_t type_size, size_t capacity, size_t inline_capacity,
+                        const darray_options* options, const darray_allocator* allocator){
+    array->dArray = inline_capacity > 0 ? darray_inline_buffer(array) : NULL;
+    array->total_size = capacity;
+    array->used_size = 0;
+    array->sorted_size = 0;
+    array->min_capacity = capacity;
+    array->growth = (darray_growth_policy)DARRAY_GROWTH_DEFAULT;
+    array->allocator = *allocator;
+    array->buffer_kind = DARRAY_BUFFER_INLINE;
+    array->inline_capacity = inline_capacity;
+    array->mapping = NULL;
+    array->mapping_length = 0;
+    array->concurrent = NULL;
+    array->hash_index = NULL;
+    array->storage = options->storage;
+    array->gap_tail = 0;
+    array->ring_head = 0;
+    array->overwrite_oldest = options->overwrite_oldest;
+    if (array->overwrite_oldest){
+        array->growth.auto_shrink = false; ///< The window keeps its capacity
+    }
+    array->type = type;
+    array->type_size = type_size;
+    array->compare = options->compare;
+    array->hash = options->hash;
+    array->log_handler = NULL;
+    array->log_context = NULL;
+    darray_stats_init(array);
+}
+
+/**
+ * @brief Moves the elements to a buffer of new_capacity elements, the realloc() of the library
+ * The inline buffer is used while the capacity fits in it and the allocator beyond that.
+ * Like realloc(), the first bytes of the old buffer (as many as both buffers hold) are kept.
+ * 
+ * @param[in,out] array        The target array, with a heap or inline buffer
+ * @param[in]     new_capacity The new total_size, its size in bytes must fit in size_t
+ * @return True if success, false if memory allocation fail (the array is left untouched)
+ */
+static bool array_resize_buffer(dArray* array, size_t new_capacity){
+    size_t type_size = array->type_size;
+    size_t old_bytes = array->total_size*type_size;
+    size_t new_bytes = new_capacity*type_size;
+    size_t kept = old_bytes < new_bytes ? old_bytes : new_bytes;
+    void* buffer;
+    if (new_capacity <= array->inline_capacity){
+        buffer = darray_inline_buffer(array);
+        if (array->buffer_kind == DARRAY_BUFFER_HEAP){
+            memcpy(buffer, array->dArray, kept);
+            array->allocator.free(array->allocator.context, array->dArray, old_bytes);
+            array->buffer_kind = DARRAY_BUFFER_INLINE;
+        }
+    } else if (array->buffer_kind == DARRAY_BUFFER_INLINE){
+        buffer = array->allocator.alloc(array->allocator.context, new_bytes);
+        if (!buffer){
+            return false;
+        }
+        memcpy(buffer, array->dArray, kept);
+        array->buffer_kind = DARRAY_BUFFER_HEAP;
+    } else {
+        buffer = array->allocator.realloc(array->allocator.context, array->dArray, old_bytes, new_bytes);
+        if (!buffer){
+            return false;
+        }
+    }
+    array->dArray = buffer;
+    array->total_size = new_capacity;
+    return true;
+}
+
+/**
+ * @brief Keeps an overwrite_oldest ring at its capacity before count elements are inserted at *index
+ * The new elements go in their place and the oldest elements of the result are dropped:
+ * first the ones before *index, then the first new elements if that is not enough.
+ * Does nothing on other arrays or when the elements fit.
+ * 
+ * @param[in,out] array The target array
+ * @param[in,out] index Where the new elements go, moved down by the old elements dropped
+ * @param[in,out] src   The new elements, moved past the ones dropped right away
+ * @param[in,out] count How many new elements, less the ones dropped right away
+ */
+static void array_overwrite_oldest(dArray* array, size_t* index, const void** src, size_t* count){
+    if (!array->overwrite_oldest || array->used_size + *count <= array->total_size){
+        return;
+    }
+    size_t dropped = array->used_size + *count - array->total_size;
+    size_t old_dropped = dropped < *index ? dropped : *index;
+    size_t new_dropped = dropped - old_dropped;
+    *src = (const char*)*src + new_dropped*array->type_size;
+    *count -= new_dropped;
+    *index -= old_dropped;
+    if (old_dropped > 0){
+        array->ring_head = (array->ring_head + old_dropped) % array->total_size;
+        array->used_size -= old_dropped;
+        array_track_remove(array, 0, old_dropped);
+        darray_hash_index_invalidate(array); ///< Every index moved down
+    }
+}
+
+/**
+ * @brief array_extend() into an overwrite_oldest ring: dst keeps the last elements of dst + src
+ * src is copied out first, since dropping elements of dst would change src when both are the same array.
+ * 
+ * @param[in,out] dst The ring that will receive the elements
+ * @param[in]     src The array whose elements will be copied, may be dst
+ * @return            True if success, false if memory allocation fail
+ */
+static bool array_extend_window(dArray* dst, const dArray* src){
+    size_t count = src->used_size < dst->total_size ? src->used_size : dst->total_size;
+    size_t type_size = src->type_size;
+    void* copy = malloc(count*type_size);
+    if (!copy){
+        darray_report(dst, DARRAY_ERR_NO_MEMORY, "Unable to allocate the copy buffer!");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++){ ///< Only the last total_size elements of src can survive
+        memcpy((char*)copy + i*type_size, array_element(src, src->used_size - count + i), type_size);
+    }
+    bool appended = array_append_n(dst, copy, count);
+    free(copy);
+    return appended;
+}
@@ -2,28 +2,265 @@
 #define DARRAY_H
 
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "darray_alloc.h"
 
-typedef enum {INT, FLOAT, DOUBLE} var_types;
+/**
+ * @brief The element type of an array
+ * The values never change, they are stored in files and streams.
+ * CUSTOM elements are element_size raw bytes, @see darray_options.
+ */
+typedef enum {
+    INT, FLOAT, DOUBLE,
+    INT8, INT16, INT64,
+    UINT8, UINT16, UINT32, UINT64,
+    CUSTOM
+} var_types;
 typedef struct dArray dArray; 
+typedef struct darray_search_index darray_search_index;
+typedef struct darray_encoder darray_encoder;
+typedef struct darray_decoder darray_decoder;
+
+/**
+ * @brief How an array changes its capacity, @see array_set_growth_policy()
+ */
+typedef struct {
+    double factor;    ///< The capacity is multiplied by this when the array is full (at least 1)
+    size_t step;      ///< Added to the capacity on each growth, on top of factor
+    size_t max_step;  ///< Never grows more than this many elements at once, 0 means no limit
+    bool auto_shrink; ///< Shrink when pops and removes leave the array at a quarter of its capacity
+} darray_growth_policy;
+
+#define DARRAY_GROWTH_DEFAULT {1.5, 0, 0, true} ///< The policy every new array starts with
+
+#define DARRAY_NOT_FOUND ((size_t)-1) ///< Index reported for keys that are not in the array
+
+/**
+ * @brief Why a call failed, @see array_last_error()
+ */
+typedef enum {
+    DARRAY_OK,                  ///< No failure
+    DARRAY_ERR_NULL,            ///< The array (or index, encoder...) does not exist
+    DARRAY_ERR_INVALID_ARGUMENT,///< An argument is invalid (NULL buffer, unknown type, mismatched types...)
+    DARRAY_ERR_OUT_OF_RANGE,    ///< An index or range is past the end of the array
+    DARRAY_ERR_NOT_FOUND,       ///< The element is not in the array
+    DARRAY_ERR_EMPTY,           ///< The array has no elements
+    DARRAY_ERR_NO_MEMORY,       ///< A memory allocation failed
+    DARRAY_ERR_TOO_BIG,         ///< The size would not fit in size_t or in the structure
+    DARRAY_ERR_READ_ONLY,       ///< The array is a read-only file mapping
+    DARRAY_ERR_STATE,           ///< Not allowed now (concurrent mode, unsorted array...)
+    DARRAY_ERR_IO,              ///< A file or stream could not be opened, read or written
+    DARRAY_ERR_CORRUPT,         ///< A file or stream is not valid dArray data
+    DARRAY_ERR_UNSUPPORTED      ///< Valid, but not supported by this build or machine
+} darray_status;
+
+typedef void (*darray_log_handler)(const dArray* array, darray_status status, const char* message, void* context); ///< @see array_set_log_handler()
+
+/**
+ * @brief Counters of the work an array did, @see array_get_stats()
+ */
+typedef struct {
+    size_t reallocs;        ///< Capacity changes, growths and shrinks
+    size_t realloc_bytes;   ///< Bytes those reallocations may have copied (the smaller of both buffers)
+    size_t memmove_bytes;   ///< Bytes moved inside the buffer by inserts, removals and gap or ring moves
+    size_t comparisons;     ///< Elements compared by searches, counts and removals by value
+    size_t sorts;           ///< Sorts that had work to do, the implicit ones of array_binary_search() and array_insert_sorted() included
+    size_t sorted_elements; ///< Elements handed to those sorts
+    size_t peak_capacity;   ///< The biggest capacity the array ever had
+} darray_stats;
+
+typedef void (*darray_resize_hook)(const dArray* array, size_t old_capacity, size_t new_capacity, void* context); ///< @see array_set_resize_hook()
+
+typedef int (*darray_compare)(const void* first, const void* second); ///< Like qsort(): negative, 0 or positive
+typedef uint64_t (*darray_hash)(const void* element);                 ///< Equal elements must hash equal
+
+typedef bool (*darray_predicate)(const void* element, void* context); ///< @see array_remove_if()
+
+/**
+ * @brief How an array lays out its elements in memory, @see array_new_ex()
+ */
+typedef enum {
+    DARRAY_STORAGE_FLAT, ///< One contiguous run of elements, what array_new() gives
+    DARRAY_STORAGE_GAP,  ///< Gap buffer: the free space sits where the last insert or removal happened
+    DARRAY_STORAGE_RING  ///< Circular buffer: adding and removing at both ends never moves the other elements
+} darray_storage;
+
+/**
+ * @brief Creation options for array_new_ex()
+ */
+typedef struct {
+    const darray_allocator* allocator; ///< NULL for the system allocator
+    darray_storage storage;            ///< The storage layout
+    bool overwrite_oldest;             ///< DARRAY_STORAGE_RING only: keep the start_size capacity, adding to a full array drops its first elements
+    size_t element_size;               ///< CUSTOM only: bytes per element
+    darray_compare compare;            ///< CUSTOM only, optional: the order for sorts and the equality for searches (bytes are compared without it)
+    darray_hash hash;                  ///< CUSTOM only, optional: consistent with compare (or with the bytes)
+} darray_options;
+
+#define DARRAY_OPTIONS_DEFAULT {NULL, DARRAY_STORAGE_FLAT, false, 0, NULL, NULL} ///< What array_new() uses
+
+#define DARRAY_HEADER_SIZE 384 ///< Bytes of caller storage the header of array_init() takes, the rest holds elements
+
+/**
+ * @brief Declares aligned storage for array_init() with room for count elements of type T
+ * Works for locals and for members of other structures, e.g. DARRAY_INLINE_STORAGE(ids, int, 16);
+ */
+#define DARRAY_INLINE_STORAGE(name, T, count) \
+    _Alignas(max_align_t) unsigned char name[DARRAY_HEADER_SIZE + (count)*sizeof(T)]
+
+/**
+ * @brief Sort algorithms available to array_sort_ex()
+ */
+typedef enum {
+    DARRAY_SORT_AUTO,     ///< Radix sort for big arrays, introsort for small ones (what array_sort() does)
+    DARRAY_SORT_RADIX,    ///< LSD radix sort, needs a scratch buffer as big as the array
+    DARRAY_SORT_INTROSORT ///< In-place introsort
+} darray_sort_algo;
+
+/**
+ * @brief A non-owning view over contiguous elements of a dArray
+ * Spans are invalidated by any call that may reallocate the array (append, insert, shrink...).
+ * @see array_span()
+ * @see array_span_range()
+ */
+typedef struct {
+    void* data;       ///< Pointer to the first element of the view
+    size_t size;      ///< How many elements the view has
+    size_t type_size; ///< sizeof() of one element
+    var_types type;   ///< The variable type of the elements
+} darray_span;
 
 //Public functions
 dArray* array_new(var_types type, size_t start_size);
+dArray* array_new_with_allocator(var_types type, size_t start_size, const darray_allocator* allocator);
+dArray* array_new_ex(var_types type, size_t start_size, const darray_options* options);
+dArray* array_init(void* storage, size_t storage_size, var_types type, const darray_options* options);
 bool array_append(dArray* array, void* new_element);
+bool array_append_n(dArray* array, const void* src, size_t count);
+bool array_extend(dArray* dst, const dArray* src);
+bool array_insert_n(dArray* array, size_t index, const void* src, size_t count);
 bool array_delete(dArray** array);
 bool array_pop(dArray* array, void* store_var);
+bool array_push_front(dArray* array, const void* new_element);
+bool array_pop_front(dArray* array, void* store_var);
 bool array_remove_by_value(dArray* array, void* value);
 bool array_remove_by_index(dArray* array, size_t index);
+size_t array_remove_all(dArray* array, const void* value);
+size_t array_remove_if(dArray* array, darray_predicate predicate, void* context);
+bool array_remove_indices(dArray* array, const size_t* sorted_indices, size_t count);
+size_t array_unique(dArray* array);
+bool array_retain_range(dArray* array, size_t start, size_t count);
 bool array_get(dArray* array, size_t index, void* store_variable);
 bool array_set(dArray* array, size_t index, void* new_value);
 bool array_is_empty(dArray* array);
 void array_clear(dArray* array);
 bool array_insert(dArray* array, size_t index, void* new_value);
+bool array_insert_sorted(dArray* array, void* new_value);
 bool array_shrink(dArray* array);
+bool array_reserve(dArray* array, size_t capacity);
+bool array_compact(dArray* array);
+bool array_set_growth_policy(dArray* array, const darray_growth_policy* policy);
+darray_growth_policy array_get_growth_policy(const dArray* array);
 bool array_find(dArray* array, void* value, size_t* store_index);
+size_t array_find_all(const dArray* array, const void* value, size_t* store_indices, size_t max_indices);
+size_t array_count(const dArray* array, const void* value);
+const char* array_simd_level(void);
 void array_sort(dArray* array);
+bool array_sort_ex(dArray* array, darray_sort_algo algorithm);
+bool array_sort_parallel(dArray* array, unsigned threads);
+bool array_is_sorted(const dArray* array);
 bool array_reverse(dArray* array);
 bool array_binary_search(dArray* array, void* element, size_t* store_index, bool already_sorted);
 size_t array_get_size(const dArray* array);
 size_t array_get_capacity(const dArray* array);
+var_types array_get_type(const dArray* array);
+size_t array_get_element_size(const dArray* array);
+
+//Status codes and diagnostics, @see darray_error.c
+darray_status array_last_error(void);
+void array_clear_error(void);
+const char* array_strerror(darray_status status);
+void array_set_default_log_handler(darray_log_handler handler, void* context);
+bool array_set_log_handler(dArray* array, darray_log_handler handler, void* context);
+void array_log_stderr(const dArray* array, darray_status status, const char* message, void* context);
+
+//Instrumentation, compiled out of builds with DARRAY_STATS 0 (the default with NDEBUG)
+bool array_get_stats(const dArray* array, darray_stats* store_stats);
+void array_reset_stats(dArray* array);
+bool array_set_resize_hook(dArray* array, darray_resize_hook hook, void* context);
+
+//Selection, partial sorting and permutations, in array_sort() order
+bool array_nth_element(dArray* array, size_t nth);
+bool array_partial_sort(dArray* array, size_t count);
+dArray* array_top_k(const dArray* array, size_t k, bool largest);
+bool array_argsort(const dArray* array, size_t* store_indices);
+bool array_apply_permutation(dArray* array, const size_t* permutation);
+
+//Reductions, @see darray_reduce.c
+bool array_sum(const dArray* array, double* store_sum);
+bool array_min(const dArray* array, void* store_value);
+bool array_max(const dArray* array, void* store_value);
+bool array_argmin(const dArray* array, size_t* store_index);
+bool array_argmax(const dArray* array, size_t* store_index);
+bool array_mean(const dArray* array, double* store_mean);
+bool array_variance(const dArray* array, double* store_variance);
+void array_set_reduce_threads(unsigned threads);
+
+//Search index for sorted arrays that rarely change
+darray_search_index* array_search_index_new(const dArray* array);
+bool array_search_index_delete(darray_search_index** index);
+bool array_search_index_find(const darray_search_index* index, const void* key, size_t* store_index);
+size_t array_search_many(const darray_search_index* index, const void* keys, size_t count, size_t* out_indices);
+
+//Hash index for O(1) array_find() on unsorted arrays, @see darray_hash_index.c
+bool array_enable_hash_index(dArray* array);
+bool array_disable_hash_index(dArray* array);
+bool array_has_hash_index(const dArray* array);
+
+//Zero-copy access
+void* array_data(dArray* array);
+const void* array_data_const(const dArray* array);
+darray_span array_span(dArray* array);
+darray_span array_span_const(const dArray* array);
+bool array_span_range(dArray* array, size_t start, size_t count, darray_span* store_span);
+
+//Concurrent append mode for many writer threads, @see darray_concurrent.c
+bool array_begin_concurrent(dArray* array);
+bool array_append_concurrent(dArray* array, const void* new_element);
+bool array_seal(dArray* array);
+
+//Persistence, @see darray_io.c
+bool array_save(const dArray* array, const char* path);
+dArray* array_load(const char* path);
+dArray* array_map_file(const char* path);
+
+//Compressed streams, @see darray_codec.c
+darray_encoder* array_encoder_new(FILE* stream, var_types type);
+bool array_encoder_write(darray_encoder* encoder, const void* elements, size_t count);
+bool array_encoder_finish(darray_encoder** encoder);
+bool array_encode(const dArray* array, FILE* stream);
+darray_decoder* array_decoder_new(FILE* stream);
+var_types array_decoder_type(const darray_decoder* decoder);
+bool array_decoder_read(darray_decoder* decoder, void* out_elements, size_t max_elements, size_t* store_count);
+bool array_decoder_delete(darray_decoder** decoder);
+dArray* array_decode(FILE* stream);
+
+//Unchecked span accessors, index must be smaller than span.size and the type must match
+static inline void* darray_span_at(darray_span span, size_t index){
+    return (char*)span.data + index*span.type_size;
+}
+static inline darray_span darray_span_sub(darray_span span, size_t start, size_t count){
+    span.data = (char*)span.data + start*span.type_size;
+    span.size = count;
+    return span;
+}
+static inline int darray_span_int(darray_span span, size_t index){return ((const int*)span.data)[index];}
+static inline float darray_span_float(darray_span span, size_t index){return ((const float*)span.data)[index];}
+static inline double darray_span_double(darray_span span, size_t index){return ((const double*)span.data)[index];}
+static inline void darray_span_set_int(darray_span span, size_t index, int value){((int*)span.data)[index] = value;}
+static inline void darray_span_set_float(darray_span span, size_t index, float value){((float*)span.data)[index] = value;}
+static inline void darray_span_set_double(darray_span span, size_t index, double value){((double*)span.data)[index] = value;}
 #endif
\ No newline at end of file
@@ -0,0 +1,498 @@
+/**
+ * @file darray_alloc.c
+ * @brief The allocators shipped with the library, @see darray_alloc.h
+ *
+ * - System: malloc/realloc/free, what array_new() uses. Buffers of DARRAY_MMAP_THRESHOLD
+ *           bytes or more are mapped with mmap instead, and grow with mremap, which moves
+ *           pages instead of copying bytes (Linux only, elsewhere malloc is used for all sizes)
+ * - Arena:  bump allocation inside big chunks, everything is released at once
+ * - Pool:   power of two size classes with free lists, blocks are reused
+ *
+ * The arena and the pool are not thread-safe, use one per thread.
+ */
+
+#define _GNU_SOURCE ///< mremap() and MAP_ANONYMOUS
+#include "darray_alloc.h"
+#include "darray_internal.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__linux__)
+#define DARRAY_HAVE_MMAP 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define DARRAY_HAVE_MMAP 0
+#endif
+
+#define ALIGNMENT (sizeof(max_align_t)) ///< Every block is aligned for any type
+
+#ifndef DARRAY_MMAP_THRESHOLD
+#define DARRAY_MMAP_THRESHOLD ((size_t)32 << 20) ///< From this many bytes on, the system allocator uses mmap
+#endif
+
+/**
+ * @brief Rounds size up to a multiple of ALIGNMENT, 0 if that overflows
+ */
+static size_t align_up(size_t size){
+    if (size > SIZE_MAX - (ALIGNMENT - 1)){
+        return 0;
+    }
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+//System allocator
+
+static bool huge_pages = true; ///< Advise the kernel to back mapped buffers with transparent huge pages
+
+#if DARRAY_HAVE_MMAP
+/**
+ * @brief Rounds size up to a whole number of pages, 0 if that overflows
+ */
+static size_t page_round(size_t size){
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (size > SIZE_MAX - (page - 1)){
+        return 0;
+    }
+    return (size + page - 1) / page * page;
+}
+
+/**
+ * @brief Asks for transparent huge pages on a mapping, if enabled and supported
+ */
+static void huge_advise(void* pointer, size_t length){
+#ifdef MADV_HUGEPAGE
+    if (huge_pages){
+        madvise(pointer, length, MADV_HUGEPAGE); ///< Only advice, failing is harmless
+    }
+#else
+    (void)pointer;
+    (void)length;
+#endif
+}
+
+/**
+ * @brief Maps size bytes of fresh zeroed memory
+ */
+static void* huge_map(size_t size){
+    size_t length = page_round(size);
+    if (length == 0){
+        return NULL;
+    }
+    void* pointer = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pointer == MAP_FAILED){
+        return NULL;
+    }
+    huge_advise(pointer, length);
+    return pointer;
+}
+#endif
+
+/**
+ * @brief Tells if a block of size bytes lives in its own mapping
+ */
+static bool is_mapped_size(size_t size){
+    return DARRAY_HAVE_MMAP && size >= DARRAY_MMAP_THRESHOLD;
+}
+
+static void* system_alloc(void* context, size_t size){
+    (void)context;
+#if DARRAY_HAVE_MMAP
+    if (is_mapped_size(size)){
+        return huge_map(size);
+    }
+#endif
+    return malloc(size);
+}
+
+static void system_free(void* context, void* pointer, size_t size){
+    (void)context;
+#if DARRAY_HAVE_MMAP
+    if (is_mapped_size(size)){
+        munmap(pointer, page_round(size));
+        return;
+    }
+#endif
+    (void)size;
+    free(pointer);
+}
+
+static void* system_realloc(void* context, void* pointer, size_t old_size, size_t new_size){
+    (void)context;
+    bool old_mapped = is_mapped_size(old_size);
+    bool new_mapped = is_mapped_size(new_size);
+    if (!old_mapped && !new_mapped){
+        return realloc(pointer, new_size);
+    }
+#if DARRAY_HAVE_MMAP
+    if (old_mapped && new_mapped){
+        ///< The kernel grows the mapping in place or moves its pages, no bytes are copied
+        size_t old_length = page_round(old_size);
+        size_t new_length = page_round(new_size);
+        if (new_length == 0){
+            return NULL;
+        }
+        if (old_length == new_length){
+            return pointer;
+        }
+        void* new_pointer = mremap(pointer, old_length, new_length, MREMAP_MAYMOVE);
+        if (new_pointer == MAP_FAILED){
+            return NULL;
+        }
+        if (new_length > old_length){
+            huge_advise(new_pointer, new_length);
+        }
+        return new_pointer;
+    }
+#endif
+    ///< Crossing the threshold, in either direction, copies once
+    void* new_pointer = system_alloc(NULL, new_size);
+    if (!new_pointer){
+        return NULL;
+    }
+    memcpy(new_pointer, pointer, old_size < new_size ? old_size : new_size);
+    system_free(NULL, pointer, old_size);
+    return new_pointer;
+}
+
+static const darray_allocator system_allocator = {system_alloc, system_realloc, system_free, NULL};
+
+/**
+ * @brief The allocator behind array_new(), malloc/realloc/free
+ *
+ * @return Pointer to the shared system allocator
+ */
+const darray_allocator* array_system_allocator(void){
+    return &system_allocator;
+}
+
+/**
+ * @brief Turns the transparent huge pages advice for mapped buffers on or off (on by default)
+ * Huge pages cut TLB misses on gigabyte arrays, but each one commits 2 MiB of memory at once.
+ * Only affects buffers mapped after the call.
+ *
+ * @param[in] enabled True to advise MADV_HUGEPAGE, false to leave the kernel default
+ */
+void array_set_huge_pages(bool enabled){
+    huge_pages = enabled;
+}
+
+//Arena allocator
+
+/**
+ * @brief One block of memory where the arena bumps its allocations
+ */
+typedef struct arena_chunk {
+    struct arena_chunk* next; ///< The previously filled chunk
+    size_t size;              ///< How many bytes fit in data
+    size_t used;              ///< How many bytes were already given away
+    max_align_t data[];       ///< The memory itself, max_align_t keeps it aligned
+} arena_chunk;
+
+/**
+ * @brief The arena, @see array_arena_new()
+ */
+struct darray_arena {
+    arena_chunk* chunks; ///< The chunk in use, the older ones follow through next
+    size_t chunk_size;   ///< Default size of a new chunk
+    void* last;          ///< The most recent allocation, the only one that can grow or be freed in place
+};
+
+/**
+ * @brief Adds a chunk with room for at least size bytes to the arena
+ *
+ * @return True if success, false if memory allocation fail
+ */
+static bool arena_add_chunk(darray_arena* arena, size_t size){
+    size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+    if (chunk_size > SIZE_MAX - sizeof(arena_chunk)){
+        return false;
+    }
+    arena_chunk* chunk = malloc(sizeof(arena_chunk) + chunk_size);
+    if (!chunk){
+        return false;
+    }
+    chunk->next = arena->chunks;
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    arena->chunks = chunk;
+    return true;
+}
+
+static void* arena_alloc(void* context, size_t size){
+    darray_arena* arena = context;
+    size = align_up(size);
+    if (size == 0){
+        return NULL;
+    }
+    arena_chunk* chunk = arena->chunks;
+    if (!chunk || chunk->size - chunk->used < size){
+        if (!arena_add_chunk(arena, size)){
+            return NULL;
+        }
+        chunk = arena->chunks;
+    }
+    void* pointer = (char*)chunk->data + chunk->used;
+    chunk->used += size;
+    arena->last = pointer;
+    return pointer;
+}
+
+static void* arena_realloc(void* context, void* pointer, size_t old_size, size_t new_size){
+    darray_arena* arena = context;
+    arena_chunk* chunk = arena->chunks;
+    size_t old_aligned = align_up(old_size);
+    size_t new_aligned = align_up(new_size);
+    if (new_aligned == 0){
+        return NULL;
+    }
+    ///< The last allocation can simply move the bump pointer
+    if (pointer == arena->last && chunk->used - old_aligned + new_aligned <= chunk->size){
+        chunk->used = chunk->used - old_aligned + new_aligned;
+        return pointer;
+    }
+    if (new_aligned <= old_aligned){
+        return pointer;
+    }
+    void* new_pointer = arena_alloc(arena, new_size);
+    if (new_pointer){
+        memcpy(new_pointer, pointer, old_size);
+    }
+    return new_pointer;
+}
+
+static void arena_free(void* context, void* pointer, size_t size){
+    darray_arena* arena = context;
+    ///< Only the last allocation gives its memory back, the rest waits for array_arena_reset()
+    if (pointer == arena->last){
+        arena->chunks->used -= align_up(size);
+        arena->last = NULL;
+    }
+}
+
+/**
+ * @brief Creates a bump arena
+ * @note Arrays created with its allocator become invalid after array_arena_reset() or array_arena_delete().
+ *
+ * @param[in] chunk_size How many bytes each chunk has, bigger requests get a chunk of their own
+ * @return The new arena, NULL if chunk_size is 0 or memory allocation fail
+ */
+darray_arena* array_arena_new(size_t chunk_size){
+    if (chunk_size == 0){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Size must be bigger than 0!");
+        return NULL;
+    }
+    darray_arena* arena = malloc(sizeof(darray_arena));
+    if (!arena){
+        darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
+        return NULL;
+    }
+    arena->chunks = NULL;
+    arena->chunk_size = align_up(chunk_size);
+    arena->last = NULL;
+    if (!arena_add_chunk(arena, arena->chunk_size)){
+        darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory for the arena!");
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+/**
+ * @brief Releases every allocation of the arena at once
+ * Keeps a single chunk so the next round of allocations does not call malloc again.
+ *
+ * @param[in,out] arena The target arena
+ */
+void array_arena_reset(darray_arena* arena){
+    arena_chunk* chunk = arena->chunks;
+    while (chunk->next){
+        arena_chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    chunk->used = 0;
+    arena->chunks = chunk;
+    arena->last = NULL;
+}
+
+/**
+ * @brief Destroys the arena and all the memory given by it
+ *
+ * @param[in,out] arena The target arena, set to NULL after
+ * @return True if success, false if the arena does not exist
+ */
+bool array_arena_delete(darray_arena** arena){
+    if (!arena || !*arena){
+        darray_report(NULL, DARRAY_ERR_NULL, "The arena does not exist!");
+        return false;
+    }
+    arena_chunk* chunk = (*arena)->chunks;
+    while (chunk){
+        arena_chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(*arena);
+    *arena = NULL;
+    return true;
+}
+
+/**
+ * @brief Allocator that takes its memory from the arena
+ *
+ * @param[in] arena The arena
+ * @return The allocator, to be passed to array_new_with_allocator()
+ */
+darray_allocator array_arena_allocator(darray_arena* arena){
+    darray_allocator allocator = {arena_alloc, arena_realloc, arena_free, arena};
+    return allocator;
+}
+
+//Pool allocator
+
+#define POOL_MIN_SHIFT 4      ///< Smallest size class: 16 bytes
+#define POOL_MAX_SHIFT 16     ///< Biggest size class: 64 KiB, bigger blocks go straight to malloc
+#define POOL_CLASSES (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+#define POOL_SLAB_SIZE ((size_t)1 << POOL_MAX_SHIFT) ///< Blocks are carved from slabs of this size
+
+/**
+ * @brief Header of a slab, the blocks follow it
+ */
+typedef struct pool_slab {
+    struct pool_slab* next;
+    max_align_t data[];
+} pool_slab;
+
+/**
+ * @brief A free block, the link to the next one lives inside the block itself
+ */
+typedef struct pool_block {
+    struct pool_block* next;
+} pool_block;
+
+/**
+ * @brief The pool, @see array_pool_new()
+ */
+struct darray_pool {
+    pool_block* free_lists[POOL_CLASSES]; ///< Free blocks of each size class
+    pool_slab* slabs;                     ///< Every slab, released by array_pool_delete()
+};
+
+/**
+ * @brief The size class that fits size bytes, POOL_CLASSES if it is too big for the pool
+ */
+static size_t pool_class(size_t size){
+    size_t class_index = 0;
+    while (class_index < POOL_CLASSES && ((size_t)1 << (class_index + POOL_MIN_SHIFT)) < size){
+        class_index++;
+    }
+    return class_index;
+}
+
+static void* pool_alloc(void* context, size_t size){
+    darray_pool* pool = context;
+    size_t class_index = pool_class(size);
+    if (class_index == POOL_CLASSES){
+        return malloc(size);
+    }
+    if (!pool->free_lists[class_index]){
+        ///< Carve a new slab into blocks of this class
+        pool_slab* slab = malloc(sizeof(pool_slab) + POOL_SLAB_SIZE);
+        if (!slab){
+            return NULL;
+        }
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        size_t block_size = (size_t)1 << (class_index + POOL_MIN_SHIFT);
+        for (size_t offset = POOL_SLAB_SIZE; offset >= block_size; offset -= block_size){
+            pool_block* block = (pool_block*)((char*)slab->data + offset - block_size);
+            block->next = pool->free_lists[class_index];
+            pool->free_lists[class_index] = block;
+        }
+    }
+    pool_block* block = pool->free_lists[class_index];
+    pool->free_lists[class_index] = block->next;
+    return block;
+}
+
+static void pool_free(void* context, void* pointer, size_t size){
+    darray_pool* pool = context;
+    size_t class_index = pool_class(size);
+    if (class_index == POOL_CLASSES){
+        free(pointer);
+        return;
+    }
+    pool_block* block = pointer;
+    block->next = pool->free_lists[class_index];
+    pool->free_lists[class_index] = block;
+}
+
+static void* pool_realloc(void* context, void* pointer, size_t old_size, size_t new_size){
+    darray_pool* pool = context;
+    size_t old_class = pool_class(old_size);
+    size_t new_class = pool_class(new_size);
+    if (old_class == POOL_CLASSES && new_class == POOL_CLASSES){
+        return realloc(pointer, new_size);
+    }
+    if (old_class == new_class){
+        return pointer;
+    }
+    void* new_pointer = pool_alloc(pool, new_size);
+    if (!new_pointer){
+        return NULL;
+    }
+    memcpy(new_pointer, pointer, old_size < new_size ? old_size : new_size);
+    pool_free(pool, pointer, old_size);
+    return new_pointer;
+}
+
+/**
+ * @brief Creates a size-class pool
+ * Blocks from 16 bytes to 64 KiB are served from free lists, bigger ones use malloc.
+ *
+ * @return The new pool, NULL if memory allocation fail
+ */
+darray_pool* array_pool_new(void){
+    darray_pool* pool = calloc(1, sizeof(darray_pool));
+    if (!pool){
+        darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
+    }
+    return pool;
+}
+
+/**
+ * @brief Destroys the pool
+ * @note Delete the arrays that use the pool before, blocks bigger than 64 KiB belong to them.
+ *
+ * @param[in,out] pool The target pool, set to NULL after
+ * @return True if success, false if the pool does not exist
+ */
+bool array_pool_delete(darray_pool** pool){
+    if (!pool || !*pool){
+        darray_report(NULL, DARRAY_ERR_NULL, "The pool does not exist!");
+        return false;
+    }
+    pool_slab* slab = (*pool)->slabs;
+    while (slab){
+        pool_slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    free(*pool);
+    *pool = NULL;
+    return true;
+}
+
+/**
+ * @brief Allocator that takes its memory from the pool
+ *
+ * @param[in] pool The pool
+ * @return The allocator, to be passed to array_new_with_allocator()
+ */
+darray_allocator array_pool_allocator(darray_pool* pool){
+    darray_allocator allocator = {pool_alloc, pool_realloc, pool_free, pool};
+    return allocator;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file darray_alloc.h
+ * @brief Allocator interface used by dArray, plus the arena and pool allocators
+ *
+ * Every byte a dArray owns (its header and its buffer) is requested through a
+ * darray_allocator. array_new() uses the system allocator (malloc/realloc/free),
+ * array_new_with_allocator() lets you plug any other one.
+ *
+ * Huge-array mode: the system allocator maps buffers of DARRAY_MMAP_THRESHOLD bytes
+ * (32 MiB by default, can be changed with -D at build time) or more with mmap and grows
+ * them with mremap, so a gigabyte array never gets copied by a reallocation.
+ */
+
+#ifndef DARRAY_ALLOC_H
+#define DARRAY_ALLOC_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/**
+ * @brief A memory allocator: three functions and the context they receive
+ * The library always passes back the exact size it asked for, so allocators do not
+ * need to store sizes in block headers.
+ */
+typedef struct {
+    void* (*alloc)(void* context, size_t size);                                  ///< Like malloc, NULL on failure
+    void* (*realloc)(void* context, void* pointer, size_t old_size, size_t new_size); ///< Like realloc, NULL on failure (pointer stays valid)
+    void (*free)(void* context, void* pointer, size_t size);                     ///< Like free, pointer is never NULL
+    void* context;                                                               ///< Passed as the first argument of every call
+} darray_allocator;
+
+typedef struct darray_arena darray_arena;
+typedef struct darray_pool darray_pool;
+
+const darray_allocator* array_system_allocator(void);
+void array_set_huge_pages(bool enabled);
+
+//Bump arena: every allocation is released at once by array_arena_reset()
+darray_arena* array_arena_new(size_t chunk_size);
+void array_arena_reset(darray_arena* arena);
+bool array_arena_delete(darray_arena** arena);
+darray_allocator array_arena_allocator(darray_arena* arena);
+
+//Size-class pool: freed blocks are kept in per-size free lists and reused
+darray_pool* array_pool_new(void);
+bool array_pool_delete(darray_pool** pool);
+darray_allocator array_pool_allocator(darray_pool* pool);
+
+#endif
@@ -0,0 +1,741 @@
+/**
+ * @file darray_codec.c
+ * @brief Compressed streams of elements, @see array_encoder_new() and array_decoder_new()
+ *
+ * Elements are encoded in independent chunks of up to CHUNK_SIZE elements, so a stream
+ * of any length is written and read with a fixed amount of memory:
+ *
+ * - Integers:     the first value, then the difference to the previous one, zigzag mapped
+ *                 (small negative numbers become small positive ones) and written as varints
+ *                 of 7 bits per byte, or bit-packed at the width of the biggest one when
+ *                 that is smaller. Sorted IDs and counters take a few bits each. Every
+ *                 integer type is widened to 64 bits for this, INT64 and UINT64 differences
+ *                 wrap around.
+ * - FLOAT/DOUBLE: Gorilla encoding. Each value is XORed with the previous one: a repeated
+ *                 value costs 1 bit, and a slowly changing one only stores the few bits
+ *                 that differ. Bits are kept exactly, NaN payloads and -0.0 survive.
+ *
+ * Stream layout: magic (8 bytes), type (1 byte), then for every chunk a varint element
+ * count and a varint byte length followed by the encoded bytes. A count of 0 ends the stream.
+ * Every field is byte order independent. CUSTOM elements can not be encoded.
+ */
+
+#include "darray.h"
+#include "darray_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define STREAM_MAGIC "DARRAYZ\1"
+#define CHUNK_SIZE 4096                       ///< Elements per chunk
+#define CHUNK_BYTES (CHUNK_SIZE * 10 + 16)    ///< Worst case encoded chunk: 78 bits per double, 10 varint bytes per 64 bit integer
+#define VARINT_MAX_BYTES 10
+
+/**
+ * @brief A stream being written, @see array_encoder_new()
+ */
+struct darray_encoder {
+    FILE* stream;          ///< Where the chunks go
+    var_types type;        ///< The variable type of the elements
+    size_t type_size;      ///< sizeof one element
+    size_t pending;        ///< Elements waiting in buffer for the chunk to fill up
+    unsigned char* buffer; ///< CHUNK_SIZE elements
+    unsigned char* output; ///< CHUNK_BYTES encoded bytes
+    int64_t* integers;     ///< CHUNK_SIZE widened elements, NULL for FLOAT and DOUBLE
+    bool failed;           ///< A write failed, everything after it is refused
+};
+
+/**
+ * @brief A stream being read, @see array_decoder_new()
+ */
+struct darray_decoder {
+    FILE* stream;          ///< Where the chunks come from
+    var_types type;        ///< The variable type of the elements
+    size_t type_size;      ///< sizeof one element
+    size_t available;      ///< Decoded elements in buffer
+    size_t position;       ///< How many of them were already handed out
+    unsigned char* buffer; ///< CHUNK_SIZE elements
+    unsigned char* input;  ///< CHUNK_BYTES encoded bytes
+    int64_t* integers;     ///< CHUNK_SIZE widened elements, NULL for FLOAT and DOUBLE
+    bool finished;         ///< The end of stream mark was read
+};
+
+static bool is_integer(var_types type){
+    return type != FLOAT && type != DOUBLE && type != CUSTOM;
+}
+
+static bool is_signed(var_types type){
+    return type == INT || type == INT8 || type == INT16 || type == INT64;
+}
+
+/**
+ * @brief Copies count integers of the given type to 64 bits, UINT64 keeps its bit pattern
+ */
+static void widen(const unsigned char* elements, size_t count, var_types type, int64_t* wide){
+#define WIDEN_CASE(TYPE, T, K, name)                                                        \
+        case TYPE:                                                                          \
+            for (size_t i = 0; i < count; i++){                                             \
+                T value;                                                                    \
+                memcpy(&value, elements + i*sizeof(T), sizeof(T));                          \
+                wide[i] = (int64_t)value;                                                   \
+            }                                                                               \
+            break;
+    switch(type){
+        DARRAY_FOR_EACH_INTEGER(WIDEN_CASE)
+        case FLOAT: case DOUBLE: case CUSTOM: break;
+    }
+}
+
+/**
+ * @brief The opposite of widen(), the values were already checked to fit
+ */
+static void narrow(const int64_t* wide, size_t count, var_types type, unsigned char* elements){
+#define NARROW_CASE(TYPE, T, K, name)                                                       \
+        case TYPE:                                                                          \
+            for (size_t i = 0; i < count; i++){                                             \
+                T value = (T)wide[i];                                                       \
+                memcpy(elements + i*sizeof(T), &value, sizeof(T));                          \
+            }                                                                               \
+            break;
+    switch(type){
+        DARRAY_FOR_EACH_INTEGER(NARROW_CASE)
+        case FLOAT: case DOUBLE: case CUSTOM: break;
+    }
+}
+
+//Varints
+
+static size_t varint_put(unsigned char* out, uint64_t value){
+    size_t length = 0;
+    while (value >= 0x80){
+        out[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (unsigned char)value;
+    return length;
+}
+
+/**
+ * @brief Reads a varint from in[*position], stopping at end
+ * @return True if success, false if the varint is truncated or too long
+ */
+static bool varint_get(const unsigned char* in, size_t end, size_t* position, uint64_t* store_value){
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64 && *position < end; shift += 7){
+        unsigned char byte = in[(*position)++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)){
+            *store_value = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Reads a varint straight from the stream, for the chunk headers
+ */
+static bool varint_read(FILE* stream, uint64_t* store_value){
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7){
+        int byte = getc(stream);
+        if (byte == EOF){
+            return false;
+        }
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)){
+            *store_value = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint64_t zigzag(int64_t value){
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value){
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+//Bit streams for the XOR encoding, most significant bit first
+
+typedef struct {
+    unsigned char* out;
+    size_t length;  ///< Whole bytes written
+    uint64_t bits;  ///< Pending bits, right aligned
+    unsigned count; ///< How many pending bits
+} bit_writer;
+
+static inline void bits_put(bit_writer* writer, uint64_t value, unsigned width){
+    while (width > 0){
+        unsigned take = width < 32 ? width : 32; ///< Keeps bits + take under 64 bits
+        width -= take;
+        writer->bits = (writer->bits << take) | ((value >> width) & ((UINT64_C(1) << take) - 1));
+        writer->count += take;
+        while (writer->count >= 8){
+            writer->count -= 8;
+            writer->out[writer->length++] = (unsigned char)(writer->bits >> writer->count);
+        }
+    }
+}
+
+static size_t bits_flush(bit_writer* writer){
+    if (writer->count > 0){
+        writer->out[writer->length++] = (unsigned char)(writer->bits << (8 - writer->count));
+        writer->count = 0;
+    }
+    return writer->length;
+}
+
+typedef struct {
+    const unsigned char* in;
+    size_t length;   ///< Bytes available
+    size_t position; ///< Next byte to load
+    uint64_t bits;   ///< Loaded bits, right aligned
+    unsigned count;  ///< How many loaded bits
+} bit_reader;
+
+/**
+ * @brief Reads width bits (at most 64)
+ * @return True if success, false if the input ran out
+ */
+static inline bool bits_get(bit_reader* reader, unsigned width, uint64_t* store_value){
+    uint64_t value = 0;
+    while (width > 0){
+        if (reader->count == 0){
+            if (reader->position >= reader->length){
+                return false;
+            }
+            reader->bits = reader->in[reader->position++];
+            reader->count = 8;
+        }
+        unsigned take = width < reader->count ? width : reader->count;
+        reader->count -= take;
+        value = (value << take) | ((reader->bits >> reader->count) & ((UINT64_C(1) << take) - 1));
+        width -= take;
+    }
+    *store_value = value;
+    return true;
+}
+
+//Chunk encoders and decoders
+
+#define INT_VARINT 0 ///< Chunk mode: every delta is a varint
+#define INT_PACKED 1 ///< Chunk mode: first value as a varint, the other deltas bit-packed with a fixed width
+
+static inline unsigned varint_size(uint64_t value){
+    unsigned length = 1;
+    while (value >= 0x80){
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+/**
+ * @brief Difference between two widened integers, wrapping around like the 64 bit types do
+ */
+static inline int64_t difference(int64_t value, int64_t previous){
+    return (int64_t)((uint64_t)value - (uint64_t)previous);
+}
+
+/**
+ * @brief Encodes a chunk of widened integers, picking the smallest of varints and bit-packing
+ * Varints win when a few deltas are much bigger than the rest, bit-packing wins when
+ * the deltas are all alike (3 bits each for IDs that grow by less than 8).
+ */
+static size_t encode_ints(const int64_t* values, size_t count, unsigned char* out){
+    size_t varint_bytes = 0;
+    uint64_t widest = 0;
+    int64_t previous = 0;
+    for (size_t i = 0; i < count; i++){
+        uint64_t delta = zigzag(difference(values[i], previous));
+        varint_bytes += varint_size(delta);
+        if (i > 0){
+            widest |= delta;
+        }
+        previous = values[i];
+    }
+    unsigned width = widest ? 64 - (unsigned)__builtin_clzll(widest) : 0;
+    size_t packed_bytes = varint_size(zigzag(values[0])) + 1 + ((count - 1) * width + 7) / 8;
+
+    size_t length = 0;
+    previous = 0;
+    if (varint_bytes <= packed_bytes){
+        out[length++] = INT_VARINT;
+        for (size_t i = 0; i < count; i++){
+            length += varint_put(out + length, zigzag(difference(values[i], previous)));
+            previous = values[i];
+        }
+        return length;
+    }
+    out[length++] = INT_PACKED;
+    length += varint_put(out + length, zigzag(values[0]));
+    out[length++] = (unsigned char)width;
+    bit_writer writer = {out + length, 0, 0, 0};
+    for (size_t i = 1; i < count; i++){
+        bits_put(&writer, zigzag(difference(values[i], values[i-1])), width);
+    }
+    return length + bits_flush(&writer);
+}
+
+/**
+ * @brief Decodes a chunk of integers of bits bits, checking that every value fits
+ */
+static bool decode_ints(const unsigned char* in, size_t length, int64_t* values, size_t count, unsigned bits, bool signed_type){
+    unsigned max_width = bits < 64 ? bits + 1 : 64; ///< The widest delta between two values
+    int64_t low = signed_type ? (bits < 64 ? -((int64_t)1 << (bits - 1)) : INT64_MIN) : 0;
+    int64_t high = bits < 64 ? (signed_type ? ((int64_t)1 << (bits - 1)) - 1 : ((int64_t)1 << bits) - 1) : INT64_MAX;
+    size_t position = 1;
+    if (length == 0 || (in[0] != INT_VARINT && in[0] != INT_PACKED)){
+        return false;
+    }
+    bool packed = in[0] == INT_PACKED;
+    unsigned width = 0;
+    bit_reader reader = {in, length, 0, 0, 0};
+    int64_t previous = 0;
+    for (size_t i = 0; i < count; i++){
+        uint64_t delta;
+        if (!packed || i == 0){
+            if (!varint_get(in, length, &position, &delta)){
+                return false;
+            }
+            if (packed){
+                if (position >= length || in[position] > max_width){
+                    return false;
+                }
+                width = in[position++];
+                reader.position = position;
+            }
+        } else if (!bits_get(&reader, width, &delta)){
+            return false;
+        }
+        if (max_width < 64 && delta >> max_width != 0){
+            return false;
+        }
+        int64_t value = (int64_t)((uint64_t)previous + (uint64_t)unzigzag(delta));
+        if (bits < 64 && (value < low || value > high)){
+            return false;
+        }
+        values[i] = value;
+        previous = value;
+    }
+    return (packed && count > 1 ? reader.position : position) == length;
+}
+
+/**
+ * @brief Generates the Gorilla encoder and decoder for a float type of BITS bits
+ * Per value: '0' if equal to the previous one, '10' + the meaningful bits if they fit
+ * in the previous leading/trailing zero window, or '11' + leading zeros (LEAD_BITS)
+ * + meaningful length - 1 (LEN_BITS) + the meaningful bits.
+ */
+#define DEFINE_XOR_CODEC(T, U, BITS, LEAD_BITS, LEN_BITS, CLZ, CTZ, name)                   \
+static size_t name##_encode(const T* values, size_t count, unsigned char* out){             \
+    bit_writer writer = {out, 0, 0, 0};                                                     \
+    U previous = 0;                                                                         \
+    unsigned lead = BITS + 1, trail = 0; /* No window yet */                                \
+    for (size_t i = 0; i < count; i++){                                                     \
+        U bits;                                                                             \
+        memcpy(&bits, &values[i], sizeof(bits));                                            \
+        U x = bits ^ previous;                                                              \
+        previous = bits;                                                                    \
+        if (i == 0){                                                                        \
+            bits_put(&writer, bits, BITS);                                                  \
+        } else if (x == 0){                                                                 \
+            bits_put(&writer, 0, 1);                                                        \
+        } else {                                                                            \
+            unsigned x_lead = (unsigned)CLZ(x), x_trail = (unsigned)CTZ(x);                 \
+            if (lead <= BITS && x_lead >= lead && x_trail >= trail){                        \
+                bits_put(&writer, 2, 2);                                                    \
+                bits_put(&writer, x >> trail, BITS - lead - trail);                         \
+            } else {                                                                        \
+                lead = x_lead;                                                              \
+                trail = x_trail;                                                            \
+                unsigned meaningful = BITS - lead - trail;                                  \
+                bits_put(&writer, 3, 2);                                                    \
+                bits_put(&writer, lead, LEAD_BITS);                                         \
+                bits_put(&writer, meaningful - 1, LEN_BITS);                                \
+                bits_put(&writer, x >> trail, meaningful);                                  \
+            }                                                                               \
+        }                                                                                   \
+    }                                                                                       \
+    return bits_flush(&writer);                                                             \
+}                                                                                           \
+                                                                                            \
+static bool name##_decode(const unsigned char* in, size_t length, T* values, size_t count){  \
+    bit_reader reader = {in, length, 0, 0, 0};                                              \
+    U previous = 0;                                                                         \
+    unsigned lead = 0, meaningful = 0;                                                      \
+    for (size_t i = 0; i < count; i++){                                                     \
+        uint64_t field;                                                                     \
+        if (i == 0){                                                                        \
+            if (!bits_get(&reader, BITS, &field)){return false;}                            \
+            previous = (U)field;                                                            \
+        } else {                                                                            \
+            if (!bits_get(&reader, 1, &field)){return false;}                               \
+            if (field){                                                                     \
+                if (!bits_get(&reader, 1, &field)){return false;}                           \
+                if (field){                                                                 \
+                    uint64_t new_lead, new_length;                                          \
+                    if (!bits_get(&reader, LEAD_BITS, &new_lead) ||                         \
+                        !bits_get(&reader, LEN_BITS, &new_length)){return false;}           \
+                    lead = (unsigned)new_lead;                                              \
+                    meaningful = (unsigned)new_length + 1;                                  \
+                    if (lead + meaningful > BITS){return false;}                            \
+                } else if (meaningful == 0){                                                \
+                    return false; /* Window reused before one was set */                    \
+                }                                                                           \
+                if (!bits_get(&reader, meaningful, &field)){return false;}                  \
+                previous ^= (U)field << (BITS - lead - meaningful);                         \
+            }                                                                               \
+        }                                                                                   \
+        memcpy(&values[i], &previous, sizeof(previous));                                    \
+    }                                                                                       \
+    return reader.position == length;                                                       \
+}
+
+#define CLZ32(x) __builtin_clz(x)
+#define CTZ32(x) __builtin_ctz(x)
+DEFINE_XOR_CODEC(float, uint32_t, 32, 5, 5, CLZ32, CTZ32, float)
+DEFINE_XOR_CODEC(double, uint64_t, 64, 6, 6, __builtin_clzll, __builtin_ctzll, double)
+
+//Encoder
+
+/**
+ * @brief Encodes the pending elements as one chunk and writes it
+ */
+static bool encoder_flush(darray_encoder* encoder){
+    if (encoder->pending == 0){
+        return true;
+    }
+    size_t length = 0;
+    if (encoder->integers){
+        widen(encoder->buffer, encoder->pending, encoder->type, encoder->integers);
+        length = encode_ints(encoder->integers, encoder->pending, encoder->output);
+    } else if (encoder->type == FLOAT){
+        length = float_encode((const float*)encoder->buffer, encoder->pending, encoder->output);
+    } else {
+        length = double_encode((const double*)encoder->buffer, encoder->pending, encoder->output);
+    }
+    unsigned char head[2*VARINT_MAX_BYTES];
+    size_t head_length = varint_put(head, encoder->pending);
+    head_length += varint_put(head + head_length, length);
+    encoder->pending = 0;
+    if (fwrite(head, 1, head_length, encoder->stream) != head_length ||
+        fwrite(encoder->output, 1, length, encoder->stream) != length){
+        darray_report(NULL, DARRAY_ERR_IO, "Failed to write the stream!");
+        encoder->failed = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Starts a compressed stream of elements
+ * The stream is written chunk by chunk as elements arrive, nothing is kept in memory but
+ * the current chunk. Feed it with array_encoder_write(), end it with array_encoder_finish().
+ *
+ * @param[in] stream Where to write, opened in binary mode (a file, a pipe, a socket...)
+ * @param[in] type   The variable type of the elements
+ * @return The new encoder, NULL if the type is not valid or CUSTOM or memory allocation fail
+ */
+darray_encoder* array_encoder_new(FILE* stream, var_types type){
+    size_t type_size = darray_type_size(type);
+    if (!stream || type_size == 0){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Invalid stream or type!");
+        return NULL;
+    }
+    darray_encoder* encoder = malloc(sizeof(darray_encoder));
+    if (!encoder){
+        darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
+        return NULL;
+    }
+    encoder->buffer = malloc(CHUNK_SIZE * type_size);
+    encoder->output = malloc(CHUNK_BYTES);
+    encoder->integers = is_integer(type) ? malloc(CHUNK_SIZE * sizeof(int64_t)) : NULL;
+    if (!encoder->buffer || !encoder->output || (is_integer(type) && !encoder->integers)){
+        darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory for the encoder!");
+        free(encoder->buffer);
+        free(encoder->output);
+        free(encoder->integers);
+        free(encoder);
+        return NULL;
+    }
+    encoder->stream = stream;
+    encoder->type = type;
+    encoder->type_size = type_size;
+    encoder->pending = 0;
+    encoder->failed = false;
+
+    unsigned char head[sizeof(STREAM_MAGIC)];
+    memcpy(head, STREAM_MAGIC, sizeof(STREAM_MAGIC) - 1);
+    head[sizeof(STREAM_MAGIC) - 1] = (unsigned char)type;
+    if (fwrite(head, 1, sizeof(head), stream) != sizeof(head)){
+        darray_report(NULL, DARRAY_ERR_IO, "Failed to write the stream!");
+        encoder->failed = true;
+    }
+    return encoder;
+}
+
+/**
+ * @brief Adds elements to the stream
+ *
+ * @param[in] encoder  The encoder
+ * @param[in] elements count elements, of the encoder type
+ * @param[in] count    How many elements
+ * @return True if success, false if writing to the stream failed (now or before)
+ */
+bool array_encoder_write(darray_encoder* encoder, const void* elements, size_t count){
+    if (!encoder || (!elements && count > 0)){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Invalid encoder or elements!");
+        return false;
+    }
+    const unsigned char* source = elements;
+    while (count > 0 && !encoder->failed){
+        size_t take = CHUNK_SIZE - encoder->pending;
+        if (take > count){
+            take = count;
+        }
+        memcpy(encoder->buffer + encoder->pending * encoder->type_size, source, take * encoder->type_size);
+        encoder->pending += take;
+        source += take * encoder->type_size;
+        count -= take;
+        if (encoder->pending == CHUNK_SIZE){
+            encoder_flush(encoder);
+        }
+    }
+    return !encoder->failed;
+}
+
+/**
+ * @brief Writes the last chunk and the end of stream mark, then destroys the encoder
+ * The FILE is not closed.
+ *
+ * @param[in,out] encoder The target encoder, set to NULL after
+ * @return True if the whole stream was written, false if any write failed
+ */
+bool array_encoder_finish(darray_encoder** encoder){
+    if (!encoder || !*encoder){
+        darray_report(NULL, DARRAY_ERR_NULL, "The encoder does not exist!");
+        return false;
+    }
+    darray_encoder* target = *encoder;
+    if (!target->failed && encoder_flush(target)){
+        unsigned char end = 0; ///< A chunk of 0 elements
+        if (fwrite(&end, 1, 1, target->stream) != 1 || fflush(target->stream) != 0){
+            darray_report(NULL, DARRAY_ERR_IO, "Failed to write the stream!");
+            target->failed = true;
+        }
+    }
+    bool success = !target->failed;
+    free(target->buffer);
+    free(target->output);
+    free(target->integers);
+    free(target);
+    *encoder = NULL;
+    return success;
+}
+
+/**
+ * @brief Writes a whole array as a compressed stream
+ *
+ * @param[in] array  The array
+ * @param[in] stream Where to write, @see array_encoder_new()
+ * @return True if success, false if writing fails
+ */
+bool array_encode(const dArray* array, FILE* stream){
+    if (!array){
+        darray_report(array, DARRAY_ERR_NULL, "The array does not exist!");
+        return false;
+    }
+    darray_encoder* encoder = array_encoder_new(stream, array_get_type(array));
+    if (!encoder){
+        return false;
+    }
+    array_encoder_write(encoder, array_data_const(array), array_get_size(array));
+    return array_encoder_finish(&encoder);
+}
+
+//Decoder
+
+/**
+ * @brief Reads and decodes the next chunk
+ * @return True if success (finished is set at the end of the stream), false if the stream is invalid
+ */
+static bool decoder_fill(darray_decoder* decoder){
+    uint64_t count, length;
+    if (!varint_read(decoder->stream, &count)){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "The stream is truncated!");
+        return false;
+    }
+    if (count == 0){
+        decoder->finished = true;
+        return true;
+    }
+    if (count > CHUNK_SIZE || !varint_read(decoder->stream, &length) || length > CHUNK_BYTES){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "The stream is corrupted!");
+        return false;
+    }
+    if (fread(decoder->input, 1, (size_t)length, decoder->stream) != length){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "The stream is truncated!");
+        return false;
+    }
+    bool valid = false;
+    if (decoder->integers){
+        valid = decode_ints(decoder->input, (size_t)length, decoder->integers, (size_t)count,
+                            (unsigned)decoder->type_size*8, is_signed(decoder->type));
+        if (valid){
+            narrow(decoder->integers, (size_t)count, decoder->type, decoder->buffer);
+        }
+    } else if (decoder->type == FLOAT){
+        valid = float_decode(decoder->input, (size_t)length, (float*)decoder->buffer, (size_t)count);
+    } else {
+        valid = double_decode(decoder->input, (size_t)length, (double*)decoder->buffer, (size_t)count);
+    }
+    if (!valid){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "The stream is corrupted!");
+        return false;
+    }
+    decoder->available = (size_t)count;
+    decoder->position = 0;
+    return true;
+}
+
+/**
+ * @brief Starts reading a stream written by an encoder, reading its header
+ *
+ * @param[in] stream Where to read, opened in binary mode
+ * @return The new decoder, NULL if the stream is not valid or memory allocation fail
+ */
+darray_decoder* array_decoder_new(FILE* stream){
+    unsigned char head[sizeof(STREAM_MAGIC)];
+    if (!stream || fread(head, 1, sizeof(head), stream) != sizeof(head) ||
+        memcmp(head, STREAM_MAGIC, sizeof(STREAM_MAGIC) - 1) != 0){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "Not a dArray stream!");
+        return NULL;
+    }
+    var_types type = (var_types)head[sizeof(STREAM_MAGIC) - 1];
+    size_t type_size = darray_type_size(type);
+    if (type_size == 0){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "Invalid type in the stream!");
+        return NULL;
+    }
+    darray_decoder* decoder = malloc(sizeof(darray_decoder));
+    if (!decoder){
+        darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
+        return NULL;
+    }
+    decoder->buffer = malloc(CHUNK_SIZE * type_size);
+    decoder->input = malloc(CHUNK_BYTES);
+    decoder->integers = is_integer(type) ? malloc(CHUNK_SIZE * sizeof(int64_t)) : NULL;
+    if (!decoder->buffer || !decoder->input || (is_integer(type) && !decoder->integers)){
+        darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory for the decoder!");
+        free(decoder->buffer);
+        free(decoder->input);
+        free(decoder->integers);
+        free(decoder);
+        return NULL;
+    }
+    decoder->stream = stream;
+    decoder->type = type;
+    decoder->type_size = type_size;
+    decoder->available = 0;
+    decoder->position = 0;
+    decoder->finished = false;
+    return decoder;
+}
+
+/**
+ * @brief The variable type of the elements in the stream
+ */
+var_types array_decoder_type(const darray_decoder* decoder){
+    return decoder->type;
+}
+
+/**
+ * @brief Decodes the next elements of the stream
+ *
+ * @param[in]  decoder      The decoder
+ * @param[out] out_elements Room for max_elements elements, of the stream type
+ * @param[in]  max_elements How many elements fit in out_elements
+ * @param[out] store_count  How many were decoded, 0 once the stream ended
+ * @return True if success, false if the stream is truncated or corrupted
+ */
+bool array_decoder_read(darray_decoder* decoder, void* out_elements, size_t max_elements, size_t* store_count){
+    if (!decoder || !store_count || (!out_elements && max_elements > 0)){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Invalid decoder or output!");
+        return false;
+    }
+    unsigned char* out = out_elements;
+    size_t done = 0;
+    while (done < max_elements && !decoder->finished){
+        if (decoder->position == decoder->available && !decoder_fill(decoder)){
+            *store_count = done;
+            return false;
+        }
+        size_t take = decoder->available - decoder->position;
+        if (take > max_elements - done){
+            take = max_elements - done;
+        }
+        memcpy(out + done * decoder->type_size, decoder->buffer + decoder->position * decoder->type_size, take * decoder->type_size);
+        decoder->position += take;
+        done += take;
+    }
+    *store_count = done;
+    return true;
+}
+
+/**
+ * @brief Destroys a decoder, the FILE is not closed
+ *
+ * @param[in,out] decoder The target decoder, set to NULL after
+ * @return True if success, false if the decoder does not exist
+ */
+bool array_decoder_delete(darray_decoder** decoder){
+    if (!decoder || !*decoder){
+        darray_report(NULL, DARRAY_ERR_NULL, "The decoder does not exist!");
+        return false;
+    }
+    free((*decoder)->buffer);
+    free((*decoder)->input);
+    free((*decoder)->integers);
+    free(*decoder);
+    *decoder = NULL;
+    return true;
+}
+
+/**
+ * @brief Reads a whole compressed stream into a new array
+ *
+ * @param[in] stream Where to read, @see array_decoder_new()
+ * @return The new array, NULL if the stream is invalid or memory allocation fail
+ */
+dArray* array_decode(FILE* stream){
+    darray_decoder* decoder = array_decoder_new(stream);
+    if (!decoder){
+        return NULL;
+    }
+    dArray* array = array_new(decoder->type, CHUNK_SIZE);
+    bool success = array != NULL;
+    while (success && !decoder->finished){
+        if (decoder->position == decoder->available){
+            success = decoder_fill(decoder);
+            continue;
+        }
+        ///< Whole chunks go straight from the decoder buffer into the array
+        success = array_append_n(array, decoder->buffer + decoder->position * decoder->type_size,
+                                 decoder->available - decoder->position);
+        decoder->position = decoder->available;
+    }
+    array_decoder_delete(&decoder);
+    if (!success){
+        if (array){
+            array_delete(&array);
+        }
+        return NULL;
+    }
+    return array;
+}
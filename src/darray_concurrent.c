@@ -0,0 +1,172 @@
+/**
+ * @file darray_concurrent.c
+ * @brief Lock-free appends from many threads, @see array_begin_concurrent()
+ *
+ * In concurrent mode new elements do not go to the array buffer, they go to a list of
+ * segments of doubling size (CONCURRENT_FIRST_SEGMENT, twice that, four times that...).
+ * A writer takes the next free slot with one atomic fetch-add, finds its segment with a
+ * little bit arithmetic, and the first writer that reaches a segment not allocated yet
+ * allocates it and publishes it with a compare-and-swap. Segments never move and are
+ * never freed while writers run, so no writer can see freed memory and nobody waits
+ * for a copy. array_seal() moves everything back into the normal contiguous buffer.
+ */
+
+#include "darray_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#define CONCURRENT_FIRST_SEGMENT ((size_t)1024) ///< Elements in segment 0, segment k holds that << k
+#define CONCURRENT_SEGMENTS 48                  ///< Enough for 1024 * 2^48 elements
+
+/**
+ * @brief The state of an array in concurrent mode
+ */
+struct darray_concurrent {
+    _Atomic size_t next;                          ///< Next free slot, counting from the first concurrent append
+    _Atomic(unsigned char*) segments[CONCURRENT_SEGMENTS]; ///< NULL until the first writer reaches them
+    atomic_bool failed;                           ///< A segment allocation failed, array_seal() reports it
+};
+
+/**
+ * @brief Finds the segment of a slot and the slot's offset inside it
+ * Segment k starts at slot FIRST * (2^k - 1), so k = log2(slot / FIRST + 1).
+ */
+static inline unsigned segment_of(size_t slot, size_t* store_offset){
+    size_t position = slot / CONCURRENT_FIRST_SEGMENT + 1;
+    unsigned segment = 63u - (unsigned)__builtin_clzll((unsigned long long)position);
+    *store_offset = slot - CONCURRENT_FIRST_SEGMENT * (((size_t)1 << segment) - 1);
+    return segment;
+}
+
+/**
+ * @brief Puts an array in concurrent mode
+ * Call it before starting the writer threads. Until array_seal(), array_append_concurrent()
+ * is the only function that may change the array; the elements already in it stay readable.
+ *
+ * @param[in] array The target array
+ * @return True if success, false if the array is read-only, already concurrent or memory allocation fail
+ */
+bool array_begin_concurrent(dArray* array){
+    if (!array){
+        darray_report(array, DARRAY_ERR_NULL, "The array does not exist!");
+        return false;
+    }
+    if (array->buffer_kind == DARRAY_BUFFER_MAPPED || array->concurrent){
+        darray_report(array, DARRAY_ERR_STATE, "The array is read-only or already in concurrent mode!");
+        return false;
+    }
+    struct darray_concurrent* state = malloc(sizeof(struct darray_concurrent));
+    if (!state){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
+        return false;
+    }
+    atomic_init(&state->next, 0);
+    for (int i = 0; i < CONCURRENT_SEGMENTS; i++){
+        atomic_init(&state->segments[i], NULL);
+    }
+    atomic_init(&state->failed, false);
+    array->concurrent = state;
+    return true;
+}
+
+/**
+ * @brief Appends an element, safe to call from any number of threads at the same time
+ * Elements from one thread keep their order, elements from different threads interleave.
+ * @note Segments are allocated with malloc, not with the array allocator, which may not be thread-safe.
+ *
+ * @param[in] array       The target array, in concurrent mode
+ * @param[in] new_element Pointer to the element, of the array type
+ * @return True if success, false if the array is not in concurrent mode or memory allocation fail
+ */
+bool array_append_concurrent(dArray* array, const void* new_element){
+    struct darray_concurrent* state = array->concurrent;
+    if (!state){
+        darray_report(array, DARRAY_ERR_STATE, "The array is not in concurrent mode!");
+        return false;
+    }
+    size_t type_size = array->type_size;
+    size_t slot = atomic_fetch_add_explicit(&state->next, 1, memory_order_relaxed);
+    size_t offset;
+    unsigned segment = segment_of(slot, &offset);
+    if (segment >= CONCURRENT_SEGMENTS){
+        darray_report(array, DARRAY_ERR_TOO_BIG, "Too many concurrent appends!");
+        atomic_store(&state->failed, true);
+        return false;
+    }
+
+    unsigned char* buffer = atomic_load_explicit(&state->segments[segment], memory_order_acquire);
+    if (!buffer){
+        unsigned char* fresh = malloc((CONCURRENT_FIRST_SEGMENT << segment) * type_size);
+        if (!fresh){
+            darray_report(array, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory for a segment!");
+            atomic_store(&state->failed, true);
+            return false;
+        }
+        if (atomic_compare_exchange_strong_explicit(&state->segments[segment], &buffer, fresh,
+                                                    memory_order_acq_rel, memory_order_acquire)){
+            buffer = fresh;
+        } else {
+            free(fresh); ///< Another writer got there first, buffer now holds its segment
+        }
+    }
+    memcpy(buffer + offset * type_size, new_element, type_size);
+    return true;
+}
+
+/**
+ * @brief Leaves concurrent mode, moving the concurrent appends to the end of the array
+ * Call it once every writer thread has finished (joined). The array is then a normal
+ * contiguous array again, with the usual growth policy and sortedness tracking.
+ *
+ * @param[in] array The target array, in concurrent mode
+ * @return True if success, false if the array is not in concurrent mode, an append failed
+ *         or memory allocation fail (the concurrent appends are dropped in those cases)
+ */
+bool array_seal(dArray* array){
+    if (!array || !array->concurrent){
+        darray_report(array, DARRAY_ERR_STATE, "The array is not in concurrent mode!");
+        return false;
+    }
+    struct darray_concurrent* state = array->concurrent;
+    array->concurrent = NULL; ///< Makes the normal functions usable again for the copy below
+    size_t count = atomic_load(&state->next);
+    bool success = !atomic_load(&state->failed);
+    if (success && count > 0 && array->used_size + count > array->total_size){
+        success = array_reserve(array, array->used_size + count);
+    }
+
+    size_t done = 0;
+    for (unsigned segment = 0; segment < CONCURRENT_SEGMENTS; segment++){
+        unsigned char* buffer = atomic_load(&state->segments[segment]);
+        size_t length = CONCURRENT_FIRST_SEGMENT << segment;
+        if (success && done < count){
+            if (length > count - done){
+                length = count - done;
+            }
+            success = array_append_n(array, buffer, length);
+            done += length;
+        }
+        free(buffer);
+    }
+    free(state);
+    if (!success){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Concurrent appends were lost!");
+    }
+    return success;
+}
+
+/**
+ * @brief Frees the segments of an array deleted while in concurrent mode, called by array_delete()
+ */
+void darray_concurrent_free(dArray* array){
+    struct darray_concurrent* state = array->concurrent;
+    if (!state){
+        return;
+    }
+    for (unsigned segment = 0; segment < CONCURRENT_SEGMENTS; segment++){
+        free(atomic_load(&state->segments[segment]));
+    }
+    free(state);
+    array->concurrent = NULL;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file darray_error.c
+ * @brief Status codes and opt-in diagnostics, @see array_last_error()
+ *
+ * Failing calls store a darray_status in a thread-local variable, like errno, and hand a
+ * message to the log handler of the array (or the default one). Without handlers the
+ * library never prints, so an expected failure (a key that is not in the array, an empty
+ * pop...) costs one store on top of the work itself.
+ */
+
+#include "darray_internal.h"
+#include <stdio.h>
+
+static _Thread_local darray_status last_error = DARRAY_OK;
+static darray_log_handler default_handler = NULL; ///< Set before starting threads, it is not synchronized
+static void* default_context = NULL;
+
+/**
+ * @brief Records a failure and logs it, called by every failing library function
+ *
+ * @param[in] array   The array the failing call was working on, NULL if none
+ * @param[in] status  Why it failed
+ * @param[in] message What happened, in a few words
+ */
+void darray_report(const dArray* array, darray_status status, const char* message){
+    last_error = status;
+    if (array && array->log_handler){
+        array->log_handler(array, status, message, array->log_context);
+    } else if (default_handler){
+        default_handler(array, status, message, default_context);
+    }
+}
+
+/**
+ * @brief The status of the last failed library call in this thread
+ * @note Successful calls do not reset it, like errno. Call array_clear_error() before
+ * a call to know for sure whether that one failed.
+ *
+ * @return The status, DARRAY_OK if no call failed (since the last array_clear_error())
+ */
+darray_status array_last_error(void){
+    return last_error;
+}
+
+/**
+ * @brief Sets the status of this thread back to DARRAY_OK
+ */
+void array_clear_error(void){
+    last_error = DARRAY_OK;
+}
+
+/**
+ * @brief A short description of a status, never NULL
+ *
+ * @param[in] status The status
+ * @return A static string
+ */
+const char* array_strerror(darray_status status){
+    switch (status){
+        case DARRAY_OK: return "success";
+        case DARRAY_ERR_NULL: return "the object does not exist";
+        case DARRAY_ERR_INVALID_ARGUMENT: return "invalid argument";
+        case DARRAY_ERR_OUT_OF_RANGE: return "index out of range";
+        case DARRAY_ERR_NOT_FOUND: return "element not found";
+        case DARRAY_ERR_EMPTY: return "the array is empty";
+        case DARRAY_ERR_NO_MEMORY: return "memory allocation failed";
+        case DARRAY_ERR_TOO_BIG: return "size too big";
+        case DARRAY_ERR_READ_ONLY: return "the array is read-only";
+        case DARRAY_ERR_STATE: return "not allowed in the current state of the object";
+        case DARRAY_ERR_IO: return "input/output error";
+        case DARRAY_ERR_CORRUPT: return "invalid or corrupted data";
+        case DARRAY_ERR_UNSUPPORTED: return "not supported";
+    }
+    return "unknown status";
+}
+
+/**
+ * @brief Sets the handler that gets the diagnostics of arrays without their own handler
+ * Set it before starting threads that use the library.
+ *
+ * @param[in] handler The handler, NULL to stay silent (the default), @see array_log_stderr()
+ * @param[in] context Passed to every call of handler
+ */
+void array_set_default_log_handler(darray_log_handler handler, void* context){
+    default_handler = handler;
+    default_context = context;
+}
+
+/**
+ * @brief Sets the handler that gets the diagnostics of one array, instead of the default one
+ *
+ * @param[in,out] array   The target array
+ * @param[in]     handler The handler, NULL to use the default one again
+ * @param[in]     context Passed to every call of handler
+ * @return True if success, false if the array does not exist
+ */
+bool array_set_log_handler(dArray* array, darray_log_handler handler, void* context){
+    if (!array){
+        darray_report(NULL, DARRAY_ERR_NULL, "The array does not exist!");
+        return false;
+    }
+    array->log_handler = handler;
+    array->log_context = context;
+    return true;
+}
+
+/**
+ * @brief A ready-made handler that prints "ERROR! message" on stderr, how the library used to report
+ */
+void array_log_stderr(const dArray* array, darray_status status, const char* message, void* context){
+    (void)array;
+    (void)status;
+    (void)context;
+    fprintf(stderr, "ERROR! %s\n", message);
+}
@@ -0,0 +1,424 @@
+/**
+ * @file darray_hash_index.c
+ * @brief Optional hash index behind array_find() and friends, @see array_enable_hash_index()
+ *
+ * The index is an open addressing table (linear probing) with one slot per distinct
+ * value: the slot keeps the index of the first element with that value and how many
+ * elements have it, so duplicates cost nothing and a lookup never walks a list.
+ * Elements are not copied into the table, slots point back into the array.
+ *
+ * darray.c keeps the index up to date on the cheap changes: appends (an element added
+ * at the end never changes the first index of its value), array_set() and removals at
+ * the end. Every other change (inserts and removals that shift indexes, sorts, writes
+ * through array_data()...) only marks the index stale, and the next array_find() or
+ * array_remove_by_value() rebuilds it in one pass. Calls that take a const array never
+ * write to the index: with a stale one they scan the array, so they stay safe to run
+ * from several threads at once. Deleted slots are closed by moving the following ones
+ * back, so there are no tombstones and lookups stay short.
+ *
+ * Equality is the one of array_find(): the C == operator for the built-in types (NaN is
+ * never indexed, -0.0 and +0.0 are the same value), the compare callback for CUSTOM
+ * elements or their bytes without one.
+ */
+
+#include "darray_internal.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HASH_EMPTY SIZE_MAX       ///< first of a free slot
+#define HASH_MIN_CAPACITY 16      ///< Slots of a new table, always a power of 2
+#define HASH_MAX_LOAD(capacity) ((capacity) / 4 * 3) ///< Distinct values allowed before the table doubles
+
+/**
+ * @brief One distinct value
+ */
+typedef struct {
+    size_t first;  ///< Index of its first element, HASH_EMPTY for a free slot
+    size_t count;  ///< How many elements have it
+    uint64_t hash; ///< Its hash, kept to skip most comparisons and to move slots without hashing again
+} hash_slot;
+
+/**
+ * @brief The index of one array, @see array_enable_hash_index()
+ */
+struct darray_hash_index {
+    hash_slot* slots;
+    size_t capacity; ///< Power of 2
+    size_t used;     ///< Slots in use, distinct values
+    bool stale;      ///< The slots may not match the array, rebuild before use
+};
+
+/**
+ * @brief Final mix of splitmix64, spreads every input bit over the whole hash
+ */
+static inline uint64_t mix(uint64_t value){
+    value ^= value >> 30;
+    value *= UINT64_C(0xBF58476D1CE4E5B9);
+    value ^= value >> 27;
+    value *= UINT64_C(0x94D049BB133111EB);
+    return value ^ (value >> 31);
+}
+
+/**
+ * @brief Hash of the raw bytes of an element, 8 bytes at a time
+ */
+static uint64_t hash_bytes(const unsigned char* bytes, size_t length){
+    uint64_t hash = (uint64_t)length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8){
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = mix(hash ^ word);
+    }
+    if (i < length){
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, length - i);
+        hash = mix(hash ^ word);
+    }
+    return hash;
+}
+
+/**
+ * @brief Hashes an element
+ *
+ * @param[in]  array       The array the element belongs to
+ * @param[in]  element     Pointer to the element
+ * @param[out] store_hash  The hash
+ * @return True if success, false for a NaN, which is never equal to anything
+ */
+static bool element_hash(const dArray* array, const void* element, uint64_t* store_hash){
+    switch(array->type){
+        case FLOAT: {
+            float value;
+            memcpy(&value, element, sizeof(value));
+            if (value != value){
+                return false;
+            }
+            value = value == 0 ? 0.0f : value; ///< -0.0 == +0.0
+            *store_hash = hash_bytes((const unsigned char*)&value, sizeof(value));
+            return true;
+        }
+        case DOUBLE: {
+            double value;
+            memcpy(&value, element, sizeof(value));
+            if (value != value){
+                return false;
+            }
+            value = value == 0 ? 0.0 : value;
+            *store_hash = hash_bytes((const unsigned char*)&value, sizeof(value));
+            return true;
+        }
+        case CUSTOM:
+            *store_hash = array->hash ? array->hash(element) : hash_bytes(element, array->type_size);
+            return true;
+        default:
+            *store_hash = hash_bytes(element, array->type_size);
+            return true;
+    }
+}
+
+/**
+ * @brief Checks if two elements are equal the way array_find() sees it
+ */
+static bool element_equal(const dArray* array, const void* first, const void* second){
+    switch(array->type){
+        case FLOAT: {
+            float a, b;
+            memcpy(&a, first, sizeof(a));
+            memcpy(&b, second, sizeof(b));
+            return a == b;
+        }
+        case DOUBLE: {
+            double a, b;
+            memcpy(&a, first, sizeof(a));
+            memcpy(&b, second, sizeof(b));
+            return a == b;
+        }
+        case CUSTOM:
+            if (array->compare){
+                return array->compare(first, second) == 0;
+            }
+            return memcmp(first, second, array->type_size) == 0;
+        default:
+            return memcmp(first, second, array->type_size) == 0;
+    }
+}
+
+/**
+ * @brief Finds the slot of a value
+ * @return The slot, or the free slot that ends its probe sequence
+ */
+static hash_slot* slot_lookup(const dArray* array, const struct darray_hash_index* index, const void* value, uint64_t hash){
+    size_t mask = index->capacity - 1;
+    for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask){
+        hash_slot* slot = &index->slots[i];
+        if (slot->first == HASH_EMPTY ||
+            (slot->hash == hash && element_equal(array, darray_element_at(array, slot->first), value))){
+            return slot;
+        }
+    }
+}
+
+/**
+ * @brief Moves the slots to a table of new_capacity slots
+ * @return True if success, false if memory allocation fail (the old table stays)
+ */
+static bool table_resize(struct darray_hash_index* index, size_t new_capacity){
+    hash_slot* slots = malloc(new_capacity * sizeof(hash_slot));
+    if (!slots){
+        return false;
+    }
+    for (size_t i = 0; i < new_capacity; i++){
+        slots[i].first = HASH_EMPTY;
+    }
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; i < index->capacity; i++){
+        hash_slot* slot = &index->slots[i];
+        if (slot->first == HASH_EMPTY){
+            continue;
+        }
+        size_t j = (size_t)slot->hash & mask;
+        while (slots[j].first != HASH_EMPTY){
+            j = (j + 1) & mask;
+        }
+        slots[j] = *slot;
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @brief Frees a slot, moving back the slots after it that probed past it
+ */
+static void slot_delete(struct darray_hash_index* index, hash_slot* slot){
+    size_t mask = index->capacity - 1;
+    size_t hole = (size_t)(slot - index->slots);
+    for (size_t i = (hole + 1) & mask; index->slots[i].first != HASH_EMPTY; i = (i + 1) & mask){
+        size_t home = (size_t)index->slots[i].hash & mask;
+        ///< The slot may fill the hole if its home is not in (hole, i], cyclically
+        bool movable = hole <= i ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (movable){
+            index->slots[hole] = index->slots[i];
+            hole = i;
+        }
+    }
+    index->slots[hole].first = HASH_EMPTY;
+    index->used--;
+}
+
+/**
+ * @brief Adds the element at position to the table
+ * @return True if success, false if memory allocation fail
+ */
+static bool table_add(const dArray* array, struct darray_hash_index* index, size_t position){
+    const void* element = darray_element_at(array, position);
+    uint64_t hash;
+    if (!element_hash(array, element, &hash)){
+        return true; ///< NaNs are never found, they need no slot
+    }
+    if (index->used + 1 > HASH_MAX_LOAD(index->capacity) && !table_resize(index, index->capacity * 2)){
+        return false;
+    }
+    hash_slot* slot = slot_lookup(array, index, element, hash);
+    if (slot->first == HASH_EMPTY){
+        *slot = (hash_slot){position, 1, hash};
+        index->used++;
+        return true;
+    }
+    slot->count++;
+    if (position < slot->first){
+        slot->first = position;
+    }
+    return true;
+}
+
+/**
+ * @brief Rebuilds a stale index from the whole array
+ * @return True if success, false if memory allocation fail (the index stays stale)
+ */
+static bool index_rebuild(const dArray* array, struct darray_hash_index* index){
+    for (size_t i = 0; i < index->capacity; i++){
+        index->slots[i].first = HASH_EMPTY;
+    }
+    index->used = 0;
+    for (size_t position = 0; position < array->used_size; position++){
+        if (!table_add(array, index, position)){
+            return false;
+        }
+    }
+    index->stale = false;
+    return true;
+}
+
+/**
+ * @brief Turns on the hash index of an array
+ * array_find(), array_count() and array_remove_by_value() then find the value in O(1)
+ * on average instead of scanning the whole array. The index is built here and takes
+ * 32 to 64 bytes per distinct value.
+ * Appends, array_set() and removals at the end keep it up to date; changes that shift
+ * indexes (inserts and removals before the end, sorts, array_reverse(), writes through
+ * array_data()...) make the next array_find() or array_remove_by_value() rebuild it, so
+ * interleaving those with lookups costs O(n) per lookup, like without the index.
+ * array_count() takes a const array and scans until one of them (or another call of
+ * this function) has rebuilt it.
+ * @note CUSTOM arrays with a compare callback need a hash callback consistent with it.
+ *
+ * @param[in,out] array The target array
+ * @return True if success (or already on, a stale index is rebuilt), false if the array
+ *         does not exist, is CUSTOM with compare but without hash, or memory allocation fail
+ */
+bool array_enable_hash_index(dArray* array){
+    if (!array){
+        darray_report(array, DARRAY_ERR_NULL, "The array does not exist!");
+        return false;
+    }
+    if (array->hash_index){
+        darray_hash_index_refresh(array);
+        return true;
+    }
+    if (array->type == CUSTOM && array->compare && !array->hash){
+        darray_report(array, DARRAY_ERR_UNSUPPORTED, "CUSTOM arrays with compare need a hash callback to be indexed!");
+        return false;
+    }
+    struct darray_hash_index* index = malloc(sizeof(struct darray_hash_index));
+    hash_slot* slots = malloc(HASH_MIN_CAPACITY * sizeof(hash_slot));
+    if (!index || !slots){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory for the hash index!");
+        free(index);
+        free(slots);
+        return false;
+    }
+    index->slots = slots;
+    index->capacity = HASH_MIN_CAPACITY;
+    index->used = 0;
+    index->stale = true;
+    array->hash_index = index;
+    darray_hash_index_refresh(array); ///< Out of memory leaves it stale, retried by the next array_find()
+    return true;
+}
+
+/**
+ * @brief Turns off the hash index and frees it, lookups scan the array again
+ *
+ * @param[in,out] array The target array
+ * @return True if success, false if the array does not exist or has no index
+ */
+bool array_disable_hash_index(dArray* array){
+    if (!array || !array->hash_index){
+        darray_report(array, DARRAY_ERR_STATE, "The array has no hash index!");
+        return false;
+    }
+    darray_hash_index_free(array);
+    return true;
+}
+
+/**
+ * @brief Tells if the hash index of the array is on, @see array_enable_hash_index()
+ */
+bool array_has_hash_index(const dArray* array){
+    return array && array->hash_index;
+}
+
+/**
+ * @brief Frees the index, called by array_delete()
+ */
+void darray_hash_index_free(dArray* array){
+    if (!array->hash_index){
+        return;
+    }
+    free(array->hash_index->slots);
+    free(array->hash_index);
+    array->hash_index = NULL;
+}
+
+/**
+ * @brief Rebuilds a stale index, called by the entry points that may change the array
+ * No-op without an index or when it is up to date.
+ */
+void darray_hash_index_refresh(dArray* array){
+    struct darray_hash_index* index = array->hash_index;
+    if (index && index->stale){
+        index_rebuild(array, index); ///< Stays stale if out of memory, lookups scan instead
+    }
+}
+
+/**
+ * @brief Looks a value up, never writes to the index so const callers stay read-only
+ *
+ * @param[in]  array       The target array, with an index
+ * @param[in]  value       The value
+ * @param[out] store_index Index of its first element
+ * @param[out] store_count How many elements have it, 0 if none
+ * @return True if the index answered, false if it is stale (scan the array instead)
+ */
+bool darray_hash_index_lookup(const dArray* array, const void* value, size_t* store_index, size_t* store_count){
+    const struct darray_hash_index* index = array->hash_index;
+    if (index->stale){
+        return false;
+    }
+    uint64_t hash;
+    *store_count = 0;
+    if (!element_hash(array, value, &hash)){
+        return true;
+    }
+    hash_slot* slot = slot_lookup(array, index, value, hash);
+    if (slot->first != HASH_EMPTY){
+        *store_index = slot->first;
+        *store_count = slot->count;
+    }
+    return true;
+}
+
+/**
+ * @brief Adds count elements that were just placed at index without moving any other element
+ * (appends and array_set()), used_size already includes them. No-op without an index.
+ */
+void darray_hash_index_add(dArray* array, size_t index, size_t count){
+    struct darray_hash_index* hash_index = array->hash_index;
+    if (!hash_index || hash_index->stale){
+        return;
+    }
+    for (size_t i = 0; i < count; i++){
+        if (!table_add(array, hash_index, index + i)){
+            hash_index->stale = true; ///< Retried by the next lookup
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Takes out the element at index before it is overwritten or popped from the end
+ * If it was the first of several equal elements the next one is unknown, and the index
+ * becomes stale.
+ */
+void darray_hash_index_drop(dArray* array, size_t index){
+    struct darray_hash_index* hash_index = array->hash_index;
+    if (!hash_index || hash_index->stale){
+        return;
+    }
+    const void* element = darray_element_at(array, index);
+    uint64_t hash;
+    if (!element_hash(array, element, &hash)){
+        return;
+    }
+    hash_slot* slot = slot_lookup(array, hash_index, element, hash);
+    if (slot->first == HASH_EMPTY || (slot->first == index && slot->count > 1)){
+        hash_index->stale = true;
+    } else if (slot->count == 1){
+        slot_delete(hash_index, slot);
+    } else {
+        slot->count--;
+    }
+}
+
+/**
+ * @brief Marks the index stale after a change that may have moved elements
+ */
+void darray_hash_index_invalidate(dArray* array){
+    if (array->hash_index){
+        array->hash_index->stale = true;
+    }
+}
@@ -0,0 +1,248 @@
+/**
+ * @file darray_internal.h
+ * @brief Private declarations shared between the library's translation units
+ *
+ * Nothing here is part of the public API, user code should only include darray.h.
+ */
+
+#ifndef DARRAY_INTERNAL_H
+#define DARRAY_INTERNAL_H
+
+#include "darray.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Who owns the memory of a dArray buffer
+ */
+typedef enum {
+    DARRAY_BUFFER_HEAP,   ///< Allocated through array->allocator
+    DARRAY_BUFFER_MAPPED, ///< Points inside a read-only file mapping, @see array_map_file()
+    DARRAY_BUFFER_INLINE  ///< The inline buffer right after the header, in the same block, @see darray_inline_buffer()
+} darray_buffer_kind;
+
+#ifndef DARRAY_STATS
+#ifdef NDEBUG
+#define DARRAY_STATS 0 ///< Release builds leave the counters out unless built with -DDARRAY_STATS=1
+#else
+#define DARRAY_STATS 1
+#endif
+#endif
+
+#if DARRAY_STATS
+/**
+ * @brief The counters behind darray_stats, relaxed atomics so readers of a const array
+ * can count from several threads at once, @see array_get_stats()
+ */
+typedef struct {
+    atomic_size_t reallocs;
+    atomic_size_t realloc_bytes;
+    atomic_size_t memmove_bytes;
+    atomic_size_t comparisons;
+    atomic_size_t sorts;
+    atomic_size_t sorted_elements;
+    atomic_size_t peak_capacity; ///< Only written by calls that may change the capacity
+} darray_counters;
+#endif
+
+/**
+ * @brief This is the main structure to control a dynamic array
+ * 
+ * This struct stores all the necessary information for manipulation and operations.
+ * Those fields should not be directly acessed, instead use the API functions. 
+ * @see array_new()
+ * @see array_delete()
+ */
+struct dArray {
+    void* dArray;                   ///< Generic pointer to the array on the heap
+    size_t total_size;              ///< Total capacity allocated (how many elements fits in)
+    size_t used_size;               ///< How many elements actually exists 
+    size_t sorted_size;             ///< How many elements at the beginning are known to be in array_sort() order
+    size_t min_capacity;            ///< Automatic shrinking never goes below this capacity (the start_size)
+    darray_growth_policy growth;    ///< How the capacity changes, @see array_set_growth_policy()
+    darray_allocator allocator;     ///< Where the header and the buffer memory come from
+    darray_buffer_kind buffer_kind; ///< Who owns the buffer, mapped arrays are read-only
+    size_t inline_capacity;         ///< How many elements fit in the inline buffer, 0 if the header block has none
+    bool owns_header;               ///< The header block comes from the allocator, false for array_init() storage
+    void* mapping;                  ///< Start of the file mapping when buffer_kind is DARRAY_BUFFER_MAPPED
+    size_t mapping_length;          ///< Length of that mapping in bytes
+    struct darray_concurrent* concurrent; ///< Segments filled by array_append_concurrent(), NULL outside concurrent mode
+    struct darray_hash_index* hash_index; ///< Value to first index table, NULL unless array_enable_hash_index() was called
+    darray_storage storage;         ///< How the elements are laid out in the buffer, @see array_new_ex()
+    size_t gap_tail;                ///< DARRAY_STORAGE_GAP: how many elements sit after the gap (0 when the gap is at the end), the gap is total_size - used_size long
+    size_t ring_head;               ///< DARRAY_STORAGE_RING: buffer slot of the element at index 0, the elements wrap around the end of the buffer
+    bool overwrite_oldest;          ///< DARRAY_STORAGE_RING: a full array drops its oldest elements instead of growing, @see darray_options
+    darray_log_handler log_handler; ///< Gets this array's diagnostics, NULL for the default handler
+    void* log_context;              ///< Passed to log_handler
+#if DARRAY_STATS
+    darray_counters stats;          ///< @see array_get_stats()
+    darray_resize_hook resize_hook; ///< Called after every capacity change, NULL for none
+    void* resize_context;           ///< Passed to resize_hook
+#endif
+    var_types type;                 ///< The variable type that this array stores, @see var_types
+    size_t type_size;               ///< sizeof one element, cached so element access never looks the type up
+    darray_compare compare;         ///< CUSTOM: the element order, NULL to compare bytes for equality only
+    darray_hash hash;               ///< CUSTOM: the element hash, NULL for a hash of the bytes
+};
+
+#if DARRAY_STATS
+#define DARRAY_COUNT(array, field, amount) \
+    atomic_fetch_add_explicit(&((dArray*)(array))->stats.field, (amount), memory_order_relaxed) ///< Const arrays count too
+#else
+#define DARRAY_COUNT(array, field, amount) ((void)(array))
+#endif
+
+/**
+ * @brief Zeroes the counters and the hook of a new array
+ */
+static inline void darray_stats_init(dArray* array){
+#if DARRAY_STATS
+    atomic_init(&array->stats.reallocs, 0);
+    atomic_init(&array->stats.realloc_bytes, 0);
+    atomic_init(&array->stats.memmove_bytes, 0);
+    atomic_init(&array->stats.comparisons, 0);
+    atomic_init(&array->stats.sorts, 0);
+    atomic_init(&array->stats.sorted_elements, 0);
+    atomic_init(&array->stats.peak_capacity, array->total_size);
+    array->resize_hook = NULL;
+    array->resize_context = NULL;
+#else
+    (void)array;
+#endif
+}
+
+/**
+ * @brief Where the inline buffer starts: the header size rounded up so any element type is aligned
+ */
+#define DARRAY_INLINE_OFFSET \
+    ((sizeof(struct dArray) + _Alignof(max_align_t) - 1) / _Alignof(max_align_t) * _Alignof(max_align_t))
+
+/**
+ * @brief The inline buffer of an array, inside the header block, @see DARRAY_BUFFER_INLINE
+ */
+static inline void* darray_inline_buffer(const dArray* array){
+    return (unsigned char*)array + DARRAY_INLINE_OFFSET;
+}
+
+/**
+ * @brief Bytes of the header block the allocator gave, the inline buffer included
+ */
+static inline size_t darray_header_bytes(const dArray* array){
+    return DARRAY_INLINE_OFFSET + array->inline_capacity*array->type_size;
+}
+
+size_t darray_type_size(var_types type);
+void darray_init_header(dArray* array, var_types type, size_t type_size, size_t capacity, size_t inline_capacity,
+                        const darray_options* options, const darray_allocator* allocator);
+
+//Status codes, @see darray_error.c
+void darray_report(const dArray* array, darray_status status, const char* message);
+
+//Concurrent append mode, @see darray_concurrent.c
+void darray_concurrent_free(dArray* array);
+
+//Hash index, @see darray_hash_index.c
+const void* darray_element_at(const dArray* array, size_t index);
+bool darray_hash_index_lookup(const dArray* array, const void* value, size_t* store_index, size_t* store_count);
+void darray_hash_index_refresh(dArray* array);
+void darray_hash_index_add(dArray* array, size_t index, size_t count);
+void darray_hash_index_drop(dArray* array, size_t index);
+void darray_hash_index_invalidate(dArray* array);
+void darray_hash_index_free(dArray* array);
+
+//Persistence, @see darray_io.c
+void darray_unmap_file(void* mapping, size_t length);
+
+//Sort keys: unsigned integers that compare in the same order array_sort() uses
+
+/**
+ * @brief Maps an int to an unsigned key with the same order, flipping the sign bit
+ */
+static inline uint32_t key_int(int value){
+    return (uint32_t)value ^ UINT32_C(0x80000000);
+}
+
+/**
+ * @brief Maps a float to an unsigned key with the same order
+ * Negative numbers have all bits flipped, positive ones only the sign bit, so
+ * -0.0 gets a key right below +0.0. NaNs get the biggest key of all.
+ */
+static inline uint32_t key_float(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (value != value){
+        return UINT32_MAX;
+    }
+    return (bits & UINT32_C(0x80000000)) ? ~bits : bits | UINT32_C(0x80000000);
+}
+
+/**
+ * @brief Generates key_name() for a signed integer type T with the unsigned key type K, flipping the sign bit
+ */
+#define DARRAY_SIGNED_KEY(T, K, name) \
+static inline K key_##name(T value){return (K)value ^ ((K)1 << (sizeof(K)*8 - 1));}
+
+/**
+ * @brief Generates key_name() for an unsigned integer type, its own key
+ */
+#define DARRAY_UNSIGNED_KEY(T, K, name) \
+static inline K key_##name(T value){return value;}
+
+DARRAY_SIGNED_KEY(int8_t, uint8_t, i8)
+DARRAY_SIGNED_KEY(int16_t, uint16_t, i16)
+DARRAY_SIGNED_KEY(int64_t, uint64_t, i64)
+DARRAY_UNSIGNED_KEY(uint8_t, uint8_t, u8)
+DARRAY_UNSIGNED_KEY(uint16_t, uint16_t, u16)
+DARRAY_UNSIGNED_KEY(uint32_t, uint32_t, u32)
+DARRAY_UNSIGNED_KEY(uint64_t, uint64_t, u64)
+
+/**
+ * @brief Calls X(TYPE, T, K, name) for every integer var_types
+ * TYPE is the enum value, T the C type, K the unsigned type of its sort key (key_name())
+ * and name the prefix of the functions generated for it. The modules generate and
+ * dispatch their integer kernels with it; FLOAT and DOUBLE have NaNs and are written out.
+ */
+#define DARRAY_FOR_EACH_INTEGER(X)    \
+    X(INT, int, uint32_t, int)        \
+    X(INT8, int8_t, uint8_t, i8)      \
+    X(INT16, int16_t, uint16_t, i16)  \
+    X(INT64, int64_t, uint64_t, i64)  \
+    X(UINT8, uint8_t, uint8_t, u8)    \
+    X(UINT16, uint16_t, uint16_t, u16) \
+    X(UINT32, uint32_t, uint32_t, u32) \
+    X(UINT64, uint64_t, uint64_t, u64)
+
+/**
+ * @brief Same as key_float() for doubles
+ */
+static inline uint64_t key_double(double value){
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (value != value){
+        return UINT64_MAX;
+    }
+    return (bits & UINT64_C(0x8000000000000000)) ? ~bits : bits | UINT64_C(0x8000000000000000);
+}
+
+//Sort engine, @see darray_sort.c
+bool darray_sort_buffer(void* data, size_t size, var_types type, darray_sort_algo algorithm);
+bool darray_merge_buffer(void* data, size_t split, size_t size, var_types type);
+void darray_sort_scratch(void* data, void* scratch, size_t size, var_types type);
+void darray_sort_custom(void* data, size_t size, size_t element_size, darray_compare compare);
+void darray_select_buffer(void* data, size_t size, size_t nth, var_types type);
+bool darray_argsort_buffer(const void* data, size_t size, var_types type, size_t* store_indices);
+bool darray_argsort_custom(const void* data, size_t size, size_t element_size, darray_compare compare, size_t* store_indices);
+
+//Multithreaded sort and the thread helpers shared with the reductions, @see darray_parallel.c
+#define DARRAY_MAX_THREADS 256
+bool darray_sort_parallel(void* data, size_t size, size_t sorted_prefix, var_types type, unsigned threads);
+void darray_run_tasks(void* (*worker)(void*), void* tasks, size_t task_size, size_t count);
+unsigned darray_thread_count(unsigned requested);
+
+//Vectorized search kernels, @see darray_simd.c
+size_t darray_simd_find(const void* data, size_t size, const void* value, var_types type);
+size_t darray_simd_count(const void* data, size_t size, const void* value, var_types type);
+
+#endif
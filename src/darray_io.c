@@ -0,0 +1,420 @@
+/**
+ * @file darray_io.c
+ * @brief Saving arrays to disk and loading them back, @see array_save()
+ *
+ * File layout (native byte order, all offsets in bytes):
+ *
+ *     0   file_header   magic, version, byte order mark, type, count, checksum, flags
+ *     64  payload       count elements, exactly as they are in memory
+ *
+ * The payload starts at a cache line boundary (and a page is a multiple of that), so
+ * array_map_file() can hand out a pointer into the mapping without copying anything.
+ * Files are not portable between machines of different byte order, loading them fails.
+ * CUSTOM elements are saved as their bytes; the compare and hash callbacks can not be
+ * saved, so CUSTOM arrays come back without them and not known sorted.
+ */
+
+#define _POSIX_C_SOURCE 200809L ///< fileno(), fstat(), fsync(), mkstemp() and mmap()
+#include "darray_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DARRAY_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define DARRAY_HAVE_MMAP 0
+#endif
+
+#define FILE_MAGIC "DARRAY\0\1"
+#define FILE_VERSION 1
+#define FILE_BYTE_ORDER UINT32_C(0x01020304) ///< Reads back as 0x04030201 on the other endianness
+#define FILE_PAYLOAD_OFFSET 64
+#define FILE_FLAG_SORTED UINT32_C(1)          ///< The payload is in array_sort() order
+
+/**
+ * @brief The header at the start of every file
+ */
+typedef struct {
+    char magic[8];           ///< FILE_MAGIC
+    uint32_t version;        ///< FILE_VERSION, bumped on every incompatible change
+    uint32_t byte_order;     ///< FILE_BYTE_ORDER as written by the saving machine
+    uint32_t type;           ///< The var_types of the elements
+    uint32_t type_size;      ///< sizeof one element, checked against this build (the element_size of CUSTOM)
+    uint64_t count;          ///< How many elements are in the payload
+    uint64_t payload_offset; ///< Where the payload starts, FILE_PAYLOAD_OFFSET for version 1
+    uint64_t checksum;       ///< payload_checksum() of the payload bytes
+    uint32_t flags;          ///< FILE_FLAG_* bits
+    uint32_t reserved;       ///< Zero
+} file_header;
+
+_Static_assert(sizeof(file_header) <= FILE_PAYLOAD_OFFSET, "The header must fit before the payload");
+
+/**
+ * @brief Mixes one 64 bit word into a checksum lane
+ */
+static inline uint64_t checksum_round(uint64_t lane, uint64_t word){
+    lane += word * UINT64_C(0xC2B2AE3D27D4EB4F);
+    lane = (lane << 31) | (lane >> 33);
+    return lane * UINT64_C(0x9E3779B185EBCA87);
+}
+
+/**
+ * @brief Checksum of the payload, 4 independent lanes so it runs at memory speed
+ * Catches truncated and corrupted files, it is not meant to resist tampering.
+ *
+ * @param[in] data   The bytes
+ * @param[in] length How many bytes
+ * @return The checksum
+ */
+static uint64_t payload_checksum(const void* data, size_t length){
+    const unsigned char* bytes = data;
+    uint64_t lanes[4] = {
+        UINT64_C(0x60EA27EEADC0B5D6), UINT64_C(0xC2B2AE3D27D4EB4F),
+        UINT64_C(0x0000000000000000), UINT64_C(0x61C8864E7A143579)
+    };
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32){
+        for (int lane = 0; lane < 4; lane++){
+            uint64_t word;
+            memcpy(&word, bytes + i + 8*lane, sizeof(word));
+            lanes[lane] = checksum_round(lanes[lane], word);
+        }
+    }
+    uint64_t hash = (uint64_t)length;
+    for (int lane = 0; lane < 4; lane++){
+        hash = checksum_round(hash, lanes[lane]);
+    }
+    for (; i < length; i++){
+        hash = checksum_round(hash, bytes[i]);
+    }
+    hash ^= hash >> 29;
+    hash *= UINT64_C(0x165667B19E3779F9);
+    return hash ^ (hash >> 32);
+}
+
+/**
+ * @brief Checks that a header was written by a compatible build
+ *
+ * @param[in] header    The header read from the file
+ * @param[in] file_size Size of the whole file in bytes
+ * @return True if the payload can be used as it is, false if not
+ */
+static bool header_valid(const file_header* header, uint64_t file_size){
+    if (memcmp(header->magic, FILE_MAGIC, sizeof(header->magic)) != 0){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "Not a dArray file!");
+        return false;
+    }
+    if (header->version != FILE_VERSION){
+        darray_report(NULL, DARRAY_ERR_UNSUPPORTED, "Unsupported dArray file version!");
+        return false;
+    }
+    if (header->byte_order != FILE_BYTE_ORDER){
+        darray_report(NULL, DARRAY_ERR_UNSUPPORTED, "The file was saved with a different byte order!");
+        return false;
+    }
+    ///< CUSTOM takes any element size but 0, which the size checks below would divide by
+    if (header->type > CUSTOM || header->type_size == 0 ||
+            (header->type != CUSTOM && header->type_size != darray_type_size((var_types)header->type))){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "Invalid type in the file!");
+        return false;
+    }
+    if (header->payload_offset != FILE_PAYLOAD_OFFSET || header->count > (SIZE_MAX - FILE_PAYLOAD_OFFSET) / header->type_size
+            || header->count * header->type_size > file_size - FILE_PAYLOAD_OFFSET){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "The file is truncated!");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Creates the temporary file array_save() writes before renaming it over path
+ * On POSIX systems the name is path plus a unique suffix from mkstemp(), so processes
+ * saving to the same path never share it; elsewhere it is "path.tmp".
+ *
+ * @param[in]  array           The array being saved, for error reports
+ * @param[in]  path            The final path
+ * @param[out] store_temp_path The temporary path, freed by the caller
+ * @return The file open for writing, NULL if it can not be created (already reported)
+ */
+static FILE* open_temp_file(const dArray* array, const char* path, char** store_temp_path){
+#if DARRAY_HAVE_MMAP
+    static const char suffix[] = ".XXXXXX";
+#else
+    static const char suffix[] = ".tmp";
+#endif
+    size_t path_length = strlen(path);
+    char* temp_path = malloc(path_length + sizeof(suffix));
+    if (!temp_path){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
+        return NULL;
+    }
+    memcpy(temp_path, path, path_length);
+    memcpy(temp_path + path_length, suffix, sizeof(suffix));
+#if DARRAY_HAVE_MMAP
+    FILE* file = NULL;
+    int descriptor = mkstemp(temp_path);
+    if (descriptor != -1){
+        ///< mkstemp() makes it private to the owner, saved files are readable by everyone like with fopen()
+        fchmod(descriptor, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        file = fdopen(descriptor, "wb");
+        if (!file){
+            close(descriptor);
+            remove(temp_path);
+        }
+    }
+#else
+    FILE* file = fopen(temp_path, "wb");
+#endif
+    if (!file){
+        darray_report(array, DARRAY_ERR_IO, "Unable to open the file for writing!");
+        free(temp_path);
+        return NULL;
+    }
+    *store_temp_path = temp_path;
+    return file;
+}
+
+/**
+ * @brief Flushes the written data of file down to the disk
+ * @return True if success, false if the data may not be on the disk
+ */
+static bool sync_file(FILE* file){
+    if (fflush(file) != 0){
+        return false;
+    }
+#if DARRAY_HAVE_MMAP
+    return fsync(fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+/**
+ * @brief Makes the rename of a file in the directory of path durable, best effort
+ * Some file systems refuse fsync() on directories, the save does not fail for that.
+ */
+static void sync_directory(const char* path){
+#if DARRAY_HAVE_MMAP
+    const char* slash = strrchr(path, '/');
+    char* directory = slash ? malloc((size_t)(slash - path) + 2) : NULL;
+    if (slash && !directory){
+        return;
+    }
+    if (directory){
+        size_t length = slash == path ? 1 : (size_t)(slash - path); ///< Keeps the root "/"
+        memcpy(directory, path, length);
+        directory[length] = '\0';
+    }
+    int descriptor = open(directory ? directory : ".", O_RDONLY);
+    free(directory);
+    if (descriptor != -1){
+        fsync(descriptor);
+        close(descriptor);
+    }
+#else
+    (void)path;
+#endif
+}
+
+/**
+ * @brief Writes the array to a file, @see array_load() and array_map_file()
+ * The data goes to a temporary file next to path, is flushed to the disk with fsync()
+ * and only then renamed over path, and the directory is synced after the rename. A crash
+ * of the process or of the machine leaves either the old file or the new one, never a
+ * half written file. Systems without POSIX I/O get the rename but no fsync(), so there
+ * only process crashes are covered.
+ *
+ * @param[in] array The array to save
+ * @param[in] path  Where to save it, replaced if it exists
+ * @return True if success, false if the array does not exist or writing fails
+ */
+bool array_save(const dArray* array, const char* path){
+    if (!array || !path){
+        darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Invalid array or path!");
+        return false;
+    }
+    size_t type_size = array->type_size;
+    if (type_size > UINT32_MAX){
+        darray_report(array, DARRAY_ERR_UNSUPPORTED, "The elements are too big to be saved!");
+        return false;
+    }
+    size_t length = array->used_size * type_size;
+
+    file_header header = {0};
+    memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.version = FILE_VERSION;
+    header.byte_order = FILE_BYTE_ORDER;
+    header.type = (uint32_t)array->type;
+    header.type_size = (uint32_t)type_size;
+    header.count = array->used_size;
+    header.payload_offset = FILE_PAYLOAD_OFFSET;
+    const void* payload = array_data_const(array); ///< Contiguous, even for gap buffers
+    header.checksum = payload_checksum(payload, length);
+    header.flags = array->sorted_size >= array->used_size ? FILE_FLAG_SORTED : 0;
+
+    unsigned char head[FILE_PAYLOAD_OFFSET] = {0};
+    memcpy(head, &header, sizeof(header));
+
+    char* temp_path;
+    FILE* file = open_temp_file(array, path, &temp_path);
+    if (!file){
+        return false;
+    }
+    bool written = fwrite(head, 1, sizeof(head), file) == sizeof(head)
+                && fwrite(payload, 1, length, file) == length
+                && sync_file(file);
+    if (fclose(file) != 0 || !written || rename(temp_path, path) != 0){
+        darray_report(array, DARRAY_ERR_IO, "Failed to write the file!");
+        remove(temp_path);
+        free(temp_path);
+        return false;
+    }
+    free(temp_path);
+    sync_directory(path);
+    return true;
+}
+
+/**
+ * @brief Reads a file written by array_save() into a new array
+ * The checksum is verified, and an array saved sorted comes back known sorted.
+ *
+ * @param[in] path The file
+ * @return The new array (delete it with array_delete()), NULL if the file is invalid or reading fails
+ */
+dArray* array_load(const char* path){
+    if (!path){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Invalid path!");
+        return NULL;
+    }
+    FILE* file = fopen(path, "rb");
+    if (!file){
+        darray_report(NULL, DARRAY_ERR_IO, "Unable to open the file!");
+        return NULL;
+    }
+    unsigned char head[FILE_PAYLOAD_OFFSET];
+    file_header header;
+    long file_size = -1;
+    if (fread(head, 1, sizeof(head), file) == sizeof(head) && fseek(file, 0, SEEK_END) == 0){
+        file_size = ftell(file);
+    }
+    if (file_size < 0 || fseek(file, FILE_PAYLOAD_OFFSET, SEEK_SET) != 0){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "The file is truncated!");
+        fclose(file);
+        return NULL;
+    }
+    memcpy(&header, head, sizeof(header));
+    if (!header_valid(&header, (uint64_t)file_size)){
+        fclose(file);
+        return NULL;
+    }
+
+    size_t count = (size_t)header.count;
+    size_t length = count * header.type_size;
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    if (header.type == CUSTOM){
+        options.element_size = header.type_size;
+    }
+    dArray* array = array_new_ex((var_types)header.type, count > 0 ? count : 1, &options);
+    if (!array){
+        fclose(file);
+        return NULL;
+    }
+    bool read = fread(array->dArray, 1, length, file) == length;
+    fclose(file);
+    if (!read || payload_checksum(array->dArray, length) != header.checksum){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "The file is corrupted!");
+        array_delete(&array);
+        return NULL;
+    }
+    array->used_size = count;
+    array->sorted_size = (header.flags & FILE_FLAG_SORTED) && header.type != CUSTOM ? count : 0;
+    return array;
+}
+
+/**
+ * @brief Opens a file written by array_save() without reading it
+ * The array points straight into a read-only mapping of the file, pages are loaded by
+ * the kernel on first touch, so opening costs the same for any file size. Every
+ * function that changes the array fails on it, array_data() returns NULL: use
+ * array_data_const() or array_span_const(), or array_extend() into a normal array
+ * to get a writable copy. Only the header is validated, the checksum is not, since
+ * that would read the whole file.
+ * @note Where mmap is not available this is the same as array_load().
+ *
+ * @param[in] path The file
+ * @return The new read-only array (delete it with array_delete()), NULL if the file is invalid or mapping fails
+ */
+dArray* array_map_file(const char* path){
+#if DARRAY_HAVE_MMAP
+    if (!path){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Invalid path!");
+        return NULL;
+    }
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0){
+        darray_report(NULL, DARRAY_ERR_IO, "Unable to open the file!");
+        return NULL;
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size < FILE_PAYLOAD_OFFSET){
+        darray_report(NULL, DARRAY_ERR_CORRUPT, "The file is truncated!");
+        close(descriptor);
+        return NULL;
+    }
+    size_t length = (size_t)status.st_size;
+    void* mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor); ///< The mapping keeps the file alive
+    if (mapping == MAP_FAILED){
+        darray_report(NULL, DARRAY_ERR_IO, "Failed to map the file!");
+        return NULL;
+    }
+
+    file_header header;
+    memcpy(&header, mapping, sizeof(header));
+    if (!header_valid(&header, (uint64_t)length)){
+        munmap(mapping, length);
+        return NULL;
+    }
+
+    const darray_allocator* allocator = array_system_allocator();
+    dArray* array = allocator->alloc(allocator->context, DARRAY_INLINE_OFFSET);
+    if (!array){
+        darray_report(NULL, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
+        munmap(mapping, length);
+        return NULL;
+    }
+    darray_options options = DARRAY_OPTIONS_DEFAULT; ///< Flat, no callbacks
+    darray_init_header(array, (var_types)header.type, header.type_size, (size_t)header.count, 0, &options, allocator);
+    array->dArray = (unsigned char*)mapping + FILE_PAYLOAD_OFFSET;
+    array->used_size = (size_t)header.count;
+    array->sorted_size = (header.flags & FILE_FLAG_SORTED) && header.type != CUSTOM ? (size_t)header.count : 0;
+    array->buffer_kind = DARRAY_BUFFER_MAPPED;
+    array->owns_header = true;
+    array->mapping = mapping;
+    array->mapping_length = length;
+    return array;
+#else
+    return array_load(path);
+#endif
+}
+
+/**
+ * @brief Releases the mapping behind an array made by array_map_file(), called by array_delete()
+ *
+ * @param[in] mapping Start of the mapping
+ * @param[in] length  Its length in bytes
+ */
+void darray_unmap_file(void* mapping, size_t length){
+#if DARRAY_HAVE_MMAP
+    munmap(mapping, length);
+#else
+    (void)mapping;
+    (void)length;
+#endif
+}
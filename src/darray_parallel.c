@@ -0,0 +1,242 @@
+/**
+ * @file darray_parallel.c
+ * @brief Multithreaded sort behind array_sort_parallel()
+ *
+ * The unsorted part of the array is cut in one slice per thread and every thread sorts
+ * its slice with the serial engine (@see darray_sort.c), using its own part of one shared
+ * scratch buffer. The sorted runs (the already sorted beginning of the array is one more
+ * run) are then merged in pairs, round after round, between the array and the scratch
+ * buffer. Every merge is split among several threads by merge path: a binary search finds
+ * where each thread's share of the output starts in both runs, so all threads stay busy
+ * even in the last round, when only one merge is left.
+ *
+ * Merges keep the left element first on equal keys and the runs stay in array order, so
+ * the result is exactly the one of array_sort(), NaN order included.
+ */
+
+#define _POSIX_C_SOURCE 200809L ///< sysconf()
+#include "darray_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifndef DARRAY_PARALLEL_MIN_SLICE
+#define DARRAY_PARALLEL_MIN_SLICE ((size_t)1 << 16) ///< Fewer elements than this per thread are not worth a thread
+#endif
+
+/**
+ * @brief One thread's share of the first phase
+ */
+typedef struct {
+    unsigned char* data;
+    unsigned char* scratch;
+    size_t size;
+    var_types type;
+} sort_task;
+
+/**
+ * @brief One thread's share of a merge round: output positions [begin, end) of the
+ * merge of left and right into out. A run without partner is copied with right_size 0.
+ */
+typedef struct {
+    const unsigned char* left;
+    size_t left_size;
+    const unsigned char* right;
+    size_t right_size;
+    unsigned char* out;
+    size_t begin;
+    size_t end;
+    var_types type;
+} merge_task;
+
+/**
+ * @brief Generates name_merge_range(), the merge path merge of one merge_task
+ * name_co_rank() tells how many elements of left are among the first diagonal elements
+ * of the merged output.
+ */
+#define DEFINE_MERGE_PATH(T, name, KEY)                                                     \
+static size_t name##_co_rank(const T* left, size_t left_size, const T* right, size_t right_size, size_t diagonal){ \
+    size_t low = diagonal > right_size ? diagonal - right_size : 0;                         \
+    size_t high = diagonal < left_size ? diagonal : left_size;                              \
+    while (low < high){                                                                     \
+        size_t middle = low + (high - low)/2;                                               \
+        if (KEY(left[middle]) <= KEY(right[diagonal - middle - 1])){                        \
+            low = middle + 1;                                                               \
+        } else {                                                                            \
+            high = middle;                                                                  \
+        }                                                                                   \
+    }                                                                                       \
+    return low;                                                                             \
+}                                                                                           \
+                                                                                            \
+static void name##_merge_range(const merge_task* task){                                     \
+    const T* left = (const T*)task->left;                                                   \
+    const T* right = (const T*)task->right;                                                 \
+    size_t i = name##_co_rank(left, task->left_size, right, task->right_size, task->begin); \
+    size_t i_end = name##_co_rank(left, task->left_size, right, task->right_size, task->end); \
+    size_t j = task->begin - i, j_end = task->end - i_end;                                  \
+    T* out = (T*)task->out + task->begin;                                                   \
+    while (i < i_end && j < j_end){                                                         \
+        if (KEY(right[j]) < KEY(left[i])){                                                  \
+            *out++ = right[j++];                                                            \
+        } else {                                                                            \
+            *out++ = left[i++];                                                             \
+        }                                                                                   \
+    }                                                                                       \
+    memcpy(out, left + i, (i_end - i)*sizeof(T));                                           \
+    memcpy(out + (i_end - i), right + j, (j_end - j)*sizeof(T));                            \
+}
+
+#define DEFINE_INTEGER_MERGE_PATH(TYPE, T, K, name) DEFINE_MERGE_PATH(T, name, key_##name)
+DARRAY_FOR_EACH_INTEGER(DEFINE_INTEGER_MERGE_PATH)
+DEFINE_MERGE_PATH(float, float, key_float)
+DEFINE_MERGE_PATH(double, double, key_double)
+
+static void* sort_worker(void* argument){
+    sort_task* task = argument;
+    darray_sort_scratch(task->data, task->scratch, task->size, task->type);
+    return NULL;
+}
+
+static void* merge_worker(void* argument){
+    merge_task* task = argument;
+#define MERGE_RANGE_CASE(TYPE, T, K, name) case TYPE: name##_merge_range(task); break;
+    switch(task->type){
+        DARRAY_FOR_EACH_INTEGER(MERGE_RANGE_CASE)
+        case FLOAT: float_merge_range(task); break;
+        case DOUBLE: double_merge_range(task); break;
+        case CUSTOM: break; ///< Never sorted in parallel
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs worker on every task, one thread each, and waits for all of them
+ * count must not exceed DARRAY_MAX_THREADS.
+ * The calling thread takes the last task. If a thread can not be created its task
+ * runs on the calling thread, so the work always gets done.
+ */
+void darray_run_tasks(void* (*worker)(void*), void* tasks, size_t task_size, size_t count){
+    pthread_t threads[DARRAY_MAX_THREADS];
+    bool started[DARRAY_MAX_THREADS];
+    unsigned char* task = tasks;
+    for (size_t i = 0; i + 1 < count; i++){
+        started[i] = pthread_create(&threads[i], NULL, worker, task + i*task_size) == 0;
+        if (!started[i]){
+            worker(task + i*task_size);
+        }
+    }
+    if (count > 0){
+        worker(task + (count - 1)*task_size);
+    }
+    for (size_t i = 0; i + 1 < count; i++){
+        if (started[i]){
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+/**
+ * @brief How many threads to use when the caller asked for requested (0 means one per online CPU)
+ * @return A number between 1 and DARRAY_MAX_THREADS - 1
+ */
+unsigned darray_thread_count(unsigned requested){
+    if (requested == 0){
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = online > 0 ? (unsigned)online : 1;
+    }
+    if (requested > DARRAY_MAX_THREADS - 1){
+        requested = DARRAY_MAX_THREADS - 1; ///< Merge rounds have up to threads + 1 tasks
+    }
+    return requested;
+}
+
+/**
+ * @brief Sorts a buffer with several threads, @see array_sort_parallel()
+ *
+ * @param[in,out] data          The elements
+ * @param[in]     size          How many elements
+ * @param[in]     sorted_prefix How many elements at the beginning are already sorted
+ * @param[in]     type          The variable type of the elements
+ * @param[in]     threads       How many threads to use, 0 for one per online CPU
+ * @return True if sorted, false if the input is too small to be worth threads, the type
+ *         is CUSTOM or memory allocation fail (the buffer is left untouched, sort it with the serial engine)
+ */
+bool darray_sort_parallel(void* data, size_t size, size_t sorted_prefix, var_types type, unsigned threads){
+    if (type == CUSTOM){
+        return false;
+    }
+    threads = darray_thread_count(threads);
+    size_t unsorted = size - sorted_prefix;
+    if (threads > unsorted / DARRAY_PARALLEL_MIN_SLICE){
+        threads = (unsigned)(unsorted / DARRAY_PARALLEL_MIN_SLICE);
+    }
+    if (threads < 2){
+        return false;
+    }
+    size_t type_size = darray_type_size(type);
+    unsigned char* scratch = malloc(size*type_size);
+    if (!scratch){
+        return false;
+    }
+
+    ///< Phase 1: every thread sorts one slice of the unsorted part
+    sort_task sorts[DARRAY_MAX_THREADS];
+    size_t bounds[DARRAY_MAX_THREADS + 1]; ///< Run r is [bounds[r], bounds[r+1])
+    size_t runs = 0;
+    if (sorted_prefix > 0){
+        bounds[runs++] = 0;
+    }
+    for (unsigned t = 0; t < threads; t++){
+        size_t begin = sorted_prefix + unsorted*t/threads;
+        size_t end = sorted_prefix + unsorted*(t + 1)/threads;
+        bounds[runs++] = begin;
+        sorts[t] = (sort_task){(unsigned char*)data + begin*type_size, scratch + begin*type_size, end - begin, type};
+    }
+    bounds[runs] = size;
+    darray_run_tasks(sort_worker, sorts, sizeof(sort_task), threads);
+
+    ///< Phase 2: merge runs in pairs until one is left, ping-ponging between data and scratch
+    merge_task merges[DARRAY_MAX_THREADS];
+    unsigned char* source = data;
+    unsigned char* target = scratch;
+    while (runs > 1){
+        size_t pairs = runs / 2;
+        size_t pieces = threads / pairs > 0 ? threads / pairs : 1; ///< Threads given to each merge
+        size_t count = 0, next_runs = 0;
+        for (size_t r = 0; r < runs; r += 2){
+            bool alone = r + 1 == runs; ///< Odd run out, copied as it is
+            size_t begin = bounds[r];
+            size_t middle = alone ? size : bounds[r + 1];
+            size_t end = alone ? size : bounds[r + 2];
+            size_t length = end - begin;
+            size_t share = alone ? 1 : pieces;
+            for (size_t p = 0; p < share; p++){
+                merges[count++] = (merge_task){
+                    source + begin*type_size, middle - begin,
+                    source + middle*type_size, end - middle,
+                    target + begin*type_size, length*p/share, length*(p + 1)/share, type
+                };
+            }
+            bounds[next_runs++] = begin;
+        }
+        bounds[next_runs] = size;
+        runs = next_runs;
+        darray_run_tasks(merge_worker, merges, sizeof(merge_task), count);
+        unsigned char* swap = source;
+        source = target;
+        target = swap;
+    }
+
+    ///< The result is in source, copy it back in parallel if that is the scratch buffer
+    if (source != (unsigned char*)data){
+        for (unsigned t = 0; t < threads; t++){
+            merges[t] = (merge_task){source, size, source, 0, data, size*t/threads, size*(t + 1)/threads, type};
+        }
+        darray_run_tasks(merge_worker, merges, sizeof(merge_task), threads);
+    }
+    free(scratch);
+    return true;
+}
@@ -0,0 +1,475 @@
+/**
+ * @file darray_reduce.c
+ * @brief Reductions over the whole array: sum, min/max, argmin/argmax, mean and variance
+ *
+ * The kernels read the buffer directly, a vector at a time, and exist in a baseline
+ * version (16 byte vectors) and, on x86, in AVX2 and AVX-512 versions picked at startup
+ * like the search kernels of darray_simd.c. They are written with the GCC vector
+ * extensions, so one macro generates all of them.
+ *
+ * Accuracy: sums are pairwise (vector sums of blocks of PAIRWISE_BLOCK elements, added
+ * in a balanced tree), which keeps the rounding error growing with log(n) instead of n.
+ * Blocks of integers up to 32 bits are summed exactly in 64 bit integers, INT64 and
+ * UINT64 blocks in double. The variance takes two passes, the second one sums the
+ * squared distances to the mean. The 8, 16 and 64 bit integer types and UINT32 only
+ * have the baseline kernels. CUSTOM arrays have no reductions.
+ *
+ * NaNs: sum, mean and variance propagate them, min/max and argmin/argmax skip them.
+ */
+
+#include "darray_internal.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DARRAY_REDUCE_X86 1
+#else
+#define DARRAY_REDUCE_X86 0
+#endif
+
+#define PAIRWISE_BLOCK 4096 ///< Elements summed by one kernel call, exact for INT (2^31 * 4096 < 2^53)
+
+#ifndef DARRAY_REDUCE_MIN_SLICE
+#define DARRAY_REDUCE_MIN_SLICE ((size_t)1 << 18) ///< Fewer elements than this per thread are not worth a thread
+#endif
+
+typedef double (*sum_kernel)(const void* data, size_t size);
+typedef double (*squares_kernel)(const void* data, size_t size, double mean);
+typedef void (*extreme_kernel)(const void* data, size_t size, void* store_value);
+
+/**
+ * @brief Generates the reduction kernels for the element type T with vectors of BYTES bytes
+ *
+ * - name_sum():     Sum, accumulated in SUM_T (int64_t for the integers up to 32 bits, double for the others)
+ * - name_squares(): Sum of (x - mean)^2, in double
+ * - name_min():     Smallest element, LOW/HIGH are the starting values (NaNs never replace them)
+ * - name_max():     Biggest element
+ */
+#define DEFINE_REDUCE_KERNELS(ATTR, T, SUM_T, LOW, HIGH, name, BYTES)                       \
+typedef T name##_vec __attribute__((vector_size(BYTES)));                                   \
+typedef SUM_T name##_sum_vec __attribute__((vector_size(BYTES / sizeof(T) * sizeof(SUM_T)))); \
+typedef double name##_dev_vec __attribute__((vector_size(BYTES / sizeof(T) * sizeof(double)))); \
+                                                                                            \
+ATTR static double name##_sum(const void* data, size_t size){                               \
+    enum { LANES = BYTES / sizeof(T) };                                                     \
+    const T* elements = data;                                                               \
+    name##_sum_vec total0 = {0}, total1 = {0};                                              \
+    size_t i = 0;                                                                           \
+    for (; i + 2*LANES <= size; i += 2*LANES){                                              \
+        name##_vec x0, x1;                                                                  \
+        memcpy(&x0, elements + i, sizeof(x0));                                              \
+        memcpy(&x1, elements + i + LANES, sizeof(x1));                                      \
+        total0 += __builtin_convertvector(x0, name##_sum_vec);                              \
+        total1 += __builtin_convertvector(x1, name##_sum_vec);                              \
+    }                                                                                       \
+    total0 += total1;                                                                       \
+    SUM_T total = 0;                                                                        \
+    for (size_t lane = 0; lane < LANES; lane++){                                            \
+        total += total0[lane];                                                              \
+    }                                                                                       \
+    for (; i < size; i++){                                                                  \
+        total += elements[i];                                                               \
+    }                                                                                       \
+    return (double)total;                                                                   \
+}                                                                                           \
+                                                                                            \
+ATTR static double name##_squares(const void* data, size_t size, double mean){              \
+    enum { LANES = BYTES / sizeof(T) };                                                     \
+    const T* elements = data;                                                               \
+    name##_dev_vec center = (name##_dev_vec){0} + mean;                                     \
+    name##_dev_vec total0 = {0}, total1 = {0};                                              \
+    size_t i = 0;                                                                           \
+    for (; i + 2*LANES <= size; i += 2*LANES){                                              \
+        name##_vec x0, x1;                                                                  \
+        memcpy(&x0, elements + i, sizeof(x0));                                              \
+        memcpy(&x1, elements + i + LANES, sizeof(x1));                                      \
+        name##_dev_vec d0 = __builtin_convertvector(x0, name##_dev_vec) - center;           \
+        name##_dev_vec d1 = __builtin_convertvector(x1, name##_dev_vec) - center;           \
+        total0 += d0*d0;                                                                    \
+        total1 += d1*d1;                                                                    \
+    }                                                                                       \
+    total0 += total1;                                                                       \
+    double total = 0;                                                                       \
+    for (size_t lane = 0; lane < LANES; lane++){                                            \
+        total += total0[lane];                                                              \
+    }                                                                                       \
+    for (; i < size; i++){                                                                  \
+        double distance = (double)elements[i] - mean;                                       \
+        total += distance*distance;                                                         \
+    }                                                                                       \
+    return total;                                                                           \
+}                                                                                           \
+                                                                                            \
+ATTR static void name##_min(const void* data, size_t size, void* store_value){              \
+    enum { LANES = BYTES / sizeof(T) };                                                     \
+    const T* elements = data;                                                               \
+    name##_vec best = (name##_vec){0} + (T)(HIGH);                                          \
+    size_t i = 0;                                                                           \
+    for (; i + LANES <= size; i += LANES){                                                  \
+        name##_vec x;                                                                       \
+        memcpy(&x, elements + i, sizeof(x));                                                \
+        __typeof__(x < best) smaller = x < best;                                            \
+        best = (name##_vec)(((__typeof__(smaller))x & smaller) | ((__typeof__(smaller))best & ~smaller)); \
+    }                                                                                       \
+    T result = (T)(HIGH);                                                                   \
+    for (size_t lane = 0; lane < LANES; lane++){                                            \
+        result = best[lane] < result ? best[lane] : result;                                 \
+    }                                                                                       \
+    for (; i < size; i++){                                                                  \
+        result = elements[i] < result ? elements[i] : result;                               \
+    }                                                                                       \
+    memcpy(store_value, &result, sizeof(result));                                          \
+}                                                                                           \
+                                                                                            \
+ATTR static void name##_max(const void* data, size_t size, void* store_value){              \
+    enum { LANES = BYTES / sizeof(T) };                                                     \
+    const T* elements = data;                                                               \
+    name##_vec best = (name##_vec){0} + (T)(LOW);                                           \
+    size_t i = 0;                                                                           \
+    for (; i + LANES <= size; i += LANES){                                                  \
+        name##_vec x;                                                                       \
+        memcpy(&x, elements + i, sizeof(x));                                                \
+        __typeof__(x > best) bigger = x > best;                                             \
+        best = (name##_vec)(((__typeof__(bigger))x & bigger) | ((__typeof__(bigger))best & ~bigger)); \
+    }                                                                                       \
+    T result = (T)(LOW);                                                                    \
+    for (size_t lane = 0; lane < LANES; lane++){                                            \
+        result = best[lane] > result ? best[lane] : result;                                 \
+    }                                                                                       \
+    for (; i < size; i++){                                                                  \
+        result = elements[i] > result ? elements[i] : result;                               \
+    }                                                                                       \
+    memcpy(store_value, &result, sizeof(result));                                           \
+}
+
+#define BASELINE
+DEFINE_REDUCE_KERNELS(BASELINE, int, int64_t, INT_MIN, INT_MAX, i32, 16)
+DEFINE_REDUCE_KERNELS(BASELINE, int8_t, int64_t, INT8_MIN, INT8_MAX, i8, 16)
+DEFINE_REDUCE_KERNELS(BASELINE, int16_t, int64_t, INT16_MIN, INT16_MAX, i16, 16)
+DEFINE_REDUCE_KERNELS(BASELINE, int64_t, double, INT64_MIN, INT64_MAX, i64, 16)
+DEFINE_REDUCE_KERNELS(BASELINE, uint8_t, int64_t, 0, UINT8_MAX, u8, 16)
+DEFINE_REDUCE_KERNELS(BASELINE, uint16_t, int64_t, 0, UINT16_MAX, u16, 16)
+DEFINE_REDUCE_KERNELS(BASELINE, uint32_t, int64_t, 0, UINT32_MAX, u32, 16)
+DEFINE_REDUCE_KERNELS(BASELINE, uint64_t, double, 0, UINT64_MAX, u64, 16)
+DEFINE_REDUCE_KERNELS(BASELINE, float, double, -INFINITY, INFINITY, f32, 16)
+DEFINE_REDUCE_KERNELS(BASELINE, double, double, -INFINITY, INFINITY, f64, 16)
+
+#if DARRAY_REDUCE_X86
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+DEFINE_REDUCE_KERNELS(AVX2, int, int64_t, INT_MIN, INT_MAX, i32_avx2, 32)
+DEFINE_REDUCE_KERNELS(AVX2, float, double, -INFINITY, INFINITY, f32_avx2, 32)
+DEFINE_REDUCE_KERNELS(AVX2, double, double, -INFINITY, INFINITY, f64_avx2, 32)
+DEFINE_REDUCE_KERNELS(AVX512, int, int64_t, INT_MIN, INT_MAX, i32_avx512, 64)
+DEFINE_REDUCE_KERNELS(AVX512, float, double, -INFINITY, INFINITY, f32_avx512, 64)
+DEFINE_REDUCE_KERNELS(AVX512, double, double, -INFINITY, INFINITY, f64_avx512, 64)
+#endif
+
+/**
+ * @brief The kernels in use, indexed by var_types, upgraded by reduce_dispatch() at startup
+ */
+static struct {
+    sum_kernel sum;
+    squares_kernel squares;
+    extreme_kernel min;
+    extreme_kernel max;
+} kernels[] = {
+    [INT]    = {i32_sum, i32_squares, i32_min, i32_max},
+    [FLOAT]  = {f32_sum, f32_squares, f32_min, f32_max},
+    [DOUBLE] = {f64_sum, f64_squares, f64_min, f64_max},
+    [INT8]   = {i8_sum, i8_squares, i8_min, i8_max},
+    [INT16]  = {i16_sum, i16_squares, i16_min, i16_max},
+    [INT64]  = {i64_sum, i64_squares, i64_min, i64_max},
+    [UINT8]  = {u8_sum, u8_squares, u8_min, u8_max},
+    [UINT16] = {u16_sum, u16_squares, u16_min, u16_max},
+    [UINT32] = {u32_sum, u32_squares, u32_min, u32_max},
+    [UINT64] = {u64_sum, u64_squares, u64_min, u64_max},
+};
+
+#if DARRAY_REDUCE_X86
+__attribute__((constructor)) static void reduce_dispatch(void){
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")){
+        kernels[INT].sum = i32_avx512_sum;       kernels[INT].squares = i32_avx512_squares;
+        kernels[INT].min = i32_avx512_min;       kernels[INT].max = i32_avx512_max;
+        kernels[FLOAT].sum = f32_avx512_sum;     kernels[FLOAT].squares = f32_avx512_squares;
+        kernels[FLOAT].min = f32_avx512_min;     kernels[FLOAT].max = f32_avx512_max;
+        kernels[DOUBLE].sum = f64_avx512_sum;    kernels[DOUBLE].squares = f64_avx512_squares;
+        kernels[DOUBLE].min = f64_avx512_min;    kernels[DOUBLE].max = f64_avx512_max;
+    } else if (__builtin_cpu_supports("avx2")){
+        kernels[INT].sum = i32_avx2_sum;         kernels[INT].squares = i32_avx2_squares;
+        kernels[INT].min = i32_avx2_min;         kernels[INT].max = i32_avx2_max;
+        kernels[FLOAT].sum = f32_avx2_sum;       kernels[FLOAT].squares = f32_avx2_squares;
+        kernels[FLOAT].min = f32_avx2_min;       kernels[FLOAT].max = f32_avx2_max;
+        kernels[DOUBLE].sum = f64_avx2_sum;      kernels[DOUBLE].squares = f64_avx2_squares;
+        kernels[DOUBLE].min = f64_avx2_min;      kernels[DOUBLE].max = f64_avx2_max;
+    }
+}
+#endif
+
+static unsigned reduce_threads = 1; ///< @see array_set_reduce_threads()
+
+/**
+ * @brief Sets how many threads the reductions may use on big arrays
+ * Each thread gets at least 262144 elements, smaller arrays always use one thread.
+ * The result of a sum depends on how the array is split, so it may change in the last
+ * bits with the number of threads (it never changes between runs with the same setting).
+ * Not thread-safe, set it once at startup.
+ *
+ * @param[in] threads How many threads, 0 for one per online CPU, 1 (the default) for no threads
+ */
+void array_set_reduce_threads(unsigned threads){
+    reduce_threads = threads;
+}
+
+typedef enum {REDUCE_SUM, REDUCE_SQUARES, REDUCE_MIN, REDUCE_MAX} reduce_op;
+
+/**
+ * @brief One thread's share of a reduction
+ */
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    var_types type;
+    reduce_op op;
+    double mean;            ///< For REDUCE_SQUARES
+    double result;          ///< For REDUCE_SUM and REDUCE_SQUARES
+    unsigned char value[8]; ///< For REDUCE_MIN and REDUCE_MAX, one element
+} reduce_task;
+
+/**
+ * @brief Pairwise sum of the kernel results over blocks of PAIRWISE_BLOCK elements
+ */
+static double pairwise(const unsigned char* data, size_t size, var_types type, reduce_op op, double mean){
+    if (size <= PAIRWISE_BLOCK){
+        return op == REDUCE_SUM ? kernels[type].sum(data, size) : kernels[type].squares(data, size, mean);
+    }
+    size_t half = (size/2 + PAIRWISE_BLOCK - 1) / PAIRWISE_BLOCK * PAIRWISE_BLOCK;
+    size_t type_size = darray_type_size(type);
+    return pairwise(data, half, type, op, mean) + pairwise(data + half*type_size, size - half, type, op, mean);
+}
+
+static void* reduce_worker(void* argument){
+    reduce_task* task = argument;
+    switch(task->op){
+        case REDUCE_SUM:
+        case REDUCE_SQUARES:
+            task->result = pairwise(task->data, task->size, task->type, task->op, task->mean);
+            break;
+        case REDUCE_MIN:
+            kernels[task->type].min(task->data, task->size, task->value);
+            break;
+        case REDUCE_MAX:
+            kernels[task->type].max(task->data, task->size, task->value);
+            break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Checks if first < second, for comparing the per-thread minimums and maximums
+ */
+static bool element_less(const unsigned char* first, const unsigned char* second, var_types type){
+#define ELEMENT_LESS_CASE(TYPE, T, K, name) \
+        case TYPE: {T a, b; memcpy(&a, first, sizeof(a)); memcpy(&b, second, sizeof(b)); return a < b;}
+    switch(type){
+        DARRAY_FOR_EACH_INTEGER(ELEMENT_LESS_CASE)
+        case FLOAT: {float a, b; memcpy(&a, first, sizeof(a)); memcpy(&b, second, sizeof(b)); return a < b;}
+        case DOUBLE: {double a, b; memcpy(&a, first, sizeof(a)); memcpy(&b, second, sizeof(b)); return a < b;}
+        case CUSTOM: break;
+    }
+    return false;
+}
+
+/**
+ * @brief Runs a reduction over size elements, split among the threads set by array_set_reduce_threads()
+ *
+ * @param[out] store_value For REDUCE_MIN and REDUCE_MAX, receives the element
+ * @return For REDUCE_SUM and REDUCE_SQUARES, the sum
+ */
+static double reduce(const void* data, size_t size, var_types type, reduce_op op, double mean, void* store_value){
+    unsigned threads = reduce_threads == 1 ? 1 : darray_thread_count(reduce_threads);
+    if (threads > size / DARRAY_REDUCE_MIN_SLICE){
+        threads = (unsigned)(size / DARRAY_REDUCE_MIN_SLICE);
+    }
+    if (threads < 1){
+        threads = 1;
+    }
+    size_t type_size = darray_type_size(type);
+    reduce_task tasks[DARRAY_MAX_THREADS];
+    for (unsigned t = 0; t < threads; t++){
+        size_t begin = size*t/threads, end = size*(t + 1)/threads;
+        tasks[t] = (reduce_task){(const unsigned char*)data + begin*type_size, end - begin, type, op, mean, 0, {0}};
+    }
+    if (threads == 1){
+        reduce_worker(&tasks[0]);
+    } else {
+        darray_run_tasks(reduce_worker, tasks, sizeof(reduce_task), threads);
+    }
+
+    double total = 0;
+    unsigned best = 0;
+    for (unsigned t = 0; t < threads; t++){
+        total += tasks[t].result;
+        if ((op == REDUCE_MIN && element_less(tasks[t].value, tasks[best].value, type)) ||
+            (op == REDUCE_MAX && element_less(tasks[best].value, tasks[t].value, type))){
+            best = t;
+        }
+    }
+    if (store_value){
+        memcpy(store_value, tasks[best].value, type_size);
+    }
+    return total;
+}
+
+/**
+ * @brief Checks the arguments shared by every reduction
+ */
+static bool reduce_valid(const dArray* array, const void* store, bool allow_empty){
+    if (!array){
+        darray_report(array, DARRAY_ERR_NULL, "The array does not exist!");
+        return false;
+    }
+    if (!store){
+        darray_report(array, DARRAY_ERR_INVALID_ARGUMENT, "Invalid output pointer!");
+        return false;
+    }
+    if (array_get_type(array) == CUSTOM){
+        darray_report(array, DARRAY_ERR_UNSUPPORTED, "CUSTOM arrays have no reductions!");
+        return false;
+    }
+    if (!allow_empty && array_get_size(array) == 0){
+        darray_report(array, DARRAY_ERR_EMPTY, "The array is empty!");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the smallest or biggest element, skipping NaNs
+ * An array of NaNs only gives NaN, at index 0.
+ */
+static void extreme(const dArray* array, reduce_op op, void* store_value, size_t* store_index){
+    var_types type = array_get_type(array);
+    size_t size = array_get_size(array);
+    const void* data = array_data_const(array);
+    unsigned char value[8];
+    reduce(data, size, type, op, 0, value);
+    size_t index = darray_simd_find(data, size, value, type);
+    if (index == size){
+        ///< The starting value of the kernels survived: nothing but NaNs
+        index = 0;
+        memcpy(value, data, darray_type_size(type));
+    }
+    if (store_value){
+        memcpy(store_value, value, darray_type_size(type));
+    }
+    if (store_index){
+        *store_index = index;
+    }
+}
+
+/**
+ * @brief Sum of all elements, pairwise for accuracy
+ * Sums of integers up to 32 bits are exact as long as they stay below 2^53.
+ *
+ * @param[in]  array     The target array
+ * @param[out] store_sum Receives the sum, 0 for an empty array
+ * @return True if success, false if the array does not exist
+ */
+bool array_sum(const dArray* array, double* store_sum){
+    if (!reduce_valid(array, store_sum, true)){
+        return false;
+    }
+    *store_sum = reduce(array_data_const(array), array_get_size(array), array_get_type(array), REDUCE_SUM, 0, NULL);
+    return true;
+}
+
+/**
+ * @brief Smallest element, NaNs are skipped
+ *
+ * @param[in]  array       The target array
+ * @param[out] store_value Receives the element, of the array type
+ * @return True if success, false if the array does not exist or is empty
+ */
+bool array_min(const dArray* array, void* store_value){
+    if (!reduce_valid(array, store_value, false)){
+        return false;
+    }
+    extreme(array, REDUCE_MIN, store_value, NULL);
+    return true;
+}
+
+/**
+ * @brief Biggest element, NaNs are skipped, @see array_min()
+ */
+bool array_max(const dArray* array, void* store_value){
+    if (!reduce_valid(array, store_value, false)){
+        return false;
+    }
+    extreme(array, REDUCE_MAX, store_value, NULL);
+    return true;
+}
+
+/**
+ * @brief Index of the first smallest element, NaNs are skipped
+ *
+ * @param[in]  array       The target array
+ * @param[out] store_index Receives the index
+ * @return True if success, false if the array does not exist or is empty
+ */
+bool array_argmin(const dArray* array, size_t* store_index){
+    if (!reduce_valid(array, store_index, false)){
+        return false;
+    }
+    extreme(array, REDUCE_MIN, NULL, store_index);
+    return true;
+}
+
+/**
+ * @brief Index of the first biggest element, NaNs are skipped, @see array_argmin()
+ */
+bool array_argmax(const dArray* array, size_t* store_index){
+    if (!reduce_valid(array, store_index, false)){
+        return false;
+    }
+    extreme(array, REDUCE_MAX, NULL, store_index);
+    return true;
+}
+
+/**
+ * @brief Arithmetic mean of the elements
+ *
+ * @param[in]  array      The target array
+ * @param[out] store_mean Receives the mean
+ * @return True if success, false if the array does not exist or is empty
+ */
+bool array_mean(const dArray* array, double* store_mean){
+    if (!reduce_valid(array, store_mean, false)){
+        return false;
+    }
+    double sum = reduce(array_data_const(array), array_get_size(array), array_get_type(array), REDUCE_SUM, 0, NULL);
+    *store_mean = sum / (double)array_get_size(array);
+    return true;
+}
+
+/**
+ * @brief Population variance of the elements (divided by n), in two passes
+ * For the sample variance multiply by n / (n - 1).
+ *
+ * @param[in]  array          The target array
+ * @param[out] store_variance Receives the variance
+ * @return True if success, false if the array does not exist or is empty
+ */
+bool array_variance(const dArray* array, double* store_variance){
+    double mean;
+    if (!array_mean(array, &mean) || !reduce_valid(array, store_variance, false)){
+        return false;
+    }
+    double squares = reduce(array_data_const(array), array_get_size(array), array_get_type(array), REDUCE_SQUARES, mean, NULL);
+    *store_variance = squares / (double)array_get_size(array);
+    return true;
+}
@@ -0,0 +1,249 @@
+/**
+ * @file darray_search.c
+ * @brief Read-only search index for sorted arrays
+ *
+ * array_binary_search() jumps all over the array, and on big arrays almost every
+ * step is a cache miss. The index built here stores a copy of the elements in
+ * Eytzinger order (the layout of a binary heap: the children of k are 2k and 2k+1),
+ * so the first levels of every search share the same few cache lines, the descent
+ * has no branches and the next levels can be prefetched ahead of time.
+ *
+ * The index is a snapshot: changes made to the array after building it are not seen.
+ */
+
+#include "darray.h"
+#include "darray_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CACHE_LINE 64
+#define BATCH_SIZE 16 ///< How many searches array_search_many() runs interleaved
+
+/**
+ * @brief The search index, @see array_search_index_new()
+ */
+struct darray_search_index {
+    void* keys;     ///< size+1 elements in Eytzinger order, keys[0] is unused
+    size_t* ranks;  ///< ranks[k] is the index in the sorted array of keys[k]
+    size_t size;    ///< How many elements were indexed
+    var_types type; ///< The variable type of the keys
+};
+
+/**
+ * @brief Generates the Eytzinger functions for the element type T
+ *
+ * - name_indexable():    Checks the order and tells how many elements go to the index (the NaN tail is left out)
+ * - name_fill():         Copies the sorted elements in Eytzinger order, by an in-order walk of the implicit tree
+ * - name_lower_bound():  Eytzinger position of the first key not smaller than value, 0 if there is none
+ * - name_search_batch(): Runs count searches level by level, so their cache misses overlap
+ */
+#define DEFINE_EYTZINGER(T, name)                                                           \
+static bool name##_indexable(const T* data, size_t size, size_t* store_size){               \
+    while (size > 0 && data[size-1] != data[size-1]){                                       \
+        size--;                                                                             \
+    }                                                                                       \
+    for (size_t i = 1; i < size; i++){                                                      \
+        if (!(data[i-1] <= data[i])){                                                       \
+            return false;                                                                   \
+        }                                                                                   \
+    }                                                                                       \
+    *store_size = size;                                                                     \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+static size_t name##_fill(const T* sorted, size_t next, T* keys, size_t* ranks, size_t k, size_t size){ \
+    if (k <= size){                                                                         \
+        next = name##_fill(sorted, next, keys, ranks, 2*k, size);                           \
+        keys[k] = sorted[next];                                                             \
+        ranks[k] = next++;                                                                  \
+        next = name##_fill(sorted, next, keys, ranks, 2*k + 1, size);                       \
+    }                                                                                       \
+    return next;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline size_t name##_lower_bound(const T* keys, size_t size, T value){               \
+    size_t k = 1;                                                                           \
+    while (k <= size){                                                                      \
+        /* The descendants of k a few levels down are contiguous, fetch their line early */ \
+        __builtin_prefetch(keys + k*(CACHE_LINE/sizeof(T)));                                \
+        k = 2*k + (keys[k] < value);                                                        \
+    }                                                                                       \
+    /* Undo the right turns taken after the last left turn */                               \
+    return k >> __builtin_ffsll((long long)~k);                                             \
+}                                                                                           \
+                                                                                            \
+static size_t name##_search_batch(const struct darray_search_index* index, const T* values, size_t count, size_t* store_indices){ \
+    const T* keys = index->keys;                                                            \
+    size_t k[BATCH_SIZE];                                                                   \
+    for (size_t i = 0; i < count; i++){                                                     \
+        k[i] = 1;                                                                           \
+    }                                                                                       \
+    bool active = true;                                                                     \
+    while (active){                                                                         \
+        active = false;                                                                     \
+        for (size_t i = 0; i < count; i++){                                                 \
+            if (k[i] <= index->size){                                                       \
+                __builtin_prefetch(keys + k[i]*(CACHE_LINE/sizeof(T)));                     \
+                k[i] = 2*k[i] + (keys[k[i]] < values[i]);                                   \
+                active = true;                                                              \
+            }                                                                               \
+        }                                                                                   \
+    }                                                                                       \
+    size_t found = 0;                                                                       \
+    for (size_t i = 0; i < count; i++){                                                     \
+        size_t position = k[i] >> __builtin_ffsll((long long)~k[i]);                        \
+        if (position != 0 && keys[position] == values[i]){                                  \
+            store_indices[i] = index->ranks[position];                                      \
+            found++;                                                                        \
+        } else {                                                                            \
+            store_indices[i] = DARRAY_NOT_FOUND;                                            \
+        }                                                                                   \
+    }                                                                                       \
+    return found;                                                                           \
+}
+
+#define DEFINE_INTEGER_EYTZINGER(TYPE, T, K, name) DEFINE_EYTZINGER(T, name)
+DARRAY_FOR_EACH_INTEGER(DEFINE_INTEGER_EYTZINGER)
+DEFINE_EYTZINGER(float, float)
+DEFINE_EYTZINGER(double, double)
+
+/**
+ * @brief Builds a search index from a sorted array
+ * @note FLOAT and DOUBLE NaNs at the end of the array are left out, they are never equal to any key.
+ *
+ * @param[in] array The sorted array, @see array_sort()
+ * @return The new index, NULL if the array is not sorted, is CUSTOM or memory allocation fail
+ */
+darray_search_index* array_search_index_new(const dArray* array){
+    var_types type = array_get_type(array);
+    size_t size = array_get_size(array);
+    const void* data = array_data_const(array);
+    size_t type_size = array_get_element_size(array);
+    if (type == CUSTOM){
+        darray_report(array, DARRAY_ERR_UNSUPPORTED, "CUSTOM arrays can not have a search index!");
+        return NULL;
+    }
+
+    bool sorted = false;
+#define INDEXABLE_CASE(TYPE, T, K, name) case TYPE: sorted = name##_indexable(data, size, &size); break;
+    switch(type){
+        DARRAY_FOR_EACH_INTEGER(INDEXABLE_CASE)
+        case FLOAT: sorted = float_indexable(data, size, &size); break;
+        case DOUBLE: sorted = double_indexable(data, size, &size); break;
+        case CUSTOM: break;
+    }
+    if (!sorted){
+        darray_report(array, DARRAY_ERR_STATE, "The array must be sorted to build a search index!");
+        return NULL;
+    }
+
+    darray_search_index* index = malloc(sizeof(darray_search_index));
+    if (!index){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory!");
+        return NULL;
+    }
+    ///< Keys start at a cache line boundary, so each node's descendants share lines
+    size_t keys_bytes = ((size + 1)*type_size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    index->keys = aligned_alloc(CACHE_LINE, keys_bytes);
+    index->ranks = malloc((size + 1)*sizeof(size_t));
+    if (!index->keys || !index->ranks){
+        darray_report(array, DARRAY_ERR_NO_MEMORY, "Failed to allocate memory for the search index!");
+        free(index->keys);
+        free(index->ranks);
+        free(index);
+        return NULL;
+    }
+    index->size = size;
+    index->type = type;
+
+#define FILL_CASE(TYPE, T, K, name) case TYPE: name##_fill(data, 0, index->keys, index->ranks, 1, size); break;
+    switch(type){
+        DARRAY_FOR_EACH_INTEGER(FILL_CASE)
+        case FLOAT: float_fill(data, 0, index->keys, index->ranks, 1, size); break;
+        case DOUBLE: double_fill(data, 0, index->keys, index->ranks, 1, size); break;
+        case CUSTOM: break;
+    }
+    return index;
+}
+
+/**
+ * @brief Destroys a search index
+ *
+ * @param[in,out] index The target index, set to NULL after
+ * @return True if success, false if the index does not exist
+ */
+bool array_search_index_delete(darray_search_index** index){
+    if (!index || !*index){
+        darray_report(NULL, DARRAY_ERR_NULL, "The search index does not exist!");
+        return false;
+    }
+    free((*index)->keys);
+    free((*index)->ranks);
+    free(*index);
+    *index = NULL;
+    return true;
+}
+
+/**
+ * @brief Searches one key in the index
+ *
+ * @param[in]  index       The search index
+ * @param[in]  key         Pointer to the key, of the array type
+ * @param[out] store_index The index of the first occurrence in the sorted array
+ * @return True if found, false if not found
+ */
+bool array_search_index_find(const darray_search_index* index, const void* key, size_t* store_index){
+    size_t position = 0;
+#define FIND_CASE(TYPE, T, K, name)                                                         \
+        case TYPE:                                                                          \
+            position = name##_lower_bound(index->keys, index->size, *(const T*)key);        \
+            if (position == 0 || ((const T*)index->keys)[position] != *(const T*)key){return false;} \
+            break;
+    switch(index->type){
+        DARRAY_FOR_EACH_INTEGER(FIND_CASE)
+        case FLOAT:
+            position = float_lower_bound(index->keys, index->size, *(const float*)key);
+            if (position == 0 || ((const float*)index->keys)[position] != *(const float*)key){return false;}
+            break;
+        case DOUBLE:
+            position = double_lower_bound(index->keys, index->size, *(const double*)key);
+            if (position == 0 || ((const double*)index->keys)[position] != *(const double*)key){return false;}
+            break;
+        case CUSTOM:
+            return false;
+    }
+    *store_index = index->ranks[position];
+    return true;
+}
+
+/**
+ * @brief Searches many keys at once, overlapping the memory latency of the searches
+ *
+ * @param[in]  index       The search index
+ * @param[in]  keys        count keys, of the array type
+ * @param[in]  count       How many keys
+ * @param[out] out_indices For each key, the index of its first occurrence in the sorted array or DARRAY_NOT_FOUND
+ * @return How many keys were found
+ */
+size_t array_search_many(const darray_search_index* index, const void* keys, size_t count, size_t* out_indices){
+    size_t found = 0;
+    for (size_t i = 0; i < count; i += BATCH_SIZE){
+        size_t batch = count - i < BATCH_SIZE ? count - i : BATCH_SIZE;
+#define SEARCH_BATCH_CASE(TYPE, T, K, name) \
+            case TYPE: found += name##_search_batch(index, (const T*)keys + i, batch, out_indices + i); break;
+        switch(index->type){
+            DARRAY_FOR_EACH_INTEGER(SEARCH_BATCH_CASE)
+            case FLOAT:
+                found += float_search_batch(index, (const float*)keys + i, batch, out_indices + i);
+                break;
+            case DOUBLE:
+                found += double_search_batch(index, (const double*)keys + i, batch, out_indices + i);
+                break;
+            case CUSTOM:
+                break;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,262 @@
+/**
+ * @file darray_simd.c
+ * @brief Vectorized equality search behind array_find(), array_count() and friends
+ *
+ * Every kernel exists in a scalar version and, on x86, in SSE2, AVX2 and AVX-512
+ * versions. The best one the CPU supports is picked once at startup through CPUID,
+ * so the caller pays a single indirect call per search, never per element.
+ *
+ * Equality follows the C == operator: for FLOAT and DOUBLE, NaN never matches
+ * anything and -0.0 matches +0.0. Integer equality does not care about the sign, so
+ * the integer types share one set of kernels per width. The 8 and 16 bit kernels
+ * stop at SSE2, wider vectors would need more than 64 mask bits per find step.
+ * CUSTOM elements are searched by darray.c, not here.
+ */
+
+#include "darray_internal.h"
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DARRAY_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define DARRAY_SIMD_X86 0
+#endif
+
+_Static_assert(sizeof(int) == sizeof(int32_t), "INT kernels assume a 32 bit int");
+
+typedef size_t (*find_kernel)(const void* data, size_t size, const void* value);
+typedef size_t (*count_kernel)(const void* data, size_t size, const void* value);
+
+/**
+ * @brief Generates the scalar kernels, the fallback for every CPU
+ * The count loop has no early exit, so the compiler is able to auto-vectorize it.
+ */
+#define DEFINE_SCALAR_KERNELS(T, name)                                                      \
+static size_t name##_find_scalar(const void* data, size_t size, const void* value){         \
+    const T* elements = data;                                                               \
+    T needle = *(const T*)value;                                                            \
+    for (size_t i = 0; i < size; i++){                                                      \
+        if (elements[i] == needle){                                                         \
+            return i;                                                                       \
+        }                                                                                   \
+    }                                                                                       \
+    return size;                                                                            \
+}                                                                                           \
+                                                                                            \
+static size_t name##_count_scalar(const void* data, size_t size, const void* value){        \
+    const T* elements = data;                                                               \
+    T needle = *(const T*)value;                                                            \
+    size_t count = 0;                                                                       \
+    for (size_t i = 0; i < size; i++){                                                      \
+        count += elements[i] == needle;                                                     \
+    }                                                                                       \
+    return count;                                                                           \
+}
+
+DEFINE_SCALAR_KERNELS(uint8_t, i8)
+DEFINE_SCALAR_KERNELS(uint16_t, i16)
+DEFINE_SCALAR_KERNELS(int32_t, i32)
+DEFINE_SCALAR_KERNELS(uint64_t, i64)
+DEFINE_SCALAR_KERNELS(float, f32)
+DEFINE_SCALAR_KERNELS(double, f64)
+
+#if DARRAY_SIMD_X86
+
+/**
+ * @brief Generates the vector kernels for one instruction set
+ * MASK(vector, needle) must return one bit per lane, set where the lane is equal.
+ * The find loop checks 4 vectors per iteration and only branches once for all of them.
+ *
+ * @param ATTR  The target attribute that enables the instruction set for these functions
+ * @param LANES How many elements fit in one vector
+ */
+#define DEFINE_VECTOR_KERNELS(ATTR, T, name, LANES, VEC, SET1, LOAD, MASK)                  \
+ATTR static size_t name##_find(const void* data, size_t size, const void* value){           \
+    const T* elements = data;                                                               \
+    T needle_value = *(const T*)value;                                                      \
+    VEC needle = SET1(needle_value);                                                        \
+    size_t i = 0;                                                                           \
+    for (; i + 4*LANES <= size; i += 4*LANES){                                              \
+        uint64_t mask = (uint64_t)MASK(LOAD(elements + i), needle)                          \
+                      | (uint64_t)MASK(LOAD(elements + i + LANES), needle) << LANES         \
+                      | (uint64_t)MASK(LOAD(elements + i + 2*LANES), needle) << (2*LANES)   \
+                      | (uint64_t)MASK(LOAD(elements + i + 3*LANES), needle) << (3*LANES);  \
+        if (mask){                                                                          \
+            return i + (size_t)__builtin_ctzll(mask);                                       \
+        }                                                                                   \
+    }                                                                                       \
+    for (; i + LANES <= size; i += LANES){                                                  \
+        uint64_t mask = (uint64_t)MASK(LOAD(elements + i), needle);                         \
+        if (mask){                                                                          \
+            return i + (size_t)__builtin_ctzll(mask);                                       \
+        }                                                                                   \
+    }                                                                                       \
+    for (; i < size; i++){                                                                  \
+        if (elements[i] == needle_value){                                                   \
+            return i;                                                                       \
+        }                                                                                   \
+    }                                                                                       \
+    return size;                                                                            \
+}                                                                                           \
+                                                                                            \
+ATTR static size_t name##_count(const void* data, size_t size, const void* value){          \
+    const T* elements = data;                                                               \
+    T needle_value = *(const T*)value;                                                      \
+    VEC needle = SET1(needle_value);                                                        \
+    size_t count = 0, i = 0;                                                                \
+    for (; i + LANES <= size; i += LANES){                                                  \
+        count += (size_t)__builtin_popcountll((uint64_t)MASK(LOAD(elements + i), needle));   \
+    }                                                                                       \
+    for (; i < size; i++){                                                                  \
+        count += elements[i] == needle_value;                                               \
+    }                                                                                       \
+    return count;                                                                           \
+}
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+
+#define SSE2_LOAD_I(p)      _mm_loadu_si128((const __m128i*)(p))
+#define SSE2_MASK_I8(x, n)  _mm_movemask_epi8(_mm_cmpeq_epi8((x), (n)))
+#define SSE2_MASK_I16(x, n) _mm_movemask_epi8(_mm_packs_epi16(_mm_cmpeq_epi16((x), (n)), _mm_setzero_si128()))
+#define SSE2_MASK_I32(x, n) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32((x), (n))))
+#define SSE2_MASK_I64(x, n) sse2_mask_i64((x), (n))
+#define SSE2_MASK_F32(x, n) _mm_movemask_ps(_mm_cmpeq_ps((x), (n)))
+#define SSE2_MASK_F64(x, n) _mm_movemask_pd(_mm_cmpeq_pd((x), (n)))
+/**
+ * @brief SSE2 has no 64 bit compare: both 32 bit halves of a lane must be equal
+ */
+SSE2 static inline int sse2_mask_i64(__m128i x, __m128i n){
+    __m128i halves = _mm_cmpeq_epi32(x, n);
+    __m128i both = _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_movemask_pd(_mm_castsi128_pd(both));
+}
+#define SSE2_SET1_I8(v)  _mm_set1_epi8((char)(v))
+#define SSE2_SET1_I16(v) _mm_set1_epi16((short)(v))
+#define SSE2_SET1_I64(v) _mm_set1_epi64x((long long)(v))
+DEFINE_VECTOR_KERNELS(SSE2, uint8_t, i8_sse2, 16, __m128i, SSE2_SET1_I8, SSE2_LOAD_I, SSE2_MASK_I8)
+DEFINE_VECTOR_KERNELS(SSE2, uint16_t, i16_sse2, 8, __m128i, SSE2_SET1_I16, SSE2_LOAD_I, SSE2_MASK_I16)
+DEFINE_VECTOR_KERNELS(SSE2, int32_t, i32_sse2, 4, __m128i, _mm_set1_epi32, SSE2_LOAD_I, SSE2_MASK_I32)
+DEFINE_VECTOR_KERNELS(SSE2, uint64_t, i64_sse2, 2, __m128i, SSE2_SET1_I64, SSE2_LOAD_I, SSE2_MASK_I64)
+DEFINE_VECTOR_KERNELS(SSE2, float, f32_sse2, 4, __m128, _mm_set1_ps, _mm_loadu_ps, SSE2_MASK_F32)
+DEFINE_VECTOR_KERNELS(SSE2, double, f64_sse2, 2, __m128d, _mm_set1_pd, _mm_loadu_pd, SSE2_MASK_F64)
+
+#define AVX2_LOAD_I(p)      _mm256_loadu_si256((const __m256i*)(p))
+#define AVX2_MASK_I32(x, n) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32((x), (n))))
+#define AVX2_MASK_I64(x, n) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64((x), (n))))
+#define AVX2_SET1_I64(v)    _mm256_set1_epi64x((long long)(v))
+#define AVX2_MASK_F32(x, n) _mm256_movemask_ps(_mm256_cmp_ps((x), (n), _CMP_EQ_OQ))
+#define AVX2_MASK_F64(x, n) _mm256_movemask_pd(_mm256_cmp_pd((x), (n), _CMP_EQ_OQ))
+DEFINE_VECTOR_KERNELS(AVX2, int32_t, i32_avx2, 8, __m256i, _mm256_set1_epi32, AVX2_LOAD_I, AVX2_MASK_I32)
+DEFINE_VECTOR_KERNELS(AVX2, uint64_t, i64_avx2, 4, __m256i, AVX2_SET1_I64, AVX2_LOAD_I, AVX2_MASK_I64)
+DEFINE_VECTOR_KERNELS(AVX2, float, f32_avx2, 8, __m256, _mm256_set1_ps, _mm256_loadu_ps, AVX2_MASK_F32)
+DEFINE_VECTOR_KERNELS(AVX2, double, f64_avx2, 4, __m256d, _mm256_set1_pd, _mm256_loadu_pd, AVX2_MASK_F64)
+
+#define AVX512_LOAD_I(p)      _mm512_loadu_si512((const void*)(p))
+#define AVX512_MASK_I32(x, n) _mm512_cmpeq_epi32_mask((x), (n))
+#define AVX512_MASK_I64(x, n) _mm512_cmpeq_epi64_mask((x), (n))
+#define AVX512_SET1_I64(v)    _mm512_set1_epi64((long long)(v))
+#define AVX512_MASK_F32(x, n) _mm512_cmp_ps_mask((x), (n), _CMP_EQ_OQ)
+#define AVX512_MASK_F64(x, n) _mm512_cmp_pd_mask((x), (n), _CMP_EQ_OQ)
+DEFINE_VECTOR_KERNELS(AVX512, int32_t, i32_avx512, 16, __m512i, _mm512_set1_epi32, AVX512_LOAD_I, AVX512_MASK_I32)
+DEFINE_VECTOR_KERNELS(AVX512, uint64_t, i64_avx512, 8, __m512i, AVX512_SET1_I64, AVX512_LOAD_I, AVX512_MASK_I64)
+DEFINE_VECTOR_KERNELS(AVX512, float, f32_avx512, 16, __m512, _mm512_set1_ps, _mm512_loadu_ps, AVX512_MASK_F32)
+DEFINE_VECTOR_KERNELS(AVX512, double, f64_avx512, 8, __m512d, _mm512_set1_pd, _mm512_loadu_pd, AVX512_MASK_F64)
+
+#endif
+
+/**
+ * @brief The kernels in use, indexed by var_types
+ * Starts with the scalar versions, simd_dispatch() upgrades them at startup.
+ */
+static struct {
+    find_kernel find;
+    count_kernel count;
+} kernels[] = {
+    [INT]    = {i32_find_scalar, i32_count_scalar},
+    [FLOAT]  = {f32_find_scalar, f32_count_scalar},
+    [DOUBLE] = {f64_find_scalar, f64_count_scalar},
+    [INT8]   = {i8_find_scalar, i8_count_scalar},
+    [INT16]  = {i16_find_scalar, i16_count_scalar},
+    [INT64]  = {i64_find_scalar, i64_count_scalar},
+    [UINT8]  = {i8_find_scalar, i8_count_scalar},
+    [UINT16] = {i16_find_scalar, i16_count_scalar},
+    [UINT32] = {i32_find_scalar, i32_count_scalar},
+    [UINT64] = {i64_find_scalar, i64_count_scalar},
+    [CUSTOM] = {NULL, NULL},
+};
+
+/**
+ * @brief Installs the kernels of one width for its signed and unsigned types
+ */
+static void simd_set_width(var_types signed_type, var_types unsigned_type, find_kernel find, count_kernel count){
+    kernels[signed_type].find = kernels[unsigned_type].find = find;
+    kernels[signed_type].count = kernels[unsigned_type].count = count;
+}
+
+static const char* simd_level = "scalar";
+
+#if DARRAY_SIMD_X86
+/**
+ * @brief Asks the CPU what it supports and picks the widest kernels available
+ * Runs automatically before main(), thanks to the constructor attribute.
+ */
+__attribute__((constructor)) static void simd_dispatch(void){
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")){
+        simd_set_width(INT8, UINT8, i8_sse2_find, i8_sse2_count);
+        simd_set_width(INT16, UINT16, i16_sse2_find, i16_sse2_count);
+    }
+    if (__builtin_cpu_supports("avx512f")){
+        kernels[INT].find = i32_avx512_find;       kernels[INT].count = i32_avx512_count;
+        kernels[FLOAT].find = f32_avx512_find;     kernels[FLOAT].count = f32_avx512_count;
+        kernels[DOUBLE].find = f64_avx512_find;    kernels[DOUBLE].count = f64_avx512_count;
+        simd_set_width(INT64, UINT64, i64_avx512_find, i64_avx512_count);
+        kernels[UINT32] = kernels[INT];
+        simd_level = "avx512";
+    } else if (__builtin_cpu_supports("avx2")){
+        kernels[INT].find = i32_avx2_find;         kernels[INT].count = i32_avx2_count;
+        kernels[FLOAT].find = f32_avx2_find;       kernels[FLOAT].count = f32_avx2_count;
+        kernels[DOUBLE].find = f64_avx2_find;      kernels[DOUBLE].count = f64_avx2_count;
+        simd_set_width(INT64, UINT64, i64_avx2_find, i64_avx2_count);
+        kernels[UINT32] = kernels[INT];
+        simd_level = "avx2";
+    } else if (__builtin_cpu_supports("sse2")){
+        kernels[INT].find = i32_sse2_find;         kernels[INT].count = i32_sse2_count;
+        kernels[FLOAT].find = f32_sse2_find;       kernels[FLOAT].count = f32_sse2_count;
+        kernels[DOUBLE].find = f64_sse2_find;      kernels[DOUBLE].count = f64_sse2_count;
+        simd_set_width(INT64, UINT64, i64_sse2_find, i64_sse2_count);
+        kernels[UINT32] = kernels[INT];
+        simd_level = "sse2";
+    }
+}
+#endif
+
+/**
+ * @brief Index of the first element equal to value
+ *
+ * @param[in] data  The elements
+ * @param[in] size  How many elements
+ * @param[in] value Pointer to the value, of the same type as the elements
+ * @param[in] type  The variable type of the elements, not CUSTOM
+ * @return The index, or size if there is no match
+ */
+size_t darray_simd_find(const void* data, size_t size, const void* value, var_types type){
+    return kernels[type].find(data, size, value);
+}
+
+/**
+ * @brief How many elements are equal to value, same parameters as darray_simd_find()
+ */
+size_t darray_simd_count(const void* data, size_t size, const void* value, var_types type){
+    return kernels[type].count(data, size, value);
+}
+
+/**
+ * @brief Name of the instruction set picked at startup ("scalar", "sse2", "avx2" or "avx512")
+ */
+const char* array_simd_level(void){
+    return simd_level;
+}
@@ -0,0 +1,524 @@
+/**
+ * @file darray_sort.c
+ * @brief The sort engine behind array_sort() and array_sort_ex()
+ *
+ * Two algorithms live here, both generated per type so the comparisons are
+ * inlined instead of going through a qsort callback:
+ * - LSD radix sort, 8 bits per pass, for big arrays
+ * - Introsort (quicksort + heapsort + insertion sort) for small arrays
+ *
+ * Integer types are generated from DARRAY_FOR_EACH_INTEGER(). CUSTOM elements are
+ * sorted by darray_sort_custom() with their compare callback.
+ *
+ * Selection (introselect) and argsort, the engine of array_nth_element(),
+ * array_partial_sort(), array_top_k() and array_argsort(), follow the same order.
+ *
+ * Sort order for FLOAT and DOUBLE: -0.0 comes before +0.0 and every NaN is moved
+ * to the end, keeping the relative order they had before sorting. Both algorithms
+ * produce exactly the same result.
+ */
+
+#include "darray_internal.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef DARRAY_RADIX_THRESHOLD
+#define DARRAY_RADIX_THRESHOLD 512 ///< Below this many elements array_sort() uses introsort
+#endif
+
+#define INSERTION_THRESHOLD 16 ///< Introsort partitions smaller than this are finished by insertion sort
+
+/**
+ * @brief Generates name_radix_sort() for the element type T with the unsigned key type K
+ * The histograms of every digit are counted in a single pass, and passes where all
+ * the elements share the same digit are skipped. The sort is stable.
+ */
+#define DEFINE_RADIX_SORT(T, K, name, KEY)                                                  \
+static void name##_radix_sort(T* data, T* scratch, size_t size){                            \
+    enum {PASSES = sizeof(K)};                                                              \
+    size_t counts[PASSES][256] = {{0}};                                                     \
+    for (size_t i = 0; i < size; i++){                                                      \
+        K key = KEY(data[i]);                                                               \
+        for (int pass = 0; pass < PASSES; pass++){                                          \
+            counts[pass][(key >> (pass*8)) & 0xFF]++;                                        \
+        }                                                                                   \
+    }                                                                                       \
+    T* source = data;                                                                       \
+    T* destination = scratch;                                                               \
+    for (int pass = 0; pass < PASSES; pass++){                                              \
+        size_t* count = counts[pass];                                                       \
+        if (count[(KEY(source[0]) >> (pass*8)) & 0xFF] == size){                            \
+            continue;                                                                       \
+        }                                                                                   \
+        size_t offset = 0;                                                                  \
+        for (int digit = 0; digit < 256; digit++){                                          \
+            size_t temp = count[digit];                                                     \
+            count[digit] = offset;                                                          \
+            offset += temp;                                                                 \
+        }                                                                                   \
+        for (size_t i = 0; i < size; i++){                                                  \
+            destination[count[(KEY(source[i]) >> (pass*8)) & 0xFF]++] = source[i];          \
+        }                                                                                   \
+        T* temp = source;                                                                   \
+        source = destination;                                                               \
+        destination = temp;                                                                 \
+    }                                                                                       \
+    if (source != data){                                                                    \
+        memcpy(data, source, size*sizeof(T));                                               \
+    }                                                                                       \
+}
+
+/**
+ * @brief Recursion depth after which introsort and introselect give up on quicksort, 2*log2(size)
+ */
+static int introsort_depth_limit(size_t size){
+    int limit = 0;
+    for (size_t n = size; n > 1; n >>= 1){
+        limit += 2;
+    }
+    return limit;
+}
+
+/**
+ * @brief Generates name_introsort() and name_introselect() for the element type T, ordered by LESS
+ * Quicksort with median of three, switching to heapsort when the recursion gets too
+ * deep and to insertion sort on small partitions. Introselect partitions the same way
+ * but only follows the side that holds the wanted position, O(n) on average.
+ */
+#define DEFINE_INTROSORT(T, name, LESS)                                                     \
+static void name##_insertion_sort(T* data, size_t size){                                    \
+    for (size_t i = 1; i < size; i++){                                                      \
+        T value = data[i];                                                                  \
+        size_t j = i;                                                                       \
+        while (j > 0 && LESS(value, data[j-1])){                                            \
+            data[j] = data[j-1];                                                            \
+            j--;                                                                            \
+        }                                                                                   \
+        data[j] = value;                                                                    \
+    }                                                                                       \
+}                                                                                           \
+                                                                                            \
+static void name##_sift_down(T* data, size_t root, size_t size){                            \
+    T value = data[root];                                                                   \
+    while (2*root + 1 < size){                                                              \
+        size_t child = 2*root + 1;                                                          \
+        if (child + 1 < size && LESS(data[child], data[child+1])){                          \
+            child++;                                                                        \
+        }                                                                                   \
+        if (!LESS(value, data[child])){                                                     \
+            break;                                                                          \
+        }                                                                                   \
+        data[root] = data[child];                                                           \
+        root = child;                                                                       \
+    }                                                                                       \
+    data[root] = value;                                                                     \
+}                                                                                           \
+                                                                                            \
+static void name##_heap_sort(T* data, size_t size){                                         \
+    for (size_t i = size/2; i > 0; i--){                                                    \
+        name##_sift_down(data, i-1, size);                                                  \
+    }                                                                                       \
+    for (size_t end = size; end > 1; end--){                                                \
+        T temp = data[0];                                                                   \
+        data[0] = data[end-1];                                                              \
+        data[end-1] = temp;                                                                 \
+        name##_sift_down(data, 0, end-1);                                                   \
+    }                                                                                       \
+}                                                                                           \
+                                                                                            \
+/* Median of three goes to data[1] and becomes the pivot, returns where it ends up */       \
+static size_t name##_partition(T* data, size_t size){                                       \
+    size_t middle = size/2;                                                                 \
+    T temp;                                                                                 \
+    if (LESS(data[middle], data[0])){temp = data[middle]; data[middle] = data[0]; data[0] = temp;} \
+    if (LESS(data[size-1], data[middle])){temp = data[size-1]; data[size-1] = data[middle]; data[middle] = temp;} \
+    if (LESS(data[middle], data[0])){temp = data[middle]; data[middle] = data[0]; data[0] = temp;} \
+    temp = data[middle]; data[middle] = data[1]; data[1] = temp;                            \
+    T pivot = data[1];                                                                      \
+    size_t header = 1, tail = size - 1;                                                     \
+    while (1){                                                                              \
+        do {header++;} while (LESS(data[header], pivot));                                   \
+        do {tail--;} while (LESS(pivot, data[tail]));                                       \
+        if (header >= tail){                                                                \
+            break;                                                                          \
+        }                                                                                   \
+        temp = data[header]; data[header] = data[tail]; data[tail] = temp;                  \
+    }                                                                                       \
+    data[1] = data[tail];                                                                   \
+    data[tail] = pivot;                                                                     \
+    return tail;                                                                            \
+}                                                                                           \
+                                                                                            \
+static void name##_introsort_loop(T* data, size_t size, int depth_limit){                   \
+    while (size > INSERTION_THRESHOLD){                                                     \
+        if (depth_limit-- == 0){                                                            \
+            name##_heap_sort(data, size);                                                   \
+            return;                                                                         \
+        }                                                                                   \
+        size_t tail = name##_partition(data, size);                                         \
+        /* Recurse on the smaller side and loop on the bigger one */                        \
+        if (tail < size - tail - 1){                                                        \
+            name##_introsort_loop(data, tail, depth_limit);                                 \
+            data += tail + 1;                                                               \
+            size -= tail + 1;                                                               \
+        } else {                                                                            \
+            name##_introsort_loop(data + tail + 1, size - tail - 1, depth_limit);           \
+            size = tail;                                                                    \
+        }                                                                                   \
+    }                                                                                       \
+    name##_insertion_sort(data, size);                                                      \
+}                                                                                           \
+                                                                                            \
+static void name##_introsort(T* data, size_t size){                                         \
+    name##_introsort_loop(data, size, introsort_depth_limit(size));                         \
+}                                                                                           \
+                                                                                            \
+/* Quickselect that only keeps the side holding nth, heapsort if it goes too deep */        \
+static void name##_introselect(T* data, size_t size, size_t nth){                           \
+    int limit = introsort_depth_limit(size);                                                \
+    while (size > INSERTION_THRESHOLD){                                                     \
+        if (limit-- == 0){                                                                  \
+            name##_heap_sort(data, size);                                                   \
+            return;                                                                         \
+        }                                                                                   \
+        size_t tail = name##_partition(data, size);                                         \
+        if (nth == tail){                                                                   \
+            return;                                                                         \
+        }                                                                                   \
+        if (nth < tail){                                                                    \
+            size = tail;                                                                    \
+        } else {                                                                            \
+            data += tail + 1;                                                               \
+            size -= tail + 1;                                                               \
+            nth -= tail + 1;                                                                \
+        }                                                                                   \
+    }                                                                                       \
+    name##_insertion_sort(data, size);                                                      \
+}
+
+#define LESS_INTEGER(a, b) ((a) < (b))
+#define LESS_FLOAT(a, b)   (key_float(a) < key_float(b))
+#define LESS_DOUBLE(a, b)  (key_double(a) < key_double(b))
+
+#define DEFINE_INTEGER_SORTS(TYPE, T, K, name) \
+DEFINE_RADIX_SORT(T, K, name, key_##name)      \
+DEFINE_INTROSORT(T, name, LESS_INTEGER)
+DARRAY_FOR_EACH_INTEGER(DEFINE_INTEGER_SORTS)
+DEFINE_RADIX_SORT(float, uint32_t, float, key_float)
+DEFINE_RADIX_SORT(double, uint64_t, double, key_double)
+DEFINE_INTROSORT(float, float, LESS_FLOAT)
+DEFINE_INTROSORT(double, double, LESS_DOUBLE)
+
+/**
+ * @brief Generates name_partition_nans(), a stable partition that moves the NaNs to the end
+ * Introsort is not stable, so the NaNs are taken out of its way first, this keeps
+ * their order exactly the same one the radix sort produces.
+ *
+ * @return How many elements are not NaN (the part that still has to be sorted)
+ */
+#define DEFINE_PARTITION_NANS(T, name)                                                      \
+static size_t name##_partition_nans(T* data, size_t size){                                  \
+    size_t nan_count = 0;                                                                   \
+    for (size_t i = 0; i < size; i++){                                                      \
+        nan_count += data[i] != data[i];                                                    \
+    }                                                                                       \
+    if (nan_count == 0){                                                                    \
+        return size;                                                                        \
+    }                                                                                       \
+    T* nans = malloc(nan_count*sizeof(T));                                                  \
+    size_t kept = 0;                                                                        \
+    if (!nans){                                                                             \
+        /* Out of memory, swapping keeps every value but not the order between NaNs */      \
+        for (size_t i = 0; i < size; i++){                                                  \
+            if (data[i] == data[i]){                                                        \
+                T temp = data[kept];                                                        \
+                data[kept++] = data[i];                                                     \
+                data[i] = temp;                                                             \
+            }                                                                               \
+        }                                                                                   \
+        return kept;                                                                        \
+    }                                                                                       \
+    size_t moved = 0;                                                                       \
+    for (size_t i = 0; i < size; i++){                                                      \
+        if (data[i] == data[i]){                                                            \
+            data[kept++] = data[i];                                                         \
+        } else {                                                                            \
+            nans[moved++] = data[i];                                                        \
+        }                                                                                   \
+    }                                                                                       \
+    memcpy(data + kept, nans, nan_count*sizeof(T));                                         \
+    free(nans);                                                                             \
+    return kept;                                                                            \
+}
+
+DEFINE_PARTITION_NANS(float, float)
+DEFINE_PARTITION_NANS(double, double)
+
+/**
+ * @brief Sorts size elements of the given type in place
+ *
+ * @param[in,out] data      The elements
+ * @param[in]     size      How many elements
+ * @param[in]     type      The variable type of the elements
+ * @param[in]     algorithm Which algorithm to use, DARRAY_SORT_AUTO picks radix sort above DARRAY_RADIX_THRESHOLD
+ * @return True if success, false if the algorithm is not valid
+ */
+bool darray_sort_buffer(void* data, size_t size, var_types type, darray_sort_algo algorithm){
+    if (algorithm != DARRAY_SORT_AUTO && algorithm != DARRAY_SORT_RADIX && algorithm != DARRAY_SORT_INTROSORT){
+        darray_report(NULL, DARRAY_ERR_INVALID_ARGUMENT, "Invalid sort algorithm!");
+        return false;
+    }
+    if (size < 2){
+        return true;
+    }
+    if (algorithm == DARRAY_SORT_AUTO){
+        algorithm = size >= DARRAY_RADIX_THRESHOLD ? DARRAY_SORT_RADIX : DARRAY_SORT_INTROSORT;
+    }
+
+    if (algorithm == DARRAY_SORT_RADIX){
+        void* scratch = malloc(size*darray_type_size(type));
+        if (scratch){
+            darray_sort_scratch(data, scratch, size, type);
+            free(scratch);
+            return true;
+        }
+        ///< Not enough memory for the scratch buffer, introsort works in place
+    }
+    darray_sort_scratch(data, NULL, size, type);
+    return true;
+}
+
+/**
+ * @brief Sorts size elements with a scratch buffer given by the caller, no allocation
+ * Radix sort when there is a scratch buffer, introsort otherwise.
+ * darray_sort_parallel() hands each thread a slice of one shared scratch buffer.
+ *
+ * @param[in,out] data    The elements
+ * @param[in]     scratch Room for size elements, or NULL
+ * @param[in]     size    How many elements
+ * @param[in]     type    The variable type of the elements
+ */
+void darray_sort_scratch(void* data, void* scratch, size_t size, var_types type){
+#define RADIX_CASE(TYPE, T, K, name) case TYPE: name##_radix_sort(data, scratch, size); break;
+#define INTROSORT_CASE(TYPE, T, K, name) case TYPE: name##_introsort(data, size); break;
+    if (scratch){
+        switch(type){
+            DARRAY_FOR_EACH_INTEGER(RADIX_CASE)
+            case FLOAT: float_radix_sort(data, scratch, size); break;
+            case DOUBLE: double_radix_sort(data, scratch, size); break;
+            case CUSTOM: break;
+        }
+        return;
+    }
+    switch(type){
+        DARRAY_FOR_EACH_INTEGER(INTROSORT_CASE)
+        case FLOAT:
+            float_introsort(data, float_partition_nans(data, size));
+            break;
+        case DOUBLE:
+            double_introsort(data, double_partition_nans(data, size));
+            break;
+        case CUSTOM:
+            break;
+    }
+}
+
+/**
+ * @brief Sorts CUSTOM elements with their compare callback
+ * Radix sort needs keys, so CUSTOM elements always go through qsort().
+ *
+ * @param[in,out] data         The elements
+ * @param[in]     size         How many elements
+ * @param[in]     element_size Bytes per element
+ * @param[in]     compare      The order
+ */
+void darray_sort_custom(void* data, size_t size, size_t element_size, darray_compare compare){
+    if (size > 1){
+        qsort(data, size, element_size, compare);
+    }
+}
+
+/**
+ * @brief Moves the element that array_sort() would put at nth to nth, smaller or equal
+ * ones before it and bigger or equal ones after it, in no particular order
+ *
+ * @param[in,out] data The elements
+ * @param[in]     size How many elements
+ * @param[in]     nth  The position to fill, smaller than size
+ * @param[in]     type The variable type of the elements, not CUSTOM
+ */
+void darray_select_buffer(void* data, size_t size, size_t nth, var_types type){
+#define INTROSELECT_CASE(TYPE, T, K, name) case TYPE: name##_introselect(data, size, nth); break;
+    switch(type){
+        DARRAY_FOR_EACH_INTEGER(INTROSELECT_CASE)
+        case FLOAT: float_introselect(data, size, nth); break;
+        case DOUBLE: double_introselect(data, size, nth); break;
+        case CUSTOM: break;
+    }
+}
+
+/**
+ * @brief A sort key with the index of the element it came from, @see darray_argsort_buffer()
+ */
+typedef struct {
+    uint64_t key;
+    size_t index;
+} keyed_index;
+
+#define KEYED_INDEX_KEY(element) ((element).key)
+DEFINE_RADIX_SORT(keyed_index, uint64_t, keyed_index, KEYED_INDEX_KEY)
+
+/**
+ * @brief Generates name_keys(), fills the keyed indices of a buffer of T with KEY
+ */
+#define DEFINE_KEYS(T, name, KEY)                                                           \
+static void name##_keys(const T* data, size_t size, keyed_index* keys){                     \
+    for (size_t i = 0; i < size; i++){                                                      \
+        keys[i].key = KEY(data[i]);                                                         \
+        keys[i].index = i;                                                                  \
+    }                                                                                       \
+}
+
+#define DEFINE_INTEGER_KEYS(TYPE, T, K, name) DEFINE_KEYS(T, name, key_##name)
+DARRAY_FOR_EACH_INTEGER(DEFINE_INTEGER_KEYS)
+DEFINE_KEYS(float, float, key_float)
+DEFINE_KEYS(double, double, key_double)
+
+/**
+ * @brief Stores the indices of the elements in array_sort() order, equal elements by index
+ * The sort keys of every type are widened to 64 bits and radix sorted with their indices,
+ * the passes over the high bytes that narrow types leave at zero are skipped.
+ *
+ * @param[in]  data          The elements
+ * @param[in]  size          How many elements
+ * @param[in]  type          The variable type of the elements, not CUSTOM
+ * @param[out] store_indices Room for size indices
+ * @return True if success, false if memory allocation fail
+ */
+bool darray_argsort_buffer(const void* data, size_t size, var_types type, size_t* store_indices){
+    if (size > SIZE_MAX / (2*sizeof(keyed_index))){
+        return false;
+    }
+    keyed_index* keys = malloc(2*size*sizeof(keyed_index));
+    if (!keys){
+        return false;
+    }
+#define KEYS_CASE(TYPE, T, K, name) case TYPE: name##_keys(data, size, keys); break;
+    switch(type){
+        DARRAY_FOR_EACH_INTEGER(KEYS_CASE)
+        case FLOAT: float_keys(data, size, keys); break;
+        case DOUBLE: double_keys(data, size, keys); break;
+        case CUSTOM: break;
+    }
+    if (size > 1){
+        keyed_index_radix_sort(keys, keys + size, size);
+    }
+    for (size_t i = 0; i < size; i++){
+        store_indices[i] = keys[i].index;
+    }
+    free(keys);
+    return true;
+}
+
+/**
+ * @brief darray_argsort_buffer() for CUSTOM elements, a stable bottom-up merge sort of
+ * the indices with the compare callback
+ *
+ * @param[in]  data          The elements
+ * @param[in]  size          How many elements
+ * @param[in]  element_size  Bytes per element
+ * @param[in]  compare       The order
+ * @param[out] store_indices Room for size indices
+ * @return True if success, false if memory allocation fail
+ */
+bool darray_argsort_custom(const void* data, size_t size, size_t element_size, darray_compare compare, size_t* store_indices){
+    const unsigned char* bytes = data;
+    size_t* scratch = malloc(size*sizeof(size_t));
+    if (!scratch){
+        return size == 0;
+    }
+    size_t* source = store_indices;
+    size_t* target = scratch;
+    for (size_t i = 0; i < size; i++){
+        source[i] = i;
+    }
+    for (size_t width = 1; width < size; width *= 2){
+        for (size_t begin = 0; begin < size; begin += 2*width){
+            size_t middle = size - begin > width ? begin + width : size;
+            size_t end = size - middle > width ? middle + width : size;
+            size_t left = begin, right = middle, out = begin;
+            while (left < middle && right < end){
+                if (compare(bytes + source[right]*element_size, bytes + source[left]*element_size) < 0){
+                    target[out++] = source[right++];
+                } else {
+                    target[out++] = source[left++];
+                }
+            }
+            memcpy(target + out, source + left, (middle - left)*sizeof(size_t));
+            memcpy(target + out + (middle - left), source + right, (end - right)*sizeof(size_t));
+        }
+        size_t* swap = source;
+        source = target;
+        target = swap;
+    }
+    if (source != store_indices){
+        memcpy(store_indices, source, size*sizeof(size_t));
+    }
+    free(scratch);
+    return true;
+}
+
+/**
+ * @brief Generates name_merge(), merges the sorted runs data[0..split) and data[split..size)
+ * Only the right run is copied to a temporary buffer, the merge runs from the back so
+ * nothing else needs to move. On equal keys the left element stays first, like a stable sort.
+ */
+#define DEFINE_MERGE(T, name, KEY)                                                          \
+static bool name##_merge(T* data, size_t split, size_t size){                               \
+    size_t right_size = size - split;                                                       \
+    T* right = malloc(right_size*sizeof(T));                                                \
+    if (!right){                                                                            \
+        return false;                                                                       \
+    }                                                                                       \
+    memcpy(right, data + split, right_size*sizeof(T));                                      \
+    size_t left_end = split, right_end = right_size, out = size;                            \
+    while (left_end > 0 && right_end > 0){                                                  \
+        if (KEY(right[right_end-1]) >= KEY(data[left_end-1])){                              \
+            data[--out] = right[--right_end];                                               \
+        } else {                                                                            \
+            data[--out] = data[--left_end];                                                 \
+        }                                                                                   \
+    }                                                                                       \
+    memcpy(data + left_end, right, right_end*sizeof(T));                                    \
+    free(right);                                                                            \
+    return true;                                                                            \
+}
+
+#define DEFINE_INTEGER_MERGE(TYPE, T, K, name) DEFINE_MERGE(T, name, key_##name)
+DARRAY_FOR_EACH_INTEGER(DEFINE_INTEGER_MERGE)
+DEFINE_MERGE(float, float, key_float)
+DEFINE_MERGE(double, double, key_double)
+
+/**
+ * @brief Merges two consecutive sorted runs of the buffer into one sorted run
+ *
+ * @param[in,out] data  The elements, data[0..split) and data[split..size) must be sorted
+ * @param[in]     split Where the second run begins
+ * @param[in]     size  How many elements
+ * @param[in]     type  The variable type of the elements
+ * @return True if success, false if memory allocation fail (the buffer is left untouched)
+ */
+bool darray_merge_buffer(void* data, size_t split, size_t size, var_types type){
+    if (split == 0 || split == size){
+        return true;
+    }
+#define MERGE_CASE(TYPE, T, K, name) case TYPE: return name##_merge(data, split, size);
+    switch(type){
+        DARRAY_FOR_EACH_INTEGER(MERGE_CASE)
+        case FLOAT: return float_merge(data, split, size);
+        case DOUBLE: return double_merge(data, split, size);
+        case CUSTOM: return false;
+    }
+    return false;
+}
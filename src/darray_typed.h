@@ -0,0 +1,218 @@
+/**
+ * @file darray_typed.h
+ * @brief Compile-time type-specialized dynamic arrays
+ *
+ * The generic dArray has to find out the element type at runtime on every call.
+ * The macros below generate a dynamic array for one concrete C type, so the
+ * compiler knows the element type and can inline and vectorize every operation.
+ *
+ * Usage:
+ * @code
+ * DARRAY_DEFINE(int, ints)
+ *
+ * ints_t array;
+ * ints_init(&array, 16);
+ * ints_append(&array, 42);
+ * size_t index;
+ * if (ints_find(&array, 42, &index)){ ... }
+ * ints_free(&array);
+ * @endcode
+ *
+ * DARRAY_DEFINE_KERNELS() only generates the functions that work on a raw
+ * buffer (name_buf_*), that is what darray.c uses behind the generic API.
+ */
+
+#ifndef DARRAY_TYPED_H
+#define DARRAY_TYPED_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Generates the raw buffer kernels for type T, all of them prefixed with name
+ *
+ * - name_buf_find():          Linear search, index of the first element equal to value
+ * - name_buf_lower_bound():   First position where value could be inserted keeping the buffer sorted
+ * - name_buf_binary_search(): Binary search on a sorted buffer, index of the first match
+ */
+#define DARRAY_DEFINE_KERNELS(T, name)                                                      \
+static inline bool name##_buf_find(const T* data, size_t size, T value, size_t* store_index){ \
+    for (size_t i = 0; i < size; i++){                                                      \
+        if (data[i] == value){                                                              \
+            *store_index = i;                                                               \
+            return true;                                                                    \
+        }                                                                                   \
+    }                                                                                       \
+    return false;                                                                           \
+}                                                                                           \
+                                                                                            \
+static inline size_t name##_buf_lower_bound(const T* data, size_t size, T value){           \
+    size_t header = 0, tail = size;                                                         \
+    while (header < tail){                                                                  \
+        size_t middle = header + (tail - header)/2;                                         \
+        if (data[middle] < value){                                                          \
+            header = middle + 1;                                                            \
+        } else {                                                                            \
+            tail = middle;                                                                  \
+        }                                                                                   \
+    }                                                                                       \
+    return header;                                                                          \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_buf_binary_search(const T* data, size_t size, T value, size_t* store_index){ \
+    size_t position = name##_buf_lower_bound(data, size, value);                            \
+    if (position < size && data[position] == value){                                        \
+        *store_index = position;                                                            \
+        return true;                                                                        \
+    }                                                                                       \
+    return false;                                                                           \
+}
+
+/**
+ * @brief Generates the type name_t and all of its functions for the element type T
+ *
+ * The struct fields are public on purpose, data[0..size) can be read and written directly.
+ * Every function that may fail returns true on success, the same way the dArray API does.
+ */
+#define DARRAY_DEFINE(T, name)                                                              \
+DARRAY_DEFINE_KERNELS(T, name)                                                              \
+                                                                                            \
+typedef struct {                                                                            \
+    T* data;         /* The elements, contiguous on the heap */                             \
+    size_t size;     /* How many elements actually exists */                                \
+    size_t capacity; /* How many elements fits in data */                                   \
+} name##_t;                                                                                 \
+                                                                                            \
+static inline bool name##_init(name##_t* array, size_t start_size){                         \
+    if (start_size == 0 || start_size > SIZE_MAX / sizeof(T)){                              \
+        return false;                                                                       \
+    }                                                                                       \
+    array->data = (T*)malloc(start_size * sizeof(T));                                       \
+    if (!array->data){                                                                      \
+        return false;                                                                       \
+    }                                                                                       \
+    array->size = 0;                                                                        \
+    array->capacity = start_size;                                                           \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline void name##_free(name##_t* array){                                            \
+    free(array->data);                                                                      \
+    array->data = NULL;                                                                     \
+    array->size = 0;                                                                        \
+    array->capacity = 0;                                                                    \
+}                                                                                           \
+                                                                                            \
+/* The slow path, only reached when the array is full */                                    \
+static inline bool name##_grow_to(name##_t* array, size_t min_capacity){                    \
+    size_t new_capacity = array->capacity + (array->capacity >> 1);                         \
+    if (new_capacity < min_capacity){                                                       \
+        new_capacity = min_capacity;                                                        \
+    }                                                                                       \
+    if (new_capacity > SIZE_MAX / sizeof(T)){                                               \
+        return false;                                                                       \
+    }                                                                                       \
+    T* temp = (T*)realloc(array->data, new_capacity * sizeof(T));                           \
+    if (!temp){                                                                             \
+        return false;                                                                       \
+    }                                                                                       \
+    array->data = temp;                                                                     \
+    array->capacity = new_capacity;                                                         \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_reserve(name##_t* array, size_t capacity){                        \
+    return capacity <= array->capacity || name##_grow_to(array, capacity);                  \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_append(name##_t* array, T value){                                 \
+    if (array->size == array->capacity && !name##_grow_to(array, array->size + 1)){         \
+        return false;                                                                       \
+    }                                                                                       \
+    array->data[array->size++] = value;                                                     \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_append_n(name##_t* array, const T* src, size_t count){            \
+    if (count > SIZE_MAX - array->size || !name##_reserve(array, array->size + count)){     \
+        return false;                                                                       \
+    }                                                                                       \
+    if (count > 0){                                                                         \
+        memcpy(array->data + array->size, src, count * sizeof(T));                          \
+    }                                                                                       \
+    array->size += count;                                                                   \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_pop(name##_t* array, T* store_var){                               \
+    if (array->size == 0){                                                                  \
+        return false;                                                                       \
+    }                                                                                       \
+    *store_var = array->data[--array->size];                                                \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_get(const name##_t* array, size_t index, T* store_variable){      \
+    if (index >= array->size){                                                              \
+        return false;                                                                       \
+    }                                                                                       \
+    *store_variable = array->data[index];                                                   \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_set(name##_t* array, size_t index, T new_value){                  \
+    if (index >= array->size){                                                              \
+        return false;                                                                       \
+    }                                                                                       \
+    array->data[index] = new_value;                                                         \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+/* Unchecked access, index must be smaller than size */                                     \
+static inline T name##_at(const name##_t* array, size_t index){                             \
+    return array->data[index];                                                              \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_insert(name##_t* array, size_t index, T new_value){               \
+    if (index > array->size){                                                               \
+        return false;                                                                       \
+    }                                                                                       \
+    if (array->size == array->capacity && !name##_grow_to(array, array->size + 1)){         \
+        return false;                                                                       \
+    }                                                                                       \
+    memmove(array->data + index + 1, array->data + index, (array->size - index) * sizeof(T)); \
+    array->data[index] = new_value;                                                         \
+    array->size++;                                                                          \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_remove_by_index(name##_t* array, size_t index){                   \
+    if (index >= array->size){                                                              \
+        return false;                                                                       \
+    }                                                                                       \
+    memmove(array->data + index, array->data + index + 1, (array->size - index - 1) * sizeof(T)); \
+    array->size--;                                                                          \
+    return true;                                                                            \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_find(const name##_t* array, T value, size_t* store_index){        \
+    return name##_buf_find(array->data, array->size, value, store_index);                   \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_remove_by_value(name##_t* array, T value){                        \
+    size_t index;                                                                           \
+    return name##_buf_find(array->data, array->size, value, &index)                         \
+        && name##_remove_by_index(array, index);                                            \
+}                                                                                           \
+                                                                                            \
+static inline bool name##_binary_search(const name##_t* array, T value, size_t* store_index){ \
+    return name##_buf_binary_search(array->data, array->size, value, store_index);          \
+}                                                                                           \
+                                                                                            \
+static inline void name##_clear(name##_t* array){                                           \
+    array->size = 0;                                                                        \
+}
+
+#endif
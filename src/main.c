@@ -71,11 +71,9 @@ void print_array(const char* title, dArray* array) {
 
     printf("Capacity: %zu | In Use: %zu\n", array_get_capacity(array), array_get_size(array));
     printf("Contents: [ ");
-    for (size_t i = 0; i < array_get_size(array); i++) {
-        test_t value;
-        if (array_get(array, i, &value)) {
-            printf(FMT_STR " ", value);
-        }
+    darray_span span = array_span_const(array);
+    for (size_t i = 0; i < span.size; i++) {
+        printf(FMT_STR " ", *(test_t*)darray_span_at(span, i));
     }
     printf("]\n\n");
 }
@@ -170,6 +168,7 @@ void run_test_suite() {
 
 // --- Main Function ---
 int main(void) {
+    array_set_default_log_handler(array_log_stderr, NULL); ///< The library is silent unless asked
     printf("=======================================\n");
     printf("==   STARTING DARRAY LIBRARY TEST    ==\n");
     printf("=======================================\n");
@@ -0,0 +1,33 @@
+/**
+ * @file check.h
+ * @brief What the tests share: CHECK() and a reproducible random source, @see make test
+ *
+ * Every tests/test_*.c is a program that returns 0 when all its checks pass. CHECK()
+ * works with NDEBUG too, unlike assert().
+ */
+
+#ifndef DARRAY_CHECK_H
+#define DARRAY_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(condition) do {                                                   \
+    if (!(condition)){                                                          \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        exit(1);                                                                \
+    }                                                                           \
+} while (0)
+
+/**
+ * @brief Xorshift64, the same fixed seed in every test so failures reproduce
+ */
+static inline unsigned long long check_random(void){
+    static unsigned long long state = 88172645463325252ULL;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+#endif
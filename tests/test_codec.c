@@ -0,0 +1,190 @@
+/**
+ * @file test_codec.c
+ * @brief array_encode() / array_decode() and the chunked encoder and decoder give back every
+ * element bit for bit, and truncated streams fail
+ *
+ * Sizes go around CHUNK_SIZE (4096 elements per chunk in darray_codec.c).
+ */
+
+#include "darray.h"
+#include "check.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SIZE 10000
+
+static const var_types types[] = {INT, FLOAT, DOUBLE, INT8, INT16, INT64, UINT8, UINT16, UINT32, UINT64};
+static const size_t type_sizes[] = {sizeof(int), sizeof(float), sizeof(double), 1, 2, 8, 1, 2, 4, 8};
+
+/**
+ * @brief Encodes size elements of values into a new temporary file, rewound
+ */
+static FILE* encode(var_types type, const void* values, size_t size){
+    dArray* array = array_new(type, 4);
+    CHECK(array_append_n(array, values, size));
+    FILE* stream = tmpfile();
+    CHECK(stream);
+    CHECK(array_encode(array, stream));
+    rewind(stream);
+    array_delete(&array);
+    return stream;
+}
+
+/**
+ * @brief The encoded stream and the chunked API both give values back exactly
+ */
+static void check_round_trip(var_types type, const unsigned char* values, size_t size){
+    size_t type_size = type_sizes[type];
+    FILE* stream = encode(type, values, size);
+    dArray* decoded = array_decode(stream);
+    CHECK(decoded);
+    CHECK(array_get_size(decoded) == size && array_get_element_size(decoded) == type_size);
+    CHECK(size == 0 || memcmp(array_data_const(decoded), values, size*type_size) == 0);
+    array_delete(&decoded);
+    fclose(stream);
+
+    ///< Odd write and read sizes, so pieces straddle the chunk boundaries
+    stream = tmpfile();
+    CHECK(stream);
+    darray_encoder* encoder = array_encoder_new(stream, type);
+    CHECK(encoder);
+    for (size_t done = 0, piece = 1; done < size; done += piece, piece = piece*3 + 1){
+        if (piece > size - done){
+            piece = size - done;
+        }
+        CHECK(array_encoder_write(encoder, values + done*type_size, piece));
+    }
+    CHECK(array_encoder_finish(&encoder) && !encoder);
+    rewind(stream);
+    darray_decoder* decoder = array_decoder_new(stream);
+    CHECK(decoder && array_decoder_type(decoder) == type);
+    unsigned char* out = malloc(MAX_SIZE*type_size);
+    CHECK(out);
+    size_t done = 0, count;
+    do {
+        CHECK(array_decoder_read(decoder, out + done*type_size, done < size ? 1000 : 1, &count));
+        done += count;
+        CHECK(done <= size);
+    } while (count > 0);
+    CHECK(done == size && (size == 0 || memcmp(out, values, size*type_size) == 0));
+    CHECK(array_decoder_delete(&decoder));
+    free(out);
+    fclose(stream);
+}
+
+/**
+ * @brief Every cut of the encoded stream (or one in every step) fails with DARRAY_ERR_CORRUPT
+ */
+static void check_truncated(var_types type, const unsigned char* values, size_t size, long step){
+    FILE* stream = encode(type, values, size);
+    CHECK(fseek(stream, 0, SEEK_END) == 0);
+    long length = ftell(stream);
+    unsigned char* bytes = malloc((size_t)length);
+    CHECK(bytes);
+    rewind(stream);
+    CHECK(fread(bytes, 1, (size_t)length, stream) == (size_t)length);
+    fclose(stream);
+
+    for (long cut = 0; cut < length; cut += step){
+        FILE* prefix = tmpfile();
+        CHECK(prefix);
+        CHECK(fwrite(bytes, 1, (size_t)cut, prefix) == (size_t)cut);
+        rewind(prefix);
+        CHECK(!array_decode(prefix));
+        CHECK(array_last_error() == DARRAY_ERR_CORRUPT);
+        fclose(prefix);
+    }
+    free(bytes);
+}
+
+/**
+ * @brief Random bits, runs of a repeated value and slow ramps, the shapes the codec special-cases
+ */
+static void fill_mixed(size_t type_size, unsigned char* values, size_t size){
+    for (size_t i = 0; i < size; i++){
+        unsigned long long bits = check_random();
+        if (i > 0 && bits % 4 == 0){
+            memcpy(values + i*type_size, values + (i - 1)*type_size, type_size);
+        } else if (bits % 4 == 1){
+            unsigned long long ramp = i / 3;
+            memcpy(values + i*type_size, &ramp, type_size); ///< Little endian low bytes
+        } else {
+            bits = check_random();
+            memcpy(values + i*type_size, &bits, type_size);
+        }
+    }
+}
+
+static void test_sizes(unsigned char* values){
+    static const size_t sizes[] = {0, 1, 2, 4095, 4096, 4097, 8192, MAX_SIZE};
+    for (size_t t = 0; t < sizeof(types)/sizeof(*types); t++){
+        for (size_t s = 0; s < sizeof(sizes)/sizeof(*sizes); s++){
+            fill_mixed(type_sizes[t], values, sizes[s]);
+            check_round_trip(types[t], values, sizes[s]);
+        }
+    }
+}
+
+static void test_float_bits(void){
+    static const uint32_t floats[] = {
+        0x7FC00000u, 0xFFC00000u, 0x7F800001u, 0x7FC12345u, 0x7FC12345u, 0xFFFFFFFFu,
+        0x80000000u, 0x00000000u, 0x80000000u, 0x7F800000u, 0xFF800000u, 0x00000001u
+    };
+    static const uint64_t doubles[] = {
+        0x7FF8000000000000u, 0xFFF8000000000000u, 0x7FF0000000000001u, 0x7FF8000000012345u,
+        0x7FF8000000012345u, 0xFFFFFFFFFFFFFFFFu, 0x8000000000000000u, 0x0000000000000000u,
+        0x8000000000000000u, 0x7FF0000000000000u, 0xFFF0000000000000u, 0x0000000000000001u
+    };
+    check_round_trip(FLOAT, (const unsigned char*)floats, sizeof(floats)/sizeof(*floats));
+    check_round_trip(DOUBLE, (const unsigned char*)doubles, sizeof(doubles)/sizeof(*doubles));
+}
+
+static void test_integer_extremes(void){
+    ///< Every delta is as big as it gets, and wraps for the 64 bit types
+    int ints[64];
+    int64_t longs[64];
+    uint64_t ulongs[64];
+    uint8_t bytes[64];
+    for (int i = 0; i < 64; i++){
+        ints[i] = i % 2 ? INT_MAX : INT_MIN;
+        longs[i] = i % 3 == 0 ? INT64_MIN : i % 3 == 1 ? INT64_MAX : 0;
+        ulongs[i] = i % 2 ? UINT64_MAX : 0;
+        bytes[i] = i % 2 ? UINT8_MAX : 0;
+    }
+    check_round_trip(INT, (const unsigned char*)ints, 64);
+    check_round_trip(INT64, (const unsigned char*)longs, 64);
+    check_round_trip(UINT64, (const unsigned char*)ulongs, 64);
+    check_round_trip(UINT8, bytes, 64);
+}
+
+static void test_bad_streams(unsigned char* values){
+    fill_mixed(sizeof(double), values, 100);
+    check_truncated(DOUBLE, values, 100, 1);
+    fill_mixed(sizeof(int), values, 100);
+    check_truncated(INT, values, 100, 1);
+    fill_mixed(sizeof(int64_t), values, MAX_SIZE);
+    check_truncated(INT64, values, MAX_SIZE, 97); ///< Cuts inside every chunk
+
+    FILE* stream = tmpfile();
+    CHECK(stream);
+    CHECK(!array_encoder_new(stream, CUSTOM));
+    CHECK(array_last_error() == DARRAY_ERR_INVALID_ARGUMENT);
+    CHECK(fwrite("NOTASTREAM", 1, 10, stream) == 10);
+    rewind(stream);
+    CHECK(!array_decode(stream));
+    CHECK(array_last_error() == DARRAY_ERR_CORRUPT);
+    fclose(stream);
+}
+
+int main(void){
+    unsigned char* values = malloc(MAX_SIZE*sizeof(uint64_t));
+    CHECK(values);
+    test_sizes(values);
+    test_float_bits();
+    test_integer_extremes();
+    test_bad_streams(values);
+    free(values);
+    return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file test_concurrent.c
+ * @brief Producers appending with array_append_concurrent() lose and duplicate nothing once sealed
+ */
+
+#include "darray.h"
+#include "check.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+#define PRODUCERS 8
+#define APPENDS 50000 ///< Per producer, enough to fill several segments
+#define KEPT 100      ///< Elements in the array before concurrent mode
+#define VALUE(producer, i) ((int)((producer) * APPENDS + (i)))
+
+static dArray* shared;
+
+static void* producer(void* argument){
+    int id = (int)(size_t)argument;
+    for (int i = 0; i < APPENDS; i++){
+        int value = VALUE(id, i);
+        CHECK(array_append_concurrent(shared, &value));
+    }
+    return NULL;
+}
+
+/**
+ * @brief One round: begin, PRODUCERS threads appending, seal, then check every element
+ */
+static void run_round(dArray* array, size_t start){
+    CHECK(array_begin_concurrent(array));
+    int refused = -1;
+    CHECK(!array_append(array, &refused)); ///< Only concurrent appends until the seal
+
+    shared = array;
+    pthread_t threads[PRODUCERS];
+    for (size_t i = 0; i < PRODUCERS; i++){
+        CHECK(pthread_create(&threads[i], NULL, producer, (void*)i) == 0);
+    }
+    for (size_t i = 0; i < PRODUCERS; i++){
+        pthread_join(threads[i], NULL);
+    }
+    CHECK(array_seal(array));
+    CHECK(array_get_size(array) == start + (size_t)PRODUCERS*APPENDS);
+
+    ///< Every value once, and each producer's values in the order it appended them
+    unsigned char* seen = calloc((size_t)PRODUCERS*APPENDS, 1);
+    int last[PRODUCERS];
+    CHECK(seen);
+    for (int i = 0; i < PRODUCERS; i++){
+        last[i] = -1;
+    }
+    for (size_t i = start; i < array_get_size(array); i++){
+        int value;
+        CHECK(array_get(array, i, &value));
+        CHECK(value >= 0 && value < PRODUCERS*APPENDS && !seen[value]);
+        seen[value] = 1;
+        int id = value / APPENDS;
+        CHECK(value % APPENDS > last[id]);
+        last[id] = value % APPENDS;
+    }
+    free(seen);
+}
+
+int main(void){
+    dArray* array = array_new(INT, 16);
+    for (int i = 0; i < KEPT; i++){
+        int value = -i;
+        array_append(array, &value);
+    }
+    run_round(array, KEPT);
+    run_round(array, KEPT + (size_t)PRODUCERS*APPENDS); ///< The array can go concurrent again after a seal
+    for (int i = 0; i < KEPT; i++){
+        int value;
+        CHECK(array_get(array, (size_t)i, &value) && value == -i);
+    }
+    CHECK(!array_seal(array)); ///< Not in concurrent mode anymore
+    array_delete(&array);
+    return 0;
+}
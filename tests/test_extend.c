@@ -0,0 +1,80 @@
+/**
+ * @file test_extend.c
+ * @brief array_extend() between arrays of the same and of different element types, and from NULL
+ */
+
+#include "darray.h"
+#include "check.h"
+#include <string.h>
+
+static void test_same_type(void){
+    dArray* dst = array_new(INT, 2);
+    dArray* src = array_new(INT, 2);
+    for (int i = 0; i < 10; i++){
+        array_append(src, &i);
+    }
+    CHECK(array_extend(dst, src));
+    CHECK(array_extend(dst, dst));
+    CHECK(array_get_size(dst) == 20);
+    const int* data = array_data_const(dst);
+    for (int i = 0; i < 20; i++){
+        CHECK(data[i] == i % 10);
+    }
+    array_delete(&dst);
+    array_delete(&src);
+}
+
+static void test_mismatched_types(void){
+    dArray* ints = array_new(INT, 2);
+    dArray* floats = array_new(FLOAT, 2);
+    float value = 1.0f;
+    array_append(floats, &value);
+    CHECK(!array_extend(ints, floats));
+    CHECK(array_last_error() == DARRAY_ERR_INVALID_ARGUMENT);
+    CHECK(array_get_size(ints) == 0);
+    array_delete(&ints);
+    array_delete(&floats);
+}
+
+static void test_custom_element_sizes(void){
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    options.element_size = 64;
+    dArray* wide = array_new_ex(CUSTOM, 4, &options);
+    options.element_size = 4;
+    dArray* narrow = array_new_ex(CUSTOM, 4, &options);
+    unsigned char element[64] = {0};
+    for (int i = 0; i < 100; i++){
+        element[0] = (unsigned char)i;
+        array_append(narrow, element);
+    }
+    CHECK(!array_extend(wide, narrow));
+    CHECK(array_last_error() == DARRAY_ERR_INVALID_ARGUMENT);
+    CHECK(!array_extend(narrow, wide));
+    CHECK(array_get_size(wide) == 0 && array_get_size(narrow) == 100);
+
+    options.element_size = 4;
+    dArray* same = array_new_ex(CUSTOM, 4, &options);
+    CHECK(array_extend(same, narrow));
+    CHECK(memcmp(array_data_const(same), array_data_const(narrow), 100*4) == 0);
+    array_delete(&wide);
+    array_delete(&narrow);
+    array_delete(&same);
+}
+
+static void test_null_source(void){
+    dArray* dst = array_new(INT, 2);
+    int value = 1;
+    array_append(dst, &value);
+    CHECK(!array_extend(dst, NULL));
+    CHECK(array_last_error() == DARRAY_ERR_INVALID_ARGUMENT);
+    CHECK(array_get_size(dst) == 1);
+    array_delete(&dst);
+}
+
+int main(void){
+    test_same_type();
+    test_mismatched_types();
+    test_custom_element_sizes();
+    test_null_source();
+    return 0;
+}
@@ -0,0 +1,244 @@
+/**
+ * @file test_file_format.c
+ * @brief array_save(), array_load() and array_map_file(): round trips, and corrupt files
+ * rejected instead of trusted
+ *
+ * Each rejection case saves a valid array, patches one header field or the payload in
+ * place and checks that the readers fail with the expected status. The offsets follow
+ * the layout in darray_io.c.
+ */
+
+#define _POSIX_C_SOURCE 200809L ///< mkdtemp()
+#include "darray.h"
+#include "check.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OFFSET_VERSION 8
+#define OFFSET_BYTE_ORDER 12
+#define OFFSET_TYPE 16
+#define OFFSET_TYPE_SIZE 20
+#define OFFSET_COUNT 24
+#define OFFSET_PAYLOAD 64
+
+static char path[256];
+
+/**
+ * @brief Saves 100 ints to path
+ */
+static void save_ints(void){
+    dArray* array = array_new(INT, 100);
+    for (int i = 0; i < 100; i++){
+        array_append(array, &i);
+    }
+    CHECK(array_save(array, path));
+    array_delete(&array);
+}
+
+/**
+ * @brief Overwrites size bytes of the file at offset
+ */
+static void patch(long offset, const void* bytes, size_t size){
+    FILE* file = fopen(path, "r+b");
+    CHECK(file);
+    CHECK(fseek(file, offset, SEEK_SET) == 0);
+    CHECK(fwrite(bytes, 1, size, file) == size);
+    CHECK(fclose(file) == 0);
+}
+
+static void patch_u32(long offset, uint32_t value){
+    patch(offset, &value, sizeof(value));
+}
+
+static void patch_u64(long offset, uint64_t value){
+    patch(offset, &value, sizeof(value));
+}
+
+/**
+ * @brief Both readers refuse the file with status
+ */
+static void check_rejected(darray_status status){
+    CHECK(!array_load(path));
+    CHECK(array_last_error() == status);
+    CHECK(!array_map_file(path));
+    CHECK(array_last_error() == status);
+}
+
+static void test_corrupt_headers(void){
+    save_ints();
+    patch_u32(OFFSET_TYPE, CUSTOM);
+    patch_u32(OFFSET_TYPE_SIZE, 0); ///< Used to divide by zero
+    check_rejected(DARRAY_ERR_CORRUPT);
+
+    save_ints();
+    patch_u32(OFFSET_TYPE_SIZE, 8); ///< Not sizeof(int)
+    check_rejected(DARRAY_ERR_CORRUPT);
+
+    save_ints();
+    patch_u32(OFFSET_TYPE, CUSTOM + 1);
+    check_rejected(DARRAY_ERR_CORRUPT);
+
+    save_ints();
+    patch_u64(OFFSET_COUNT, 101); ///< One element more than the payload holds
+    check_rejected(DARRAY_ERR_CORRUPT);
+
+    save_ints();
+    patch_u64(OFFSET_COUNT, UINT64_MAX / 2); ///< count * type_size overflows
+    check_rejected(DARRAY_ERR_CORRUPT);
+}
+
+static void test_bad_files(void){
+    save_ints();
+    patch(0, "NOTARRAY", 8);
+    check_rejected(DARRAY_ERR_CORRUPT);
+
+    save_ints();
+    patch_u32(OFFSET_VERSION, 2);
+    check_rejected(DARRAY_ERR_UNSUPPORTED);
+
+    save_ints();
+    patch_u32(OFFSET_BYTE_ORDER, 0x04030201u); ///< What a machine of the other byte order wrote
+    check_rejected(DARRAY_ERR_UNSUPPORTED);
+
+    save_ints();
+    CHECK(truncate(path, OFFSET_PAYLOAD + 99*sizeof(int)) == 0); ///< The last element is missing
+    check_rejected(DARRAY_ERR_CORRUPT);
+
+    save_ints();
+    CHECK(truncate(path, OFFSET_PAYLOAD / 2) == 0); ///< Not even a whole header
+    check_rejected(DARRAY_ERR_CORRUPT);
+
+    ///< A flipped payload byte fails the checksum of array_load(), array_map_file() skips it by design
+    save_ints();
+    patch_u32(OFFSET_PAYLOAD + 10*sizeof(int), 12345);
+    CHECK(!array_load(path));
+    CHECK(array_last_error() == DARRAY_ERR_CORRUPT);
+    dArray* mapped = array_map_file(path);
+    CHECK(mapped);
+    int value;
+    CHECK(array_get(mapped, 10, &value) && value == 12345);
+    array_delete(&mapped);
+
+    CHECK(!array_load("/nonexistent/darray/file"));
+    CHECK(array_last_error() == DARRAY_ERR_IO);
+}
+
+static void test_mapped_read_only(void){
+    save_ints();
+    dArray* mapped = array_map_file(path);
+    CHECK(mapped && array_get_size(mapped) == 100);
+    int value = 7;
+    CHECK(!array_append(mapped, &value));
+    CHECK(array_last_error() == DARRAY_ERR_READ_ONLY);
+    CHECK(!array_set(mapped, 0, &value));
+    CHECK(array_last_error() == DARRAY_ERR_READ_ONLY);
+    CHECK(!array_insert(mapped, 0, &value));
+    CHECK(!array_pop(mapped, &value));
+    CHECK(!array_remove_by_index(mapped, 0));
+    CHECK(!array_sort_ex(mapped, DARRAY_SORT_AUTO));
+    CHECK(!array_data(mapped));
+    CHECK(array_get_size(mapped) == 100);
+
+    ///< Reads still work, and array_extend() makes a writable copy
+    const int* data = array_data_const(mapped);
+    for (int i = 0; i < 100; i++){
+        CHECK(data[i] == i);
+    }
+    dArray* copy = array_new(INT, 4);
+    CHECK(array_extend(copy, mapped));
+    CHECK(array_append(copy, &value) && array_get_size(copy) == 101);
+    array_delete(&copy);
+    array_delete(&mapped);
+}
+
+typedef struct {
+    int key;
+    char name[12];
+} record;
+
+/**
+ * @brief Saves array, then checks that array_load() and array_map_file() give its elements back
+ */
+static void check_round_trip(dArray* array){
+    size_t size = array_get_size(array), type_size = array_get_element_size(array);
+    unsigned char expected[200*sizeof(record)];
+    CHECK(size*type_size <= sizeof(expected));
+    for (size_t i = 0; i < size; i++){
+        CHECK(array_get(array, i, expected + i*type_size));
+    }
+    CHECK(array_save(array, path));
+
+    dArray* readers[2] = {array_load(path), array_map_file(path)};
+    for (int r = 0; r < 2; r++){
+        dArray* read = readers[r];
+        CHECK(read);
+        CHECK(array_get_size(read) == size && array_get_element_size(read) == type_size);
+        CHECK(size == 0 || memcmp(array_data_const(read), expected, size*type_size) == 0);
+        array_delete(&read);
+    }
+}
+
+static void test_round_trips(void){
+    static const darray_storage storages[] = {DARRAY_STORAGE_FLAT, DARRAY_STORAGE_GAP, DARRAY_STORAGE_RING};
+    for (size_t s = 0; s < sizeof(storages)/sizeof(*storages); s++){
+        darray_options options = DARRAY_OPTIONS_DEFAULT;
+        options.storage = storages[s];
+        dArray* array = array_new_ex(DOUBLE, 8, &options);
+        check_round_trip(array); ///< Empty
+        for (int i = 0; i < 150; i++){
+            double value = i * 0.5;
+            array_append(array, &value);
+        }
+        for (int i = 0; i < 30; i++){
+            double value = -i;
+            array_insert(array, 40, &value); ///< Moves the gap to the middle
+            array_push_front(array, &value); ///< Wraps the ring
+        }
+        check_round_trip(array);
+        array_delete(&array);
+    }
+
+    ///< Saved sorted, loaded known sorted
+    dArray* sorted = array_new(INT, 8);
+    for (int i = 0; i < 50; i++){
+        int value = 50 - i;
+        array_append(sorted, &value);
+    }
+    array_sort(sorted);
+    CHECK(array_save(sorted, path));
+    dArray* loaded = array_load(path);
+    CHECK(loaded && array_is_sorted(loaded));
+    size_t index;
+    int key = 25;
+    CHECK(array_binary_search(loaded, &key, &index, true) && index == 24);
+    array_delete(&loaded);
+    array_delete(&sorted);
+
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    options.element_size = sizeof(record);
+    dArray* records = array_new_ex(CUSTOM, 4, &options);
+    for (int i = 0; i < 20; i++){
+        record item = {i, "item"};
+        item.name[4] = (char)('a' + i);
+        array_append(records, &item);
+    }
+    check_round_trip(records);
+    array_delete(&records);
+}
+
+int main(void){
+    char directory[] = "/tmp/darray_test_file_format_XXXXXX";
+    CHECK(mkdtemp(directory));
+    snprintf(path, sizeof(path), "%s/array.bin", directory);
+
+    test_corrupt_headers();
+    test_bad_files();
+    test_mapped_read_only();
+    test_round_trips();
+
+    CHECK(remove(path) == 0);
+    CHECK(rmdir(directory) == 0);
+    return 0;
+}
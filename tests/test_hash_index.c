@@ -0,0 +1,105 @@
+/**
+ * @file test_hash_index.c
+ * @brief array_find(), array_count() and array_remove_by_value() with a hash index agree with
+ * a plain scan after every kind of change
+ */
+
+#include "darray.h"
+#include "check.h"
+
+#define STEPS 3000
+#define MAX_VALUE 64 ///< Few distinct values, so most lookups hit duplicates
+
+static unsigned random_below(unsigned limit){
+    return (unsigned)(check_random() % limit);
+}
+
+/**
+ * @brief Index of the first element equal to value and how many there are, read with array_get()
+ */
+static size_t scan(dArray* array, int value, size_t* store_first){
+    size_t count = 0;
+    for (size_t i = 0; i < array_get_size(array); i++){
+        int element;
+        array_get(array, i, &element);
+        if (element == value){
+            if (count == 0){
+                *store_first = i;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Checks every value, array_count() first so it also runs on a stale index
+ */
+static void check_lookups(dArray* array){
+    for (int value = -1; value <= MAX_VALUE; value++){
+        size_t first = 0, index = 0;
+        size_t count = scan(array, value, &first);
+        CHECK(array_count(array, &value) == count);
+        CHECK(array_find(array, &value, &index) == (count > 0));
+        CHECK(count == 0 || index == first);
+        CHECK(array_count(array, &value) == count);
+    }
+}
+
+static void run(darray_storage storage){
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    options.storage = storage;
+    dArray* array = array_new_ex(INT, 8, &options);
+    CHECK(array_enable_hash_index(array));
+    for (int step = 0; step < STEPS; step++){
+        int value = (int)random_below(MAX_VALUE);
+        size_t size = array_get_size(array);
+        switch (random_below(8)){
+            case 0:
+            case 1:
+                CHECK(array_append(array, &value));
+                break;
+            case 2:
+                if (size > 0){
+                    CHECK(array_set(array, random_below((unsigned)size), &value));
+                }
+                break;
+            case 3:
+                if (size > 0){
+                    int popped;
+                    CHECK(array_pop(array, &popped));
+                }
+                break;
+            case 4:
+                CHECK(array_insert(array, size / 2, &value));
+                break;
+            case 5:
+                if (random_below(16) == 0){
+                    array_sort(array);
+                }
+                break;
+            case 6:
+                if (size > 0){
+                    int* data = array_data(array);
+                    data[random_below((unsigned)size)] = value;
+                }
+                break;
+            default: {
+                size_t first = 0;
+                size_t count = scan(array, value, &first);
+                CHECK(array_remove_by_value(array, &value) == (count > 0));
+                CHECK(array_count(array, &value) == (count > 0 ? count - 1 : 0));
+                break;
+            }
+        }
+        check_lookups(array);
+    }
+    array_delete(&array);
+}
+
+int main(void){
+    run(DARRAY_STORAGE_FLAT);
+    run(DARRAY_STORAGE_GAP);
+    run(DARRAY_STORAGE_RING);
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file test_ring_window.c
+ * @brief An overwrite_oldest ring keeps its capacity whatever adds the elements
+ *
+ * Every call is checked against a plain C model: the logical result of the call,
+ * trimmed from the front down to the capacity.
+ */
+
+#include "darray.h"
+#include "check.h"
+#include <string.h>
+
+#define CAPACITY 4
+
+typedef struct {
+    int values[64];
+    size_t size;
+} model;
+
+static void model_insert(model* m, size_t index, const int* values, size_t count){
+    memmove(m->values + index + count, m->values + index, (m->size - index)*sizeof(int));
+    memcpy(m->values + index, values, count*sizeof(int));
+    m->size += count;
+    if (m->size > CAPACITY){
+        size_t dropped = m->size - CAPACITY;
+        memmove(m->values, m->values + dropped, CAPACITY*sizeof(int));
+        m->size = CAPACITY;
+    }
+}
+
+static void check_same(const dArray* ring, const model* m){
+    CHECK(array_get_capacity(ring) == CAPACITY);
+    CHECK(array_get_size(ring) == m->size);
+    CHECK(memcmp(array_data_const(ring), m->values, m->size*sizeof(int)) == 0);
+}
+
+static dArray* new_window(void){
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    options.storage = DARRAY_STORAGE_RING;
+    options.overwrite_oldest = true;
+    return array_new_ex(INT, CAPACITY, &options);
+}
+
+static void test_insert(void){
+    dArray* ring = new_window();
+    model m = {{0}, 0};
+    for (int i = 0; i < 40; i++){
+        size_t index = (size_t)(i*7) % (m.size + 1);
+        CHECK(array_insert(ring, index, &i));
+        model_insert(&m, index, &i, 1);
+        check_same(ring, &m);
+    }
+    array_delete(&ring);
+}
+
+static void test_insert_n(void){
+    dArray* ring = new_window();
+    model m = {{0}, 0};
+    int values[6] = {100, 101, 102, 103, 104, 105};
+    for (size_t count = 0; count <= 6; count++){
+        for (size_t index = 0; index <= m.size; index++){
+            CHECK(array_insert_n(ring, index, values, count));
+            model_insert(&m, index, values, count);
+            check_same(ring, &m);
+            values[0]++;
+        }
+    }
+    array_delete(&ring);
+}
+
+static void test_extend(void){
+    dArray* ring = new_window();
+    dArray* source = array_new(INT, 2);
+    model m = {{0}, 0};
+    for (int i = 0; i < 10; i++){
+        array_append(source, &i);
+        CHECK(array_extend(ring, source));
+        model_insert(&m, m.size, array_data_const(source), array_get_size(source));
+        check_same(ring, &m);
+
+        ///< Extending the window with itself keeps its last CAPACITY elements
+        model copy = m;
+        CHECK(array_extend(ring, ring));
+        model_insert(&m, m.size, copy.values, copy.size);
+        check_same(ring, &m);
+    }
+    array_delete(&ring);
+    array_delete(&source);
+}
+
+static void test_append_and_push_front(void){
+    dArray* ring = new_window();
+    model m = {{0}, 0};
+    for (int i = 0; i < 10; i++){
+        CHECK(array_append(ring, &i));
+        model_insert(&m, m.size, &i, 1);
+        check_same(ring, &m);
+    }
+    int front = -1;
+    CHECK(array_push_front(ring, &front)); ///< Drops the last element, not the first
+    int expected[CAPACITY] = {-1, 6, 7, 8};
+    CHECK(memcmp(array_data_const(ring), expected, sizeof(expected)) == 0);
+    CHECK(array_get_capacity(ring) == CAPACITY);
+    array_delete(&ring);
+}
+
+int main(void){
+    test_insert();
+    test_insert_n();
+    test_extend();
+    test_append_and_push_front();
+    return 0;
+}
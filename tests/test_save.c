@@ -0,0 +1,75 @@
+/**
+ * @file test_save.c
+ * @brief Threads saving to the same path never share a temporary file, and none is left behind
+ */
+
+#define _POSIX_C_SOURCE 200809L ///< mkdtemp()
+#include "darray.h"
+#include "check.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define THREADS 8
+#define SAVES 20
+#define SIZE 10000
+
+static char path[256];
+
+/**
+ * @brief Saves an array of SIZE copies of its own number, SAVES times
+ */
+static void* save_worker(void* argument){
+    int value = (int)(size_t)argument;
+    dArray* array = array_new(INT, SIZE);
+    for (int i = 0; i < SIZE; i++){
+        array_append(array, &value);
+    }
+    for (int i = 0; i < SAVES; i++){
+        CHECK(array_save(array, path));
+    }
+    array_delete(&array);
+    return NULL;
+}
+
+int main(void){
+    char directory[] = "/tmp/darray_test_save_XXXXXX";
+    CHECK(mkdtemp(directory));
+    snprintf(path, sizeof(path), "%s/array.bin", directory);
+
+    pthread_t threads[THREADS];
+    for (size_t i = 0; i < THREADS; i++){
+        CHECK(pthread_create(&threads[i], NULL, save_worker, (void*)i) == 0);
+    }
+    for (size_t i = 0; i < THREADS; i++){
+        pthread_join(threads[i], NULL);
+    }
+
+    ///< The last rename wins, the file holds one whole array
+    dArray* loaded = array_load(path);
+    CHECK(loaded && array_get_size(loaded) == SIZE);
+    int first;
+    array_get(loaded, 0, &first);
+    CHECK(array_count(loaded, &first) == SIZE);
+    array_delete(&loaded);
+
+    DIR* listing = opendir(directory);
+    CHECK(listing);
+    struct dirent* entry;
+    size_t files = 0;
+    while ((entry = readdir(listing))){
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0){
+            CHECK(strcmp(entry->d_name, "array.bin") == 0);
+            files++;
+        }
+    }
+    closedir(listing);
+    CHECK(files == 1);
+
+    CHECK(remove(path) == 0);
+    CHECK(rmdir(directory) == 0);
+    return 0;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file test_selection.c
+ * @brief array_nth_element(), array_partial_sort(), array_top_k(), array_argsort() and
+ * array_apply_permutation() against qsort()
+ *
+ * Few distinct values, so ties are everywhere and argsort stability is checked for real.
+ */
+
+#include "darray.h"
+#include "check.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SIZE 5000
+
+static int compare_ints(const void* first, const void* second){
+    int a = *(const int*)first, b = *(const int*)second;
+    return (a > b) - (a < b);
+}
+
+/**
+ * @brief An INT array of size values below range, and a qsort()ed copy in store_sorted
+ */
+static dArray* new_random(size_t size, unsigned range, int* store_sorted){
+    dArray* array = array_new(INT, 4);
+    for (size_t i = 0; i < size; i++){
+        int value = (int)(check_random() % range) - (int)(range / 2);
+        CHECK(array_append(array, &value));
+        store_sorted[i] = value;
+    }
+    qsort(store_sorted, size, sizeof(int), compare_ints);
+    return array;
+}
+
+static void check_nth_and_partial(size_t size, const int* input, const int* sorted){
+    dArray* array = array_new(INT, 4);
+    for (size_t nth = 0; nth < size; nth += size / 7 + 1){
+        array_clear(array);
+        CHECK(array_append_n(array, input, size));
+        CHECK(array_nth_element(array, nth));
+        const int* data = array_data_const(array);
+        CHECK(data[nth] == sorted[nth]);
+        for (size_t i = 0; i < size; i++){
+            CHECK(i < nth ? data[i] <= data[nth] : data[i] >= data[nth]);
+        }
+    }
+    CHECK(!array_nth_element(array, size));
+    CHECK(array_last_error() == DARRAY_ERR_OUT_OF_RANGE);
+
+    static const size_t extra[] = {0, 1, 2};
+    for (size_t count = 0; count <= size + 2; count += size / 5 + 1){
+        for (size_t e = 0; e < sizeof(extra)/sizeof(*extra); e++){
+            size_t wanted = count + extra[e];
+            array_clear(array);
+            CHECK(array_append_n(array, input, size));
+            CHECK(array_partial_sort(array, wanted));
+            const int* data = array_data_const(array);
+            size_t done = wanted < size ? wanted : size;
+            CHECK(done == 0 || memcmp(data, sorted, done*sizeof(int)) == 0);
+            for (size_t i = done; i < size && done > 0; i++){
+                CHECK(data[i] >= data[done - 1]);
+            }
+        }
+    }
+    array_delete(&array);
+}
+
+static void check_top_k(const dArray* array, size_t size, const int* sorted){
+    static const size_t extra[] = {0, 1, 7};
+    for (size_t e = 0; e < sizeof(extra)/sizeof(*extra); e++){
+        size_t ks[] = {0, 1, size / 2, size, size + extra[e]};
+        for (size_t i = 0; i < sizeof(ks)/sizeof(*ks); i++){
+            size_t k = ks[i], kept = k < size ? k : size;
+            dArray* smallest = array_top_k(array, k, false);
+            dArray* largest = array_top_k(array, k, true);
+            CHECK(smallest && largest);
+            CHECK(array_get_size(smallest) == kept && array_get_size(largest) == kept);
+            for (size_t j = 0; j < kept; j++){
+                int low, high;
+                array_get(smallest, j, &low);
+                array_get(largest, j, &high);
+                CHECK(low == sorted[j]);
+                CHECK(high == sorted[size - 1 - j]); ///< Descending
+            }
+            array_delete(&smallest);
+            array_delete(&largest);
+        }
+    }
+}
+
+static void check_argsort(dArray* array, size_t size, const int* sorted){
+    size_t* indices = malloc((size + 1) * sizeof(size_t));
+    CHECK(indices);
+    int* input = malloc((size + 1) * sizeof(int));
+    CHECK(input);
+    for (size_t i = 0; i < size; i++){
+        array_get(array, i, &input[i]);
+    }
+    CHECK(array_argsort(array, indices));
+    for (size_t i = 0; i < size; i++){
+        CHECK(indices[i] < size && input[indices[i]] == sorted[i]);
+        if (i > 0 && sorted[i] == sorted[i - 1]){
+            CHECK(indices[i] > indices[i - 1]); ///< Stable: ties keep their index order
+        }
+    }
+    CHECK(memcmp(array_data_const(array), input, size*sizeof(int)) == 0 || size == 0); ///< Untouched
+
+    dArray* copy = array_new(INT, 4);
+    CHECK(array_extend(copy, array));
+    CHECK(array_apply_permutation(copy, indices));
+    CHECK(size == 0 || memcmp(array_data_const(copy), sorted, size*sizeof(int)) == 0);
+    CHECK(array_is_sorted(copy));
+
+    if (size >= 2){
+        ///< A duplicate and an out of range index are refused, and the array is left alone
+        array_clear(copy);
+        CHECK(array_extend(copy, array));
+        size_t saved = indices[1];
+        indices[1] = indices[0];
+        CHECK(!array_apply_permutation(copy, indices));
+        CHECK(array_last_error() == DARRAY_ERR_INVALID_ARGUMENT);
+        indices[1] = size;
+        CHECK(!array_apply_permutation(copy, indices));
+        CHECK(array_last_error() == DARRAY_ERR_INVALID_ARGUMENT);
+        indices[1] = saved;
+        CHECK(memcmp(array_data_const(copy), input, size*sizeof(int)) == 0);
+    }
+    array_delete(&copy);
+    free(input);
+    free(indices);
+}
+
+static void test_ints(void){
+    static const size_t sizes[] = {0, 1, 2, 3, 16, 17, 100, 511, 512, 1000, MAX_SIZE};
+    int* sorted = malloc(MAX_SIZE * sizeof(int));
+    int* input = malloc(MAX_SIZE * sizeof(int));
+    CHECK(sorted && input);
+    for (size_t s = 0; s < sizeof(sizes)/sizeof(*sizes); s++){
+        size_t size = sizes[s];
+        dArray* array = new_random(size, size < 50 ? 5 : 50, sorted);
+        for (size_t i = 0; i < size; i++){
+            array_get(array, i, &input[i]);
+        }
+        check_nth_and_partial(size, input, sorted);
+        check_top_k(array, size, sorted);
+        check_argsort(array, size, sorted);
+        array_delete(&array);
+    }
+    free(input);
+    free(sorted);
+}
+
+static void test_doubles(void){
+    ///< array_sort() order: -0.0 before +0.0, NaNs last in their input order
+    double values[] = {3.0, NAN, 0.0, -0.0, -1.0, NAN, 2.0, -INFINITY, 0.0};
+    size_t size = sizeof(values)/sizeof(*values);
+    dArray* array = array_new(DOUBLE, 4);
+    CHECK(array_append_n(array, values, size));
+    size_t indices[9];
+    CHECK(array_argsort(array, indices));
+    static const size_t expected[] = {7, 4, 3, 2, 8, 6, 0, 1, 5};
+    CHECK(memcmp(indices, expected, sizeof(expected)) == 0);
+
+    dArray* top = array_top_k(array, 3, true);
+    const double* data = array_data_const(top);
+    CHECK(isnan(data[0]) && isnan(data[1]) && data[2] == 3.0);
+    array_delete(&top);
+    top = array_top_k(array, 3, false);
+    data = array_data_const(top);
+    CHECK(data[0] == -INFINITY && data[1] == -1.0 && data[2] == 0.0 && signbit(data[2]));
+    array_delete(&top);
+    array_delete(&array);
+}
+
+int main(void){
+    test_ints();
+    test_doubles();
+    return 0;
+}
@@ -0,0 +1,184 @@
+/**
+ * @file test_sort_engines.c
+ * @brief Radix sort and introsort put every type in exactly the same order, @see darray_sort.c
+ *
+ * The inputs mix random bytes with the values both engines have to special-case: NaNs with
+ * different payloads and signs, -0.0 and +0.0, infinities, and the extremes of every integer
+ * type. Sizes go around DARRAY_RADIX_THRESHOLD (512), where array_sort() switches engines.
+ */
+
+#include "darray.h"
+#include "check.h"
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const var_types types[] = {INT, FLOAT, DOUBLE, INT8, INT16, INT64, UINT8, UINT16, UINT32, UINT64};
+static const size_t type_sizes[] = {sizeof(int), sizeof(float), sizeof(double), 1, 2, 8, 1, 2, 4, 8};
+
+/**
+ * @brief Writes the index-th special value of type at element, false when there are no more
+ */
+static bool special_value(var_types type, unsigned index, void* element){
+    switch (type){
+        case INT: {
+            static const int values[] = {INT_MIN, INT_MAX, 0, -1, 1, INT_MIN + 1, INT_MAX - 1};
+            if (index >= sizeof(values)/sizeof(*values)){return false;}
+            memcpy(element, &values[index], sizeof(int));
+            return true;
+        }
+        case FLOAT: {
+            static const uint32_t values[] = {
+                0x7FC00000u, 0xFFC00000u, 0x7F800001u, 0x7FC12345u, ///< NaNs: quiet, negative, signalling, with payload
+                0x80000000u, 0x00000000u, 0x7F800000u, 0xFF800000u, ///< -0.0, +0.0, +inf, -inf
+                0x00000001u, 0x80000001u, 0x7F7FFFFFu, 0xFF7FFFFFu  ///< Denormals and the largest finite values
+            };
+            if (index >= sizeof(values)/sizeof(*values)){return false;}
+            memcpy(element, &values[index], sizeof(float));
+            return true;
+        }
+        case DOUBLE: {
+            static const uint64_t values[] = {
+                0x7FF8000000000000u, 0xFFF8000000000000u, 0x7FF0000000000001u, 0x7FF8000000012345u,
+                0x8000000000000000u, 0x0000000000000000u, 0x7FF0000000000000u, 0xFFF0000000000000u,
+                0x0000000000000001u, 0x8000000000000001u, 0x7FEFFFFFFFFFFFFFu, 0xFFEFFFFFFFFFFFFFu
+            };
+            if (index >= sizeof(values)/sizeof(*values)){return false;}
+            memcpy(element, &values[index], sizeof(double));
+            return true;
+        }
+        default: {
+            ///< All bits clear, all bits set, only the top bit and all but the top bit: the extremes of signed and unsigned types
+            size_t size = type_sizes[type];
+            unsigned char* bytes = element;
+            if (index >= 4){return false;}
+            memset(bytes, index == 1 || index == 3 ? 0xFF : 0x00, size);
+            if (index >= 2){
+                bytes[size - 1] ^= 0x80; ///< The sign bit on little endian machines
+            }
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Random elements, one in four replaced by a special value
+ */
+static void fill(var_types type, unsigned char* buffer, size_t size){
+    size_t type_size = type_sizes[type];
+    unsigned char scratch[8]; ///< Fits any element, only used to count the special values
+    unsigned specials = 0;
+    while (special_value(type, specials, scratch)){
+        specials++;
+    }
+    for (size_t i = 0; i < size; i++){
+        unsigned char* element = buffer + i*type_size;
+        unsigned long long bits = check_random();
+        if (bits % 4 == 0){
+            special_value(type, (unsigned)(bits >> 8) % specials, element);
+        } else {
+            bits = check_random();
+            memcpy(element, &bits, type_size);
+        }
+        if (type == DOUBLE && bits % 3 == 0){
+            double small = (double)(long long)(bits % 64) - 32; ///< Exact duplicates
+            memcpy(element, &small, sizeof(double));
+        }
+    }
+}
+
+/**
+ * @brief Position of a value in array_sort() order: -0.0 before +0.0, NaNs last
+ */
+static int order(var_types type, const void* first, const void* second){
+    switch (type){
+        case FLOAT:
+        case DOUBLE: {
+            double a = type == FLOAT ? *(const float*)first : *(const double*)first;
+            double b = type == FLOAT ? *(const float*)second : *(const double*)second;
+            if (isnan(a) || isnan(b)){
+                return isnan(a) - isnan(b);
+            }
+            if (a == b){
+                return (int)(signbit(b) != 0) - (int)(signbit(a) != 0);
+            }
+            return a < b ? -1 : 1;
+        }
+        case INT:    return (*(const int*)first > *(const int*)second) - (*(const int*)first < *(const int*)second);
+        case INT8:   return (*(const int8_t*)first > *(const int8_t*)second) - (*(const int8_t*)first < *(const int8_t*)second);
+        case INT16:  return (*(const int16_t*)first > *(const int16_t*)second) - (*(const int16_t*)first < *(const int16_t*)second);
+        case INT64:  return (*(const int64_t*)first > *(const int64_t*)second) - (*(const int64_t*)first < *(const int64_t*)second);
+        case UINT8:  return (*(const uint8_t*)first > *(const uint8_t*)second) - (*(const uint8_t*)first < *(const uint8_t*)second);
+        case UINT16: return (*(const uint16_t*)first > *(const uint16_t*)second) - (*(const uint16_t*)first < *(const uint16_t*)second);
+        case UINT32: return (*(const uint32_t*)first > *(const uint32_t*)second) - (*(const uint32_t*)first < *(const uint32_t*)second);
+        case UINT64: return (*(const uint64_t*)first > *(const uint64_t*)second) - (*(const uint64_t*)first < *(const uint64_t*)second);
+        default:     return 0;
+    }
+}
+
+static bool is_nan(var_types type, const void* element){
+    return (type == FLOAT && isnan(*(const float*)element)) || (type == DOUBLE && isnan(*(const double*)element));
+}
+
+/**
+ * @brief Sorts a copy of input with algorithm, split elements at a time so the
+ * sorted prefix gets merged with the new tail like repeated array_sort() calls do
+ */
+static dArray* sorted_copy(var_types type, const unsigned char* input, size_t size, size_t split, darray_sort_algo algorithm){
+    dArray* array = array_new(type, 4);
+    CHECK(array_append_n(array, input, split));
+    CHECK(array_sort_ex(array, algorithm));
+    CHECK(array_append_n(array, input + split*type_sizes[type], size - split));
+    CHECK(array_sort_ex(array, algorithm));
+    return array;
+}
+
+static void check_engines(var_types type, size_t size, size_t split){
+    size_t type_size = type_sizes[type];
+    unsigned char* input = malloc(size*type_size);
+    CHECK(input || size == 0);
+    fill(type, input, size);
+
+    dArray* radix = sorted_copy(type, input, size, split, DARRAY_SORT_RADIX);
+    dArray* introsort = sorted_copy(type, input, size, split, DARRAY_SORT_INTROSORT);
+    dArray* automatic = sorted_copy(type, input, size, split, DARRAY_SORT_AUTO);
+    const unsigned char* result = array_data_const(radix);
+    CHECK(size == 0 || memcmp(result, array_data_const(introsort), size*type_size) == 0);
+    CHECK(size == 0 || memcmp(result, array_data_const(automatic), size*type_size) == 0);
+
+    ///< Ascending, and the NaNs at the end keep their input order (bit for bit)
+    for (size_t i = 1; i < size; i++){
+        CHECK(order(type, result + (i - 1)*type_size, result + i*type_size) <= 0);
+    }
+    size_t nan = 0;
+    while (nan < size && !is_nan(type, result + nan*type_size)){
+        nan++;
+    }
+    for (size_t i = 0; i < size; i++){
+        if (is_nan(type, input + i*type_size)){
+            CHECK(nan < size && memcmp(input + i*type_size, result + nan*type_size, type_size) == 0);
+            nan++;
+        }
+    }
+    CHECK(nan == size);
+
+    array_delete(&radix);
+    array_delete(&introsort);
+    array_delete(&automatic);
+    free(input);
+}
+
+int main(void){
+    static const size_t sizes[] = {0, 1, 2, 3, 16, 17, 100, 510, 511, 512, 513, 600, 1024, 1025, 5000};
+    for (size_t t = 0; t < sizeof(types)/sizeof(*types); t++){
+        for (size_t s = 0; s < sizeof(sizes)/sizeof(*sizes); s++){
+            size_t size = sizes[s];
+            check_engines(types[t], size, 0);
+            check_engines(types[t], size, size / 3);     ///< Sorted prefix merged with a tail
+            check_engines(types[t], size, size - size / 8);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file test_sort_parallel.c
+ * @brief array_sort_parallel() gives exactly the array_sort() result for floating point arrays
+ *
+ * NaNs of both signs, -0.0 and +0.0 are where a merge that compares values instead of
+ * sort keys would differ. The sizes make every thread count take the parallel path
+ * (65536 unsorted elements per thread at least).
+ */
+
+#include "darray.h"
+#include "check.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIZE 700000
+
+/**
+ * @brief Mostly small multiples of 1/8 (many duplicates), the rest signed zeros, NaNs and infinities
+ */
+static double random_value(void){
+    unsigned long long bits = check_random();
+    switch (bits % 8){
+        case 0:  return 0.0;
+        case 1:  return -0.0;
+        case 2:  return (bits >> 8) % 2 ? NAN : -NAN;
+        case 3:  return (bits >> 8) % 2 ? INFINITY : -INFINITY;
+        default: return (double)((long long)((bits >> 8) % 2001) - 1000) / 8;
+    }
+}
+
+/**
+ * @brief An array of the input, its first split elements appended and sorted first
+ * so the sort also merges the new elements into a known sorted prefix
+ */
+static dArray* new_input(var_types type, const void* values, size_t size, size_t split){
+    dArray* array = array_new(type, size);
+    CHECK(array_append_n(array, values, split));
+    array_sort(array);
+    CHECK(array_append_n(array, (const char*)values + split*array_get_element_size(array), size - split));
+    return array;
+}
+
+static void check_type(var_types type, size_t size, size_t split){
+    size_t type_size = type == FLOAT ? sizeof(float) : sizeof(double);
+    unsigned char* values = malloc(size*type_size);
+    CHECK(values);
+    for (size_t i = 0; i < size; i++){
+        double value = random_value();
+        if (type == FLOAT){
+            float narrow = (float)value;
+            memcpy(values + i*type_size, &narrow, type_size);
+        } else {
+            memcpy(values + i*type_size, &value, type_size);
+        }
+    }
+    dArray* expected = new_input(type, values, size, split);
+    array_sort(expected);
+
+    static const unsigned thread_counts[] = {0, 1, 2, 3, 4, 7};
+    for (size_t t = 0; t < sizeof(thread_counts)/sizeof(*thread_counts); t++){
+        dArray* parallel = new_input(type, values, size, split);
+        CHECK(array_sort_parallel(parallel, thread_counts[t]));
+        CHECK(array_is_sorted(parallel));
+        CHECK(memcmp(array_data_const(parallel), array_data_const(expected), size*type_size) == 0);
+        array_delete(&parallel);
+    }
+    array_delete(&expected);
+    free(values);
+}
+
+int main(void){
+    check_type(FLOAT, SIZE, 0);
+    check_type(DOUBLE, SIZE, 0);
+    check_type(FLOAT, SIZE, SIZE / 3);
+    check_type(DOUBLE, SIZE, SIZE / 3);
+    check_type(DOUBLE, 1000, 0); ///< Below the parallel threshold, the serial engine answers
+    return 0;
+}
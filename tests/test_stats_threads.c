@@ -0,0 +1,48 @@
+/**
+ * @file test_stats_threads.c
+ * @brief Const readers on several threads count every comparison
+ *
+ * Needs the counters, so the library must be built with DARRAY_STATS (the default without NDEBUG).
+ */
+
+#include "darray.h"
+#include "check.h"
+#include <pthread.h>
+
+#define THREADS 8
+#define CALLS 2000
+#define SIZE 1000
+
+static const dArray* shared;
+
+static void* count_worker(void* argument){
+    (void)argument;
+    int value = 7;
+    for (int i = 0; i < CALLS; i++){
+        CHECK(array_count(shared, &value) == 1);
+    }
+    return NULL;
+}
+
+int main(void){
+    dArray* array = array_new(INT, SIZE);
+    for (int i = 0; i < SIZE; i++){
+        array_append(array, &i);
+    }
+    array_reset_stats(array);
+    shared = array;
+
+    pthread_t threads[THREADS];
+    for (int i = 0; i < THREADS; i++){
+        CHECK(pthread_create(&threads[i], NULL, count_worker, NULL) == 0);
+    }
+    for (int i = 0; i < THREADS; i++){
+        pthread_join(threads[i], NULL);
+    }
+
+    darray_stats stats;
+    CHECK(array_get_stats(array, &stats));
+    CHECK(stats.comparisons == (size_t)THREADS*CALLS*SIZE); ///< array_count() compares every element
+    array_delete(&array);
+    return 0;
+}
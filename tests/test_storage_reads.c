@@ -0,0 +1,111 @@
+/**
+ * @file test_storage_reads.c
+ * @brief Searches, counts and array_extend() read gap and ring arrays without moving them
+ *
+ * The memmove_bytes counter tells if the buffer moved, so the library must be built
+ * with DARRAY_STATS (the default without NDEBUG).
+ */
+
+#include "darray.h"
+#include "check.h"
+#include <string.h>
+
+#define SIZE 100
+
+/**
+ * @brief A gap buffer with its gap in the middle, holding 0..SIZE-1 with every value below 10 twice
+ */
+static dArray* new_gap_array(void){
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    options.storage = DARRAY_STORAGE_GAP;
+    dArray* array = array_new_ex(INT, 8, &options);
+    for (int i = 10; i < SIZE; i++){
+        array_append(array, &i);
+    }
+    for (int i = 9; i >= 0; i--){
+        array_insert(array, 0, &i);
+    }
+    for (int i = 9; i >= 0; i--){
+        array_insert(array, 50, &i); ///< Leaves the gap after index 59
+    }
+    return array;
+}
+
+/**
+ * @brief A ring that wraps around the end of its buffer, same values as new_gap_array() in another order
+ */
+static dArray* new_ring_array(void){
+    darray_options options = DARRAY_OPTIONS_DEFAULT;
+    options.storage = DARRAY_STORAGE_RING;
+    dArray* array = array_new_ex(INT, 128, &options);
+    for (int i = 0; i < SIZE; i++){
+        array_append(array, &i);
+    }
+    for (int i = 0; i < 10; i++){
+        array_push_front(array, &i); ///< Goes before slot 0, to the end of the buffer
+    }
+    return array;
+}
+
+static void check_reads_in_place(dArray* array){
+    size_t size = array_get_size(array);
+    int expected[SIZE + 10];
+    for (size_t i = 0; i < size; i++){
+        array_get(array, i, &expected[i]);
+    }
+    array_reset_stats(array);
+
+    for (int value = -1; value <= SIZE; value++){
+        size_t scan_count = 0, first = DARRAY_NOT_FOUND;
+        for (size_t i = 0; i < size; i++){
+            if (expected[i] == value){
+                first = scan_count == 0 ? i : first;
+                scan_count++;
+            }
+        }
+        size_t index;
+        CHECK(array_find(array, &value, &index) == (scan_count > 0));
+        CHECK(scan_count == 0 || index == first);
+        CHECK(array_count(array, &value) == scan_count);
+
+        size_t indices[2];
+        CHECK(array_find_all(array, &value, indices, 1) == scan_count);
+        size_t found = array_find_all(array, &value, indices, 2);
+        CHECK(found == scan_count);
+        for (size_t i = 0; i < found; i++){
+            CHECK(expected[indices[i]] == value);
+        }
+    }
+
+    dArray* copy = array_new(INT, 4);
+    CHECK(array_extend(copy, array));
+    CHECK(memcmp(array_data_const(copy), expected, size*sizeof(int)) == 0);
+    array_delete(&copy);
+
+    darray_stats stats;
+    CHECK(array_get_stats(array, &stats));
+    CHECK(stats.memmove_bytes == 0);
+}
+
+int main(void){
+    dArray* gap = new_gap_array();
+    check_reads_in_place(gap);
+    dArray* ring = new_ring_array();
+    check_reads_in_place(ring);
+
+    ///< Extending a gap or ring array with itself copies both parts
+    for (int round = 0; round < 2; round++){
+        dArray* array = round == 0 ? gap : ring;
+        size_t size = array_get_size(array);
+        CHECK(array_extend(array, array));
+        for (size_t i = 0; i < size; i++){
+            int first, second;
+            array_get(array, i, &first);
+            array_get(array, i + size, &second);
+            CHECK(first == second);
+        }
+    }
+    array_delete(&gap);
+    array_delete(&ring);
+    return 0;
+}